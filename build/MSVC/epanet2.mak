@@ -41,7 +41,6 @@ CLEAN :
 	-@erase "$(INTDIR)\input1.obj"
 	-@erase "$(INTDIR)\input2.obj"
 	-@erase "$(INTDIR)\input3.obj"
-	-@erase "$(INTDIR)\mempool.obj"
 	-@erase "$(INTDIR)\output.obj"
 	-@erase "$(INTDIR)\quality.obj"
 	-@erase "$(INTDIR)\report.obj"
@@ -56,7 +55,7 @@ CLEAN :
     if not exist "$(OUTDIR)/$(NULL)" mkdir "$(OUTDIR)"
 
 CPP=cl.exe
-CPP_PROJ=/nologo /MT /W4 /GX /O2 /D "WIN32" /D "NDEBUG" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "EPANET2_EXPORTS" /Fo"$(INTDIR)\\" /Fd"$(INTDIR)\\" /FD /c 
+CPP_PROJ=/nologo /MT /W4 /GX /O2 /openmp /D "WIN32" /D "NDEBUG" /D "_WINDOWS" /D "_MBCS" /D "_USRDLL" /D "EPANET2_EXPORTS" /Fo"$(INTDIR)\\" /Fd"$(INTDIR)\\" /FD /c 
 
 .c{$(INTDIR)}.obj::
    $(CPP) @<<
@@ -107,7 +106,6 @@ LINK32_OBJS= \
 	"$(INTDIR)\input1.obj" \
 	"$(INTDIR)\input2.obj" \
 	"$(INTDIR)\input3.obj" \
-	"$(INTDIR)\mempool.obj" \
 	"$(INTDIR)\output.obj" \
 	"$(INTDIR)\quality.obj" \
 	"$(INTDIR)\report.obj" \
@@ -172,12 +170,6 @@ SOURCE=..\input3.c
 	$(CPP) $(CPP_PROJ) $(SOURCE)
 
 
-SOURCE=..\mempool.c
-
-"$(INTDIR)\mempool.obj" : $(SOURCE) "$(INTDIR)"
-	$(CPP) $(CPP_PROJ) $(SOURCE)
-
-
 SOURCE=..\output.c
 
 "$(INTDIR)\output.obj" : $(SOURCE) "$(INTDIR)"
@@ -44,6 +44,38 @@ char *RptFormTxt[]      = {t_HW,
                            t_DW,
                            t_CM};
 
+char *OrderTxt[]        = {w_MINDEGREE,
+                           w_AMD};
+
+char *RptOrderTxt[]     = {t_MINDEGREE,
+                           t_AMD};
+
+char *SolverTxt[]       = {w_CHOLESKY,
+                           w_PCG};
+
+char *RptSolverTxt[]    = {t_CHOLESKY,
+                           t_PCG};
+
+char *PrecTxt[]         = {w_DOUBLE,
+                           w_MIXED};
+
+char *RptPrecTxt[]      = {t_DOUBLE,
+                           t_MIXED};
+
+char *PredTxt[]         = {w_NONE,
+                           w_LINEAR,
+                           w_QUADRATIC};
+
+char *RptPredTxt[]      = {t_NONE,
+                           t_LINEAR,
+                           t_QUADRATIC};
+
+char *RouteTxt[]        = {w_STANDARD,
+                           w_ORDER};
+
+char *RptRouteTxt[]     = {t_STANDARD,
+                           t_ORDERED};
+
 char *RptFlowUnitsTxt[] = {u_CFS,
                            u_GPM,
                            u_MGD,
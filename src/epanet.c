@@ -670,6 +670,24 @@ int DLLEXPORT ENusehydfile(char *filename)
 }
 
 
+int DLLEXPORT ENusesymfile(char *filename)
+/*----------------------------------------------------------------
+**  Input:   filename = name of file ("" for none)
+**  Output:  none
+**  Returns: error code
+**  Purpose: sets the file used to save and re-use the symbolic
+**           factorization of the hydraulic solution matrix
+**----------------------------------------------------------------
+*/
+{
+/* Check that input data exists & hydraulics system closed */
+   if (!Openflag) return(102);
+   if (OpenHflag) return(108);
+   strncpy(SymFname, filename, MAXFNAME);
+   return(0);
+}
+
+
 /*
 ----------------------------------------------------------------
    Functions for running a WQ analysis
@@ -872,6 +890,41 @@ int DLLEXPORT ENcloseQ()
 }
 
 
+int DLLEXPORT ENsolveI(char *filename)
+/*----------------------------------------------------------------
+**  Input:   filename = name of binary influence file
+**  Output:  none
+**  Returns: error code
+**  Purpose: finds the fraction of the water at each RECEPTOR node
+**           in each reporting period that came through each node
+**           of the network, by routing the saved hydraulics
+**           backward in time, & saves it to a binary file
+**
+**  The WQ solver must be closed (see ENcloseQ()) before calling
+**  this function, since its work arrays are used for the backward
+**  routing. See saveinflhead() in OUTPUT.C for the layout of the
+**  file.
+**----------------------------------------------------------------
+*/
+{
+   FILE *f;
+   int  errcode;
+
+/* Check that hydraulics results & receptors exist */
+   if (!Openflag) return(102);
+   if (!SaveHflag) return(104);
+   if (OpenQflag) return(122);
+   if (Nrecept == 0) return(121);
+
+/* Route flow back from the receptors & save the results */
+   if ( (f = fopen(filename,"wb")) == NULL) return(304);
+   errcode = influence(f);
+   fclose(f);
+   if (errcode) errmsg(errcode);
+   return(errcode);
+}
+
+
 /*
 ----------------------------------------------------------------
    Functions for generating an output report
@@ -1047,6 +1100,7 @@ int DLLEXPORT ENgetcount(int code, int *count)
       case EN_PATCOUNT:     *count = Npats;     break;
       case EN_CURVECOUNT:   *count = Ncurves;   break;
       case EN_CONTROLCOUNT: *count = Ncontrols; break;
+      case EN_CONSCOUNT:    *count = Ncons;     break;
       default: return(251);
    }
    return(0);
@@ -1077,6 +1131,22 @@ int  DLLEXPORT ENgetoption(int code, float *value)
                           break;
       case EN_DEMANDMULT: v = Dmult;
                           break;
+      case EN_ORDERING:   v = (double)Ordering;
+                          break;
+      case EN_THREADS:    v = (double)Threads;
+                          break;
+      case EN_SOLVER:     v = (double)Solver;
+                          break;
+      case EN_UPDATELIMIT: v = UpdateLimit;
+                          break;
+      case EN_PRECISION:  v = (double)Precision;
+                          break;
+      case EN_PREDICTOR:  v = (double)Predictor;
+                          break;
+      case EN_CACHETOL:   v = CacheTol*Ucf[HEAD];
+                          break;
+      case EN_ROUTING:    v = (double)Routing;
+                          break;
       default:            return(251);
    }
    *value = (float)v;
@@ -1234,6 +1304,78 @@ int  DLLEXPORT ENgetqualtype(int *qualcode, int *tracenode)
 }
 
 
+int  DLLEXPORT ENgetconstype(int index, int *qualcode, int *tracenode)
+/*----------------------------------------------------------------
+**  Input:   index = index of extra constituent (1 to EN_CONSCOUNT)
+**  Output:  *qualcode  = EN_AGE or EN_TRACE
+**           *tracenode = index of node being traced (if
+**                        qualcode = EN_TRACE)
+**  Returns: error code
+**  Purpose: retrieves type of an extra constituent given by a
+**           CONSTITUENT option
+**
+**  NOTE:    Extra constituents can only be water age or a source
+**           trace. Reactive chemicals are limited to the main
+**           constituent, since no reaction is applied to extras
+**           (other than aging). The extras are carried in WQ
+**           segments of their own, so they don't change the main
+**           constituent's results.
+**----------------------------------------------------------------
+*/
+{
+   *qualcode = 0;
+   *tracenode = 0;
+   if (!Openflag) return(102);
+   if (index < 1 || index > Ncons) return(251);
+   *qualcode = Cons[index].Type;
+   *tracenode = Cons[index].Node;
+   return(0);
+}
+
+
+int  DLLEXPORT ENgetnodecons(int index, int cons, float *value)
+/*----------------------------------------------------------------
+**  Input:   index = node index
+**           cons  = index of extra constituent
+**  Output:  *value = current value of constituent at node
+**                    (hours of age or percent of flow traced)
+**  Returns: error code
+**  Purpose: retrieves computed quality of an extra constituent
+**           at a node
+**----------------------------------------------------------------
+*/
+{
+   *value = 0.0f;
+   if (!Openflag) return(102);
+   if (!OpenQflag) return(105);
+   if (index <= 0 || index > Nnodes) return(203);
+   if (cons < 1 || cons > Ncons) return(251);
+   *value = (float)Cx[index*Ncons + cons-1];
+   return(0);
+}
+
+
+int  DLLEXPORT ENgetlinkcons(int index, int cons, float *value)
+/*----------------------------------------------------------------
+**  Input:   index = link index
+**           cons  = index of extra constituent
+**  Output:  *value = current average value of constituent in link
+**  Returns: error code
+**  Purpose: retrieves computed quality of an extra constituent
+**           in a link
+**----------------------------------------------------------------
+*/
+{
+   *value = 0.0f;
+   if (!Openflag) return(102);
+   if (!OpenQflag) return(105);
+   if (index <= 0 || index > Nlinks) return(204);
+   if (cons < 1 || cons > Ncons) return(251);
+   *value = (float)avgcons(index,cons);
+   return(0);
+}
+
+
 int  DLLEXPORT ENgeterror(int errcode, char *errmsg, int n)
 /*----------------------------------------------------------------
 **  Input:   errcode = error/warning code number
@@ -1274,6 +1416,42 @@ int  DLLEXPORT ENgetstatistic(int code, int* value)
     case EN_RELATIVEERROR:
       *value = _relativeError;
       break;
+    case EN_ALLOCBYTES:
+      *value = AllocBytes;
+      break;
+    case EN_NONZEROS:
+      *value = Ncoeffs;
+      break;
+    case EN_ORDERTIME:
+      *value = OrderTime;
+      break;
+    case EN_SYMCACHED:
+      *value = SymCached;
+      break;
+    case EN_PCGITERATIONS:
+      *value = PcgIterations;
+      break;
+    case EN_FACTORUPDATES:
+      *value = FactorUpdates;
+      break;
+    case EN_CORESIZE:
+      *value = CoreSize;
+      break;
+    case EN_REFINESTEPS:
+      *value = RefineSteps;
+      break;
+    case EN_CONTROLEVALS:
+      *value = ControlEvals;
+      break;
+    case EN_TOTALITERATIONS:
+      *value = TotalIterations;
+      break;
+    case EN_CACHEHITS:
+      *value = CacheHits;
+      break;
+    case EN_CACHEMISSES:
+      *value = CacheMisses;
+      break;
     default:
       break;
   }
@@ -1821,6 +1999,7 @@ int DLLEXPORT ENsetcontrol(int cindex, int ctype, int lindex,
    if (lindex == 0)
    {
       Control[cindex].Link = 0;
+      if (OpenHflag) return(controllists());
       return(0);
    }
    if (lindex < 0 || lindex > Nlinks) return(204);
@@ -1874,6 +2053,9 @@ int DLLEXPORT ENsetcontrol(int cindex, int ctype, int lindex,
    Control[cindex].Setting = s;
    Control[cindex].Grade = lvl;
    Control[cindex].Time = t;
+
+/* Update lists of controls used by hydraulic solver */
+   if (OpenHflag) return(controllists());
    return(0);
 }         
 
@@ -1920,6 +2102,7 @@ int DLLEXPORT ENsetnodevalue(int index, int code, float v)
             {
                if (demand->next == NULL) demand->Base = value/Ucf[FLOW];
             }
+            if (OpenHflag) loaddemands(index);
          }
          break;
 
@@ -1933,6 +2116,7 @@ int DLLEXPORT ENsetnodevalue(int index, int code, float v)
             {
                if (demand->next == NULL) demand->Pat = j;
             }
+            if (OpenHflag) loaddemands(index);
          }
          else Tank[index-Njuncs].Pat = j;
          break;
@@ -2083,6 +2267,8 @@ int DLLEXPORT ENsetnodevalue(int index, int code, float v)
 
       default: return(251);
    }
+   /* Cached solutions no longer hold for the changed network */
+   if (OpenHflag && code != EN_TANKLEVEL) clearcache();
    return(0);
 }
 
@@ -2202,6 +2388,7 @@ int DLLEXPORT ENsetlinkvalue(int index, int code, float v)
 
       default: return(251);
    }
+   if (OpenHflag && code != EN_STATUS && code != EN_SETTING) clearcache();
    return(0);
 }
 
@@ -2218,6 +2405,7 @@ int  DLLEXPORT  ENaddpattern(char *id)
 {
     int i, j, n, err = 0;
     Spattern *tmpPat;
+    double *tmpFactor;
 
 /* Check if a pattern with same id already exists */
 
@@ -2263,6 +2451,17 @@ int  DLLEXPORT  ENaddpattern(char *id)
         return(101);
     }
 
+/* Make room for the new pattern's current factor (see demands()) */
+
+    tmpFactor = (double *) realloc(Pfactor, (n+1)*sizeof(double));
+    if ( tmpFactor == NULL )
+    {
+        for (i=0; i<=n; i++) if (tmpPat[i].F) free(tmpPat[i].F);
+        free(tmpPat);
+        return(101);
+    }
+    Pfactor = tmpFactor;
+
 // Replace old pattern array with new one
 
     for (i=0; i<=Npats; i++) free(Pattern[i].F);
@@ -2421,8 +2620,50 @@ int  DLLEXPORT ENsetoption(int code, float v)
       case EN_DEMANDMULT: if (value <= 0.0) return(202);
                           Dmult = value;
                           break;
+      case EN_ORDERING:   if (OpenHflag) return(109);
+                          i = ROUND(value);
+                          if (i < EN_MINDEGREE || i > EN_AMD) return(202);
+                          Ordering = (char)i;
+                          break;
+      case EN_THREADS:    i = ROUND(value);
+                          if (i < 1) return(202);
+#ifndef _OPENMP
+                          if (i > 1) writeline(WARN07);
+                          i = 1;
+#endif
+                          Threads = i;
+                          break;
+      case EN_SOLVER:     if (OpenHflag) return(109);
+                          i = ROUND(value);
+                          if (i < EN_CHOLESKY || i > EN_PCG) return(202);
+                          Solver = (char)i;
+                          break;
+      case EN_UPDATELIMIT: if (OpenHflag) return(109);
+                          if (value < 0.0) return(202);
+                          UpdateLimit = value;
+                          break;
+      case EN_PRECISION:  if (OpenHflag) return(109);
+                          i = ROUND(value);
+                          if (i < EN_DOUBLE || i > EN_MIXED) return(202);
+                          Precision = (char)i;
+                          break;
+      case EN_PREDICTOR:  if (OpenHflag) return(109);
+                          i = ROUND(value);
+                          if (i < EN_NOPREDICT || i > EN_QUADRATIC) return(202);
+                          Predictor = (char)i;
+                          break;
+      case EN_CACHETOL:   if (OpenHflag) return(109);
+                          if (value < 0.0) return(202);
+                          CacheTol = value/Ucf[HEAD];
+                          break;
+      case EN_ROUTING:    if (OpenQflag) return(109);
+                          i = ROUND(value);
+                          if (i < EN_STDROUTE || i > EN_ORDROUTE) return(202);
+                          Routing = (char)i;
+                          break;
       default:            return(251);
    }
+   if (OpenHflag) clearcache();
    return(0);
 }
  
@@ -2766,8 +3007,11 @@ void initpointers()
    Pump     = NULL;
    Valve    = NULL;
    Pattern  = NULL;
+   Pfactor  = NULL;
    Curve    = NULL;
    Control  = NULL;
+   Cons     = NULL;
+   Recept   = NULL;
 
    X        = NULL;
    Patlist  = NULL;
@@ -2850,13 +3094,19 @@ int  allocdata()
       Valve   = (Svalve *)   calloc(MaxValves+1,  sizeof(Svalve));
       Control = (Scontrol *) calloc(MaxControls+1,sizeof(Scontrol));
       Pattern = (Spattern *) calloc(MaxPats+1,    sizeof(Spattern));
+      Pfactor = (double *)   calloc(MaxPats+1,    sizeof(double));
       Curve   = (Scurve *)   calloc(MaxCurves+1,  sizeof(Scurve));
+      Cons    = (Scons *)    calloc(MaxCons+1,    sizeof(Scons));
+      Recept  = (int *)      calloc(MaxRecept+1,  sizeof(int));
       ERRCODE(MEMCHECK(Tank));
       ERRCODE(MEMCHECK(Pump));
       ERRCODE(MEMCHECK(Valve));
       ERRCODE(MEMCHECK(Control));
       ERRCODE(MEMCHECK(Pattern));
+      ERRCODE(MEMCHECK(Pfactor));
       ERRCODE(MEMCHECK(Curve));
+      ERRCODE(MEMCHECK(Cons));
+      ERRCODE(MEMCHECK(Recept));
    }
 
 /* Initialize pointers used in patterns, curves, and demand category lists */
@@ -2968,6 +3218,8 @@ void  freedata()
     free(Pump);
     free(Valve);
     free(Control);
+    free(Cons);
+    free(Recept);
 
 /* Free memory for time patterns */
     if (Pattern != NULL)
@@ -2975,6 +3227,7 @@ void  freedata()
        for (j=0; j<=MaxPats; j++) free(Pattern[j].F);
        free(Pattern);
     }
+    free(Pfactor);
 
 /* Free memory for curves */
     if (Curve != NULL)
@@ -3154,6 +3407,8 @@ char *geterrmsg(int errcode)
       case 109:   strcpy(Msg,ERR109);  break;
       case 110:   strcpy(Msg,ERR110);  break;
       case 120:   strcpy(Msg,ERR120);  break;
+      case 121:   strcpy(Msg,ERR121);  break;
+      case 122:   strcpy(Msg,ERR122);  break;
 
                                        /* Input Errors */
       case 200:  strcpy(Msg,ERR200);   break;
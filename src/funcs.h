@@ -108,7 +108,9 @@ void    initrules(void);                  /* Initializes rule base      */
 void    addrule(char *);                  /* Adds rule to rule base     */
 int     allocrules(void);                 /* Allocates memory for rule  */
 int     ruledata(void);                   /* Processes rule input data  */
-int     checkrules(long);                 /* Checks all rules           */
+int     compilerules(void);               /* Compiles rules for solver  */
+int     checkrules(long,int);             /* Checks all rules           */
+long    nextrulecheck(long,long);         /* Time rules next checked    */
 void    freerules(void);                  /* Frees rule base memory     */  
 
 /* ------------- REPORT.C --------------*/
@@ -147,6 +149,26 @@ int     nexthyd(long *);                  /* Moves to next time period  */
 void    closehyd(void);                   /* Closes hydraulics solver   */
 int     allocmatrix(void);                /* Allocates matrix coeffs.   */
 void    freematrix(void);                 /* Frees matrix coeffs.       */
+int     typelists(void);                  /* Groups links by type       */
+int     nodelinks(void);                  /* Lists links of each node   */
+int     demandtable(void);                /* Stores demands by array    */
+void    loaddemands(int);                 /* Copies junction's demands  */
+int     controllists(void);               /* Lists controls by trigger  */
+int     cmpcontrol(const void *,          /* Compares control times     */
+                   const void *);
+int     cmplevel(const void *,            /* Compares control levels    */
+                 const void *);
+int     cmpindex(const void *,            /* Compares control indexes   */
+                 const void *);
+int     nextcontrol(int *,int,long);      /* Finds next time control    */
+int     allochistory(void);               /* Allocates solution history */
+void    savehistory(void);                /* Saves solution to history  */
+void    predictor(void);                  /* Predicts starting flows    */
+int     alloccache(void);                 /* Allocates solution cache   */
+void    clearcache(void);                 /* Empties solution cache     */
+int     findcache(int *,double *);        /* Reuses a cached solution   */
+void    savecache(int,double);            /* Saves solution to cache    */
+void    loadpipes(void);                  /* Copies pipe data to arrays */
 void    initlinkflow(int, char, double);  /* Initializes link flow      */
 void    setlinkflow(int, double);         /* Sets link flow via headloss*/
 void    setlinkstatus(int, char, char *,  /* Sets link status           */
@@ -159,6 +181,7 @@ int     controls(void);                   /* Controls link settings     */
 long    timestep(void);                   /* Computes new time step     */
 void    tanktimestep(long *);             /* Time till tanks fill/drain */
 void    controltimestep(long *);          /* Time till control action   */
+int     controlchange(int);               /* Checks if control acts     */
 void    ruletimestep(long *);             /* Time till rule action      */
 void    addenergy(long);                  /* Accumulates energy usage   */
 void    getenergy(int, double *, double *); /* Computes link energy use   */
@@ -166,6 +189,7 @@ void    tanklevels(long);                 /* Computes new tank levels   */
 double  tankvolume(int,double);           /* Finds tank vol. from grade */
 double  tankgrade(int,double);            /* Finds tank grade from vol. */
 int     netsolve(int *,double *);         /* Solves network equations   */
+int     pcgfallback(void);                /* Switches PCG to Cholesky   */
 int     badvalve(int);                    /* Checks for bad valve       */
 int     valvestatus(void);                /* Updates valve status       */
 int     linkstatus(void);                 /* Updates link status        */
@@ -180,12 +204,18 @@ char    fcvstatus(int,char,double,        /* Updates FCV status         */
 void    tankstatus(int,int,int);          /* Checks if tank full/empty  */
 int     pswitch(void);                    /* Pressure switch controls   */
 double  newflows(void);                   /* Updates link flows         */
+void    tankflows(void);                  /* Updates net flows to tanks */
+void    blockflows(int);                  /* Updates flows in block     */
 void    newcoeffs(void);                  /* Computes matrix coeffs.    */
 void    linkcoeffs(void);                 /* Computes link coeffs.      */
+void    nodelinkcoeffs(int);              /* Adds link coeffs. to node  */
 void    nodecoeffs(void);                 /* Computes node coeffs.      */
 void    valvecoeffs(void);                /* Computes valve coeffs.     */
-void    pipecoeff(int);                   /* Computes pipe coeff.       */
-double  DWcoeff(int, double *);           /* Computes D-W coeff.        */
+void    pipecoeffs(int,int);              /* Computes pipe coeffs.      */
+void    hwcoeffs(int,int);                /* H-W pipe coeffs. kernel    */
+void    dwcoeffs(int,int);                /* D-W pipe coeffs. kernel    */
+void    cmcoeffs(int,int);                /* C-M pipe coeffs. kernel    */
+double  DWcoeff(double, double, double);  /* Computes D-W coeff.        */
 void    pumpcoeff(int);                   /* Computes pump coeff.       */
 
 /*** Updated 10/25/00 ***/
@@ -206,12 +236,15 @@ double  emitflowchange(int);              /* Computes new emitter flow  */
 int     createsparse(void);               /* Creates sparse matrix      */
 int     allocsparse(void);                /* Allocates matrix memory    */
 void    freesparse(void);                 /* Frees matrix memory        */
+int     allocwork(int);                   /* Allocates linsolve() work  */
 int     buildlists(int);                  /* Builds adjacency lists     */
 int     paralink(int, int, int);          /* Checks for parallel links  */
 void    xparalinks(void);                 /* Removes parallel links     */
 void    freelists(void);                  /* Frees adjacency lists      */
 void    countdegree(void);                /* Counts links at each node  */
 int     reordernodes(void);               /* Finds a node re-ordering   */
+int     amdorder(int);                    /* Approx. min. degree order  */
+int     symbfill(int);                    /* Adds fill-ins for ordering */
 int     mindegree(int, int);              /* Finds min. degree node     */
 int     growlist(int);                    /* Augments adjacency list    */
 int     newlink(Padjlist);                /* Adds fill-ins for a node   */
@@ -221,8 +254,53 @@ int     storesparse(int);                 /* Stores sparse matrix       */
 int     ordersparse(int);                 /* Orders matrix storage      */
 void    transpose(int,int *,int *,        /* Transposes sparse matrix   */
         int *,int *,int *,int *,int *);
+int     mapcoeffs(int);                   /* Maps link coeffs. into L   */
+unsigned fingerprint(void);               /* Hashes network topology    */
+unsigned hashint(unsigned, int);          /* Adds integer to hash key   */
+int     loadsparse(int, unsigned);        /* Reads sparse scheme file   */
+int     checkscheme(int);                 /* Validates sparse scheme    */
+unsigned schemesum(int);                  /* Checksums sparse scheme    */
+void    savesparse(int, unsigned);        /* Saves sparse scheme file   */
+int     findsupernodes(int);              /* Finds matrix supernodes    */
+int     findchains(int);                  /* Finds tree & chain columns */
+int     findtasks(void);                  /* Splits elimination tree    */
 int     linsolve(int, double *, double *, /* Solution of linear eqns.   */
                  double *);               /* via Cholesky factorization */
+int     elimchains(double *, double *);   /* Eliminates chain columns   */
+int     firstcore(void);                  /* First core supernode       */
+int     factorsuper(int, double *,        /* Factorizes a supernode     */
+        double *, double *, int *, int);
+void    linkcol(int, int, int);           /* Links column to supernode  */
+int     factortasks(int, double *,        /* Factorizes by subtrees     */
+        double *);
+void    solvetasks(double *, double *,    /* Solves by subtrees         */
+        double *);
+void    cholsolve(int, double *,          /* Solves with Cholesky factor*/
+        double *, double *);
+int     allocupdate(int);                 /* Allocates factor updating  */
+int     updsolve(int, double *, double *, /* Solution of linear eqns.   */
+                 double *);               /* via factor updates         */
+int     findupdates(int, double *,        /* Lists changed coeffs.      */
+        double *);
+double  pathwork(int);                    /* Work of rank-one update    */
+int     applyupdates(int, double *, int); /* Updates Cholesky factor    */
+int     rankone(int, double);             /* Rank-one factor update     */
+int     allocmixed(int);                  /* Allocates mixed precision  */
+int     mixsolve(int, double *, double *, /* Solution of linear eqns.   */
+                 double *);               /* via mixed precision        */
+int     sfactor(void);                    /* Single precision factor    */
+int     sfactorsuper(int, float *,        /* Single precision supernode */
+        float *);
+void    scholsolve(int, float *, float *, /* Single precision solve     */
+        double *);
+int     allocpcg(int);                    /* Allocates PCG work arrays  */
+int     pcgsolve(int, double *, double *, /* Solution of linear eqns.   */
+                 double *);               /* via conjugate gradients    */
+double  pcgresid(int, double *);         /* Flow error of PCG residual */
+int     icfactor(int, double *, double *);/* Incomplete Cholesky factor */
+void    icsolve(int, double *, double *); /* Applies PCG preconditioner */
+void    matvec(int, double *, double *,   /* Multiplies matrix & vector */
+        double *, double *);
 
 /* ----------- QUALITY.C ---------------*/
 int     openqual(void);                   /* Opens WQ solver system     */
@@ -231,29 +309,63 @@ int     runqual(long *);                  /* Gets current WQ results    */
 int     nextqual(long *);                 /* Updates WQ by hyd.timestep */
 int     stepqual(long *);                 /* Updates WQ by WQ time step */
 int     closequal(void);                  /* Closes WQ solver system    */
+int     influence(FILE *);                /* Routes WQ back from recepts*/
+int     newpulse(int,long);               /* Starts pulse in free slot  */
+int     growpulses(int);                  /* Adds slots for pulses      */
+int     resizecons(double **,int,int);    /* Re-spaces constituent array*/
+double  startpulse(int,long);             /* Starts pulse from receptor */
+void    addinfluence(void);               /* Adds pulse inflow to nodes */
+int     endpulses(FILE *,int);            /* Saves pulses that are done */
 int     gethyd(long *, long *);           /* Gets next hyd. results     */
 char    setReactflag(void);               /* Checks for reactive chem.  */
 void    transport(long);                  /* Transports mass in network */
+void    routestep(long);                  /* Transports mass over dt    */
 void    initsegs(void);                   /* Initializes WQ segments    */
 void    reorientsegs(void);               /* Re-orients WQ segments     */
 void    updatesegs(long);                 /* Updates quality in segments*/
-void    removesegs(int);                  /* Removes a WQ segment       */
+void    blocksegs(int,long);              /* Updates segs in link block */
+void    removesegs(int);                  /* Removes all WQ segments    */
 void    addseg(int,double,double);        /* Adds a WQ segment to pipe  */
+void    addsegx(int,double,double *);     /* Adds an extra WQ segment   */
+int     growsegs(Pseglist,int);           /* Enlarges a segment buffer  */
 void    accumulate(long);                 /* Sums mass flow into node   */
+void    adjqual(void);                    /* Finds WQ next to each node */
+void    adjcons(void);                    /* Finds extra WQ next to node*/
+void    gathercons(int);                  /* Sums extra WQ into a node  */
+void    linkoutflow(int,long);            /* Finds flow out of a link   */
+void    linkcons(int,double);             /* Finds extra WQ out of link */
 void    updatenodes(long);                /* Updates WQ at nodes        */
+void    nodecons(int);                    /* Updates extra WQ at node   */
 void    sourceinput(long);                /* Computes source inputs     */
+double  nodesource(int,long);             /* Computes input at a node   */
+void    reservoirmass(long);              /* Adds reservoir mass inflow */
 void    release(long);                    /* Releases mass from nodes   */
+void    releaselink(int,long);            /* Releases mass into a link  */
+void    releasecons(int,double,double *); /* Releases extra WQ into link*/
 void    updatetanks(long);                /* Updates WQ in tanks        */
+void    updatetank(int,long);             /* Updates WQ in one tank     */
+int     sortnodes(void);                  /* Orders nodes by flow       */
+void    routenodes(long);                 /* Routes WQ node by node     */
 void    updatesourcenodes(long);          /* Updates WQ at source nodes */
 void    tankmix1(int, long);              /* Complete mix tank model    */
 void    tankmix2(int, long);              /* 2-compartment tank model   */
 void    tankmix3(int, long);              /* FIFO tank model            */
 void    tankmix4(int, long);              /* LIFO tank model            */
+void    mix2cons(int, long);              /* 2-comp. tank extra WQ      */
+void    fifocons(int, long);              /* FIFO tank extra WQ         */
+void    lifocons(int, long);              /* LIFO tank extra WQ         */
 double  sourcequal(Psource);              /* Finds WQ input from source */
 double  avgqual(int);                     /* Finds avg. quality in pipe */
+double  avgcons(int,int);                 /* Finds avg. extra WQ in pipe*/
+double  *inflowcons(int);                 /* Finds extra WQ of inflow   */
+int     samecons(double *,double *);      /* Compares extra WQ values   */
+void    mixcons(double *,double,          /* Mixes extra WQ values      */
+                double *,double);
+void    reactcons(double *,long);         /* Ages extra WQ values       */
 void    ratecoeffs(void);                 /* Finds wall react. coeffs.  */
 double  piperate(int);                    /* Finds wall react. coeff.   */
-double  pipereact(int,double,double,long);/* Reacts water in a pipe     */
+double  pipereact(int,double,double,long,/* Reacts water in a pipe     */
+                  double *);
 double  tankreact(double,double,double,
                   long);                  /* Reacts water in a tank     */
 double  bulkrate(double,double,double);   /* Finds bulk reaction rate   */
@@ -275,6 +387,10 @@ int     savetimestat(REAL4 *, char);      /* Saves time stats to file   */
 int     savenetreacts(double, double,
                       double, double);    /* Saves react. rates to file */
 int     saveepilog(void);                 /* Saves output file epilog   */
+int     saveinflhead(FILE *,int);         /* Starts influence file      */
+int     saveinflpulse(FILE *,int,double *,/* Saves receptor influences  */
+                int);
+int     saveinflend(FILE *);              /* Ends influence file        */
 
 
 /* ------------ INPFILE.C --------------*/
@@ -21,9 +21,17 @@ AUTHOR:     L. Rossman
   an extended period of time and writes its results to the         
   binary file HydFile.
                                              
+  When compiled with OpenMP (as the build files do), the link coeffs.,
+  the assembly of the solution matrix and the flow updates are split
+  among the THREADS given in the [OPTIONS]. No two threads update the
+  same value and all sums are added up in a fixed order, so the results
+  don't depend on the number of threads.
+
   The entry points for this module are:
      openhyd()    -- called from ENopenH() in EPANET.C
      inithyd()    -- called from ENinitH() in EPANET.C
+     clearcache() -- called from ENsetnodevalue(), ENsetlinkvalue()
+                     and ENsetoption() in EPANET.C
      runhyd()     -- called from ENrunH() in EPANET.C
      nexthyd()    -- called from ENnextH() in EPANET.C
      closehyd()   -- called from ENcloseH() in EPANET.C
@@ -48,12 +56,16 @@ AUTHOR:     L. Rossman
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #ifndef __APPLE__
 #include <malloc.h>
 #else
 #include <stdlib.h>
 #endif
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "hash.h"
 #include "text.h"
 #include "types.h"
@@ -64,6 +76,8 @@ AUTHOR:     L. Rossman
 #define   QZERO  1.e-6  /* Equivalent to zero flow */
 #define   CBIG   1.e8   /* Big coefficient         */
 #define   CSMALL 1.e-6  /* Small coefficient       */
+#define   QBLOCK 1024   /* Links per block of work */
+#define   MAXCACHE 96   /* Solutions in the cache  */
 
 /* Constants used for computing Darcy-Weisbach friction factor */
 #define A1  0.314159265359e04  /* 1000*PI */
@@ -86,6 +100,74 @@ double RelaxFactor;                                                            /
 /* Function to find flow coeffs. through open/closed valves */                 //(2.00.11 - LR)
 void valvecoeff(int k);                                                        //(2.00.11 - LR)
 
+/* Links grouped by type (see typelists()) */
+int    *Typelist;              /* Links in order of type          */
+int    Xtype[GPV+2];           /* Start of each type in Typelist  */
+
+/* Pipe data stored by array for pipecoeffs() */
+double *Pr,                    /* Resistance coeff. of each pipe  */
+       *Pkm,                   /* Minor loss coeff. of each pipe  */
+       *Pq,                    /* Flow in each pipe               */
+       *Pp,                    /* P coeff. of each pipe           */
+       *Py,                    /* Y coeff. of each pipe           */
+       *Pvd,                   /* Viscosity times diam. (D-W)     */
+       *Prr;                   /* Rel. roughness / 3.7 (D-W)      */
+
+/* Kernel that computes pipe coeffs. for the headloss formula */
+void   (*Pipekernel)(int, int);
+
+/* Links incident on each node (see nodelinks()) */
+int    *Nodelink,              /* Links in order of node          */
+       *Xnode;                 /* Start of each node in Nodelink  */
+double *Qblock,                /* Sum of flows in each block      */
+       *Dqblock;               /* Sum of flow changes each block  */
+
+/* Demand categories of junctions stored by array (see demandtable()) */
+int    *Xdemand,               /* Start of each junction's demands*/
+       *Dpat;                  /* Pattern index of each demand    */
+double *Dbase,                 /* Base flow of each demand        */
+       *Dflow;                 /* Current flow of each demand     */
+
+/* Simple controls listed by what triggers them (see controllists()) */
+int    *Timerctl,              /* TIMER controls in order of time */
+       *Todctl,                /* TIMEOFDAY controls by time      */
+       *Nodectl,               /* Level controls by node & level  */
+       *Xnodectl,              /* Start of each node in Nodectl   */
+       *Xhictl,                /* Start of node's HILEVEL controls*/
+       *Ctlnode,               /* Nodes with level controls       */
+       *Ctlfired,              /* Controls whose condition holds  */
+       Ntimers,                /* Number of TIMER controls        */
+       Ntods,                  /* Number of TIMEOFDAY controls    */
+       Nctlnodes,              /* Number of nodes in Ctlnode      */
+       Njctlnodes;             /* Number of junctions in Ctlnode  */
+
+/* Solutions of recent periods used by predictor() */
+double *Xhist,                 /* Storage for the solutions       */
+       *Qhist[3],              /* Link flows, most recent first   */
+       *Hhist[3],              /* Junction heads                  */
+       Dhist[3];               /* Total system demand             */
+char   *Shist;                 /* Link status of last solution    */
+int    Nhist;                  /* Number of solutions saved       */
+
+/* Solutions of earlier periods reused by findcache() */
+typedef struct
+{
+   unsigned Hash;              /* Hash of the key                 */
+   double   *X;                /* Key values, then solution       */
+   char     *S;                /* Key link status, then solution  */
+   int      Iter;              /* Trials taken by the solution    */
+   double   Relerr;            /* Convergence error of solution   */
+}  Scache;
+Scache *Cache;                 /* Cached solutions                */
+double *Ckey;                  /* Key of the current period       */
+char   *Cstat;                 /* Link status of current period   */
+unsigned Chash;                /* Hash of the current key         */
+int    Nkey,                   /* Number of values in a key       */
+       Ncache,                 /* Number of solutions cached      */
+       Cnext;                  /* Next cache entry to replace     */
+
+char   Pcgfail;                /* PCG replaced by direct solver   */
+
 
 int  openhyd()
 /*
@@ -100,6 +182,13 @@ int  openhyd()
    int  errcode = 0;
    ERRCODE(createsparse());     /* See SMATRIX.C  */
    ERRCODE(allocmatrix());      /* Allocate solution matrices */
+   ERRCODE(typelists());        /* Group links by type */
+   ERRCODE(nodelinks());        /* List links of each node */
+   ERRCODE(demandtable());      /* Store demands by array */
+   ERRCODE(controllists());     /* List controls by trigger */
+   ERRCODE(compilerules());     /* See RULES.C */
+   ERRCODE(allochistory());     /* Solutions for predictor */
+   ERRCODE(alloccache());       /* Solutions to reuse */
    for (i=1; i<=Nlinks; i++)    /* Initialize flows */
       initlinkflow(i,Link[i].Stat,Link[i].Kc);
    return(errcode);
@@ -175,6 +264,13 @@ void inithyd(int initflag)
    Htime = 0;
    Hydstep = 0;
    Rtime = Rstep;
+
+   /* Clear solution history, cache & statistics */
+   Nhist = 0;
+   clearcache();
+   TotalIterations = 0;
+   CacheHits = 0;
+   CacheMisses = 0;
 }
 
 
@@ -194,19 +290,38 @@ int   runhyd(long *t)
 
    /* Find new demands & control actions */
    *t = Htime;
+   ControlEvals = 0;
    demands();
    controls();
 
+   /* Re-use the solution of an earlier period with the same */
+   /* patterns, link settings & tank levels if one is cached  */
+   if (Cache != NULL && findcache(&iter,&relerr))
+   {
+      if (Statflag) writehydstat(0,relerr);
+      if (Predictor != NOPRED) savehistory();
+      _relativeError = relerr;
+      _iterations = 0;
+      if (relerr > Hacc && ExtraIter == -1) Haltflag = 1;
+      return(writehydwarn(iter,relerr));
+   }
+
+   /* Predict starting flows from recent solutions */
+   if (Predictor != NOPRED) predictor();
+
    /* Solve network hydraulic equations */
    errcode = netsolve(&iter,&relerr);
    if (!errcode)
    {
       /* Report new status & save results */
       if (Statflag) writehydstat(iter,relerr);
+      if (Predictor != NOPRED) savehistory();
+      if (Cache != NULL) savecache(iter,relerr);
 
      /* solution info */
      _relativeError = relerr;
      _iterations = iter;
+     TotalIterations += iter;
      
 /*** Updated 3/1/01 ***/
       /* If system unbalanced and no extra trials */
@@ -276,6 +391,11 @@ void  closehyd()
 {
    freesparse();           /* see SMATRIX.C */
    freematrix();
+
+   /* Restore the PCG solver option if the direct */
+   /* solver was used in its place                */
+   if (Pcgfail) Solver = PCG;
+   Pcgfail = FALSE;
 }
 
 
@@ -318,6 +438,8 @@ void  freematrix()
 **--------------------------------------------------------------
 */
 {
+   int i;
+
    free(Aii);
    free(Aij);
    free(F);
@@ -326,9 +448,717 @@ void  freematrix()
    free(Y);
    free(X);
    free(OldStat);
+   free(Typelist);
+   free(Pr);
+   free(Nodelink);
+   free(Xnode);
+   free(Qblock);
+   free(Xdemand);
+   free(Dpat);
+   free(Dbase);
+   free(Timerctl);
+   free(Xnodectl);
+   free(Xhist);
+   free(Shist);
+   if (Cache != NULL)
+   {
+      for (i=0; i<MAXCACHE; i++)
+      {
+         free(Cache[i].X);
+         free(Cache[i].S);
+      }
+      free(Cache);
+      free(Ckey);
+      free(Cstat);
+      Cache = NULL;
+   }
+   Typelist = NULL;
+   Pr = NULL;
+   Nodelink = NULL;
+   Xnode = NULL;
+   Qblock = NULL;
+   Xdemand = NULL;
+   Dpat = NULL;
+   Dbase = NULL;
+   Timerctl = NULL;
+   Xnodectl = NULL;
+   Xhist = NULL;
+   Shist = NULL;
 }                               /* end of freematrix */
 
 
+int  typelists()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  returns error code                                  
+**  Purpose: lists the network's links grouped by type and       
+**           allocates the pipe arrays used by pipecoeffs() and  
+**           selects its kernel for the headloss formula         
+**                                                              
+**  NOTE: The links of type t are Typelist[Xtype[t]] to          
+**        Typelist[Xtype[t+1]-1], in order of link index. CVs   
+**        and pipes come first, so together they make up the     
+**        first Xtype[PUMP] entries, which is also the position  
+**        of each one in the pipe arrays.                        
+**--------------------------------------------------------------
+*/
+{
+   int  k, n, t;
+
+   Typelist = (int *) calloc(Nlinks+1, sizeof(int));
+   if (Typelist == NULL) return(101);
+   memset(Xtype,0,sizeof(Xtype));
+   for (k=1; k<=Nlinks; k++) Xtype[Link[k].Type+1]++;
+   for (t=1; t<=GPV+1; t++) Xtype[t] += Xtype[t-1];
+   for (k=1; k<=Nlinks; k++)
+   {
+      t = Link[k].Type;
+      Typelist[Xtype[t]++] = k;
+   }
+   for (t=GPV+1; t>0; t--) Xtype[t] = Xtype[t-1];
+   Xtype[0] = 0;
+
+   /* Allocate the pipe arrays as one block */
+   n = Xtype[PUMP] + 1;
+   Pr = (double *) calloc(7*n, sizeof(double));
+   if (Pr == NULL) return(101);
+   Pkm = Pr + n;
+   Pq  = Pkm + n;
+   Pp  = Pq + n;
+   Py  = Pp + n;
+   Pvd = Py + n;
+   Prr = Pvd + n;
+
+   /* Select the pipe coeff. kernel for the headloss formula */
+   if      (Formflag == HW) Pipekernel = hwcoeffs;
+   else if (Formflag == DW) Pipekernel = dwcoeffs;
+   else                     Pipekernel = cmcoeffs;
+   return(0);
+}                               /* end of typelists */
+
+
+int  nodelinks()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  returns error code                                  
+**  Purpose: lists the links incident on each node, so that the  
+**           matrix coeffs. can be assembled one node at a time  
+**           (and so by several threads at once)                 
+**                                                              
+**  NOTE: The links of node i are Nodelink[Xnode[i]] to          
+**        Nodelink[Xnode[i+1]-1], in order of link index. So a   
+**        node's coeffs. are summed in the same order as when    
+**        each link's coeffs. are added to both its end nodes.   
+**--------------------------------------------------------------
+*/
+{
+   int  i, k, nb;
+
+   Nodelink = (int *) calloc(2*Nlinks+1, sizeof(int));
+   Xnode    = (int *) calloc(Nnodes+2, sizeof(int));
+   nb = (Nlinks + QBLOCK - 1)/QBLOCK;
+   Qblock   = (double *) calloc(2*(nb+1), sizeof(double));
+   if (Nodelink == NULL || Xnode == NULL || Qblock == NULL) return(101);
+   Dqblock = Qblock + nb + 1;
+   for (k=1; k<=Nlinks; k++)
+   {
+      Xnode[Link[k].N1+1]++;
+      Xnode[Link[k].N2+1]++;
+   }
+   for (i=2; i<=Nnodes+1; i++) Xnode[i] += Xnode[i-1];
+   for (k=1; k<=Nlinks; k++)
+   {
+      Nodelink[Xnode[Link[k].N1]++] = k;
+      Nodelink[Xnode[Link[k].N2]++] = k;
+   }
+   for (i=Nnodes+1; i>1; i--) Xnode[i] = Xnode[i-1];
+   Xnode[1] = 0;
+   return(0);
+}                               /* end of nodelinks */
+
+
+int  demandtable()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  returns error code                                  
+**  Purpose: copies the demand categories of all junctions from  
+**           their demand lists into arrays used by demands()    
+**                                                              
+**  NOTE: The demands of junction i are entries Xdemand[i] to    
+**        Xdemand[i+1]-1, in the same order as its demand list.  
+**--------------------------------------------------------------
+*/
+{
+   int     i, n;
+   Pdemand demand;
+
+   Xdemand = (int *) calloc(Njuncs+2, sizeof(int));
+   if (Xdemand == NULL) return(101);
+   for (i=1; i<=Njuncs; i++)
+   {
+      n = 0;
+      for (demand = Node[i].D; demand != NULL; demand = demand->next) n++;
+      Xdemand[i+1] = Xdemand[i] + n;
+   }
+   n = Xdemand[Njuncs+1] + 1;
+   Dpat  = (int *) calloc(n, sizeof(int));
+   Dbase = (double *) calloc(2*n, sizeof(double));
+   if (Dpat == NULL || Dbase == NULL) return(101);
+   Dflow = Dbase + n;
+   for (i=1; i<=Njuncs; i++) loaddemands(i);
+   return(0);
+}                               /* end of demandtable */
+
+
+void  loaddemands(int i)
+/*
+**--------------------------------------------------------------
+**  Input:   i = junction index                                  
+**  Output:  none                                                
+**  Purpose: copies the base flow & pattern of each of junction  
+**           i's demand categories into the demand arrays        
+**                                                              
+**  NOTE: Must be called whenever a junction's demand list is    
+**        changed while the hydraulics system is open (e.g. by   
+**        ENsetnodevalue()).                                     
+**--------------------------------------------------------------
+*/
+{
+   int     m;
+   Pdemand demand;
+
+   m = Xdemand[i];
+   for (demand = Node[i].D; demand != NULL; demand = demand->next)
+   {
+      Dbase[m] = demand->Base;
+      Dpat[m]  = demand->Pat;
+      m++;
+   }
+}                               /* end of loaddemands */
+
+
+int  controllists()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  returns error code                                  
+**  Purpose: lists the simple controls by the time or node level 
+**           that triggers them                                  
+**                                                              
+**  NOTE: TIMER controls (Timerctl) are sorted by the time they  
+**        occur and TIMEOFDAY controls (Todctl) by the time of   
+**        day, so the next ones due are found by a binary search 
+**        (see nextcontrol()). Level controls on node n are      
+**        Nodectl[Xnodectl[n]] to Nodectl[Xnodectl[n+1]-1], with 
+**        its LOWLEVEL controls before its HILEVEL ones (starting
+**        at Xhictl[n]) and each sorted by level, so the ones    
+**        whose level has been crossed are found at one end (see 
+**        controls() and pswitch()). Ctlnode lists the nodes with
+**        level controls, the Njctlnodes junctions first.        
+**        Disabled controls (no link) are not listed. Must be    
+**        called again whenever a control is changed while the   
+**        hydraulics system is open (e.g. by ENsetcontrol()).    
+**--------------------------------------------------------------
+*/
+{
+   int  i, m, n;
+
+   free(Timerctl);
+   free(Xnodectl);
+   Timerctl = (int *) calloc(3*Ncontrols+1, sizeof(int));
+   Xnodectl = (int *) calloc(2*Nnodes+3, sizeof(int));
+   if (Timerctl == NULL || Xnodectl == NULL) return(101);
+   Xhictl = Xnodectl + Nnodes + 2;
+
+   /* Count each type of control */
+   Ntimers = 0;
+   Ntods = 0;
+   for (i=1; i<=Ncontrols; i++)
+   {
+      if (Control[i].Link <= 0) continue;
+      if (Control[i].Type == TIMER) Ntimers++;
+      else if (Control[i].Type == TIMEOFDAY) Ntods++;
+      else if ((n = Control[i].Node) > 0) Xnodectl[n+1]++;
+   }
+   for (n=2; n<=Nnodes+1; n++) Xnodectl[n] += Xnodectl[n-1];
+
+   /* Fill in the lists */
+   Todctl = Timerctl + Ntimers;
+   Nodectl = Todctl + Ntods;
+   Ctlfired = Timerctl + Ncontrols;
+   Ctlnode = Ctlfired + Ncontrols;
+   Ntimers = 0;
+   Ntods = 0;
+   for (i=1; i<=Ncontrols; i++)
+   {
+      if (Control[i].Link <= 0) continue;
+      if (Control[i].Type == TIMER) Timerctl[Ntimers++] = i;
+      else if (Control[i].Type == TIMEOFDAY) Todctl[Ntods++] = i;
+      else if ((n = Control[i].Node) > 0)
+      {
+         Nodectl[Xnodectl[n]++] = i;
+      }
+   }
+   for (n=Nnodes+1; n>1; n--) Xnodectl[n] = Xnodectl[n-1];
+   Xnodectl[1] = 0;
+
+   /* Sort the time controls by time and level controls by level */
+   qsort(Timerctl, Ntimers, sizeof(int), cmpcontrol);
+   qsort(Todctl, Ntods, sizeof(int), cmpcontrol);
+   qsort(Nodectl, Xnodectl[Nnodes+1], sizeof(int), cmplevel);
+
+   /* List nodes with level controls & where their HILEVELs start */
+   Nctlnodes = 0;
+   Njctlnodes = 0;
+   for (n=1; n<=Nnodes; n++)
+   {
+      m = Xnodectl[n];
+      while (m < Xnodectl[n+1] && Control[Nodectl[m]].Type == LOWLEVEL) m++;
+      Xhictl[n] = m;
+      if (Xnodectl[n+1] == Xnodectl[n]) continue;
+      Ctlnode[Nctlnodes++] = n;
+      if (n <= Njuncs) Njctlnodes++;
+   }
+   return(0);
+}                               /* end of controllists */
+
+
+int  cmpcontrol(const void *a, const void *b)
+/*
+**--------------------------------------------------------------
+**  Input:   a, b = pointers to control indexes                  
+**  Output:  returns -1, 0 or 1                                  
+**  Purpose: orders controls by time and then by index (for      
+**           use with qsort())                                   
+**--------------------------------------------------------------
+*/
+{
+   int i = *(const int *)a;
+   int j = *(const int *)b;
+
+   if (Control[i].Time < Control[j].Time) return(-1);
+   if (Control[i].Time > Control[j].Time) return(1);
+   return((i > j) - (i < j));
+}                               /* end of cmpcontrol */
+
+
+int  cmplevel(const void *a, const void *b)
+/*
+**--------------------------------------------------------------
+**  Input:   a, b = pointers to control indexes                  
+**  Output:  returns -1, 0 or 1                                  
+**  Purpose: orders level controls by node, by type (LOWLEVEL    
+**           first), by level and then by index (for use with    
+**           qsort())                                            
+**--------------------------------------------------------------
+*/
+{
+   int i = *(const int *)a;
+   int j = *(const int *)b;
+
+   if (Control[i].Node != Control[j].Node)
+      return((Control[i].Node > Control[j].Node) ? 1 : -1);
+   if (Control[i].Type != Control[j].Type)
+      return((Control[i].Type > Control[j].Type) ? 1 : -1);
+   if (Control[i].Grade < Control[j].Grade) return(-1);
+   if (Control[i].Grade > Control[j].Grade) return(1);
+   return((i > j) - (i < j));
+}                               /* end of cmplevel */
+
+
+int  cmpindex(const void *a, const void *b)
+/*
+**--------------------------------------------------------------
+**  Input:   a, b = pointers to control indexes                  
+**  Output:  returns -1, 0 or 1                                  
+**  Purpose: orders controls by index (for use with qsort())     
+**--------------------------------------------------------------
+*/
+{
+   int i = *(const int *)a;
+   int j = *(const int *)b;
+
+   return((i > j) - (i < j));
+}                               /* end of cmpindex */
+
+
+int  nextcontrol(int *list, int n, long t)
+/*
+**--------------------------------------------------------------
+**  Input:   list = controls sorted by time                      
+**           n    = number of controls in list                   
+**           t    = a time                                       
+**  Output:  returns position in list of first control whose     
+**           time comes after t (n if there is none)             
+**  Purpose: finds the next time control due after time t        
+**--------------------------------------------------------------
+*/
+{
+   int  lo = 0, hi = n, m;
+
+   while (lo < hi)
+   {
+      m = (lo + hi)/2;
+      if (Control[list[m]].Time > t) hi = m;
+      else lo = m + 1;
+   }
+   return(lo);
+}                               /* end of nextcontrol */
+
+
+int  allochistory()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  returns error code                                  
+**  Purpose: allocates the arrays of recent solutions used by    
+**           predictor() (only if a predictor is used)           
+**--------------------------------------------------------------
+*/
+{
+   int  j;
+
+   Nhist = 0;
+   Xhist = NULL;
+   Shist = NULL;
+   if (Predictor == NOPRED) return(0);
+   Xhist = (double *) calloc(3*(Nlinks+Njuncs+2), sizeof(double));
+   Shist = (char *) calloc(Nlinks+1, sizeof(char));
+   if (Xhist == NULL || Shist == NULL) return(101);
+   Qhist[0] = Xhist;
+   Hhist[0] = Xhist + 3*(Nlinks+1);
+   for (j=1; j<3; j++)
+   {
+      Qhist[j] = Qhist[j-1] + Nlinks + 1;
+      Hhist[j] = Hhist[j-1] + Njuncs + 1;
+   }
+   return(0);
+}                               /* end of allochistory */
+
+
+void  savehistory()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  none                                                
+**  Purpose: saves the solution just found as the most recent    
+**           one used by predictor()                             
+**                                                              
+**  NOTE: Solutions found with a different status of any link    
+**        are discarded. A solution at the same total demand as  
+**        the most recent one replaces it, so that the saved     
+**        solutions are at distinct demands.                     
+**--------------------------------------------------------------
+*/
+{
+   int    i;
+   double *q, *h;
+
+   for (i=1; i<=Nlinks; i++)
+   {
+      if (S[i] != Shist[i])
+      {
+         Nhist = 0;
+         break;
+      }
+   }
+
+   /* Re-use the storage of the oldest solution */
+   if (Nhist == 0 || ABS(Dsystem - Dhist[0]) > 1.e-3*ABS(Dhist[0]))
+   {
+      q = Qhist[2];
+      h = Hhist[2];
+      for (i=2; i>0; i--)
+      {
+         Qhist[i] = Qhist[i-1];
+         Hhist[i] = Hhist[i-1];
+         Dhist[i] = Dhist[i-1];
+      }
+      Qhist[0] = q;
+      Hhist[0] = h;
+      if (Nhist < 3) Nhist++;
+   }
+   Dhist[0] = Dsystem;
+   memcpy(Qhist[0], Q, (Nlinks+1)*sizeof(double));
+   memcpy(Hhist[0], H, (Njuncs+1)*sizeof(double));
+   memcpy(Shist, S, (Nlinks+1)*sizeof(char));
+}                               /* end of savehistory */
+
+
+void  predictor()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  none                                                
+**  Purpose: predicts the link flows & junction heads of the     
+**           current period from the solutions of recent periods 
+**           to start netsolve() from                            
+**                                                              
+**  NOTE: Flows & heads are extrapolated as functions of the     
+**        total system demand found by demands(), from the last  
+**        two solutions (LINEAR) or last three (QUADRATIC). No   
+**        prediction is made if any link's status has changed    
+**        since those solutions, if demand changed too little    
+**        between them, or if the new demand is more than twice  
+**        the last change away. A predicted flow that reverses   
+**        direction is not used.                                 
+**--------------------------------------------------------------
+*/
+{
+   int    i;
+   double x, x0, x1, x2, dx, w0, w1, w2, q;
+
+   /* Only use solutions with the current link status */
+   if (Nhist < 2) return;
+   for (i=1; i<=Nlinks; i++)
+   {
+      if (S[i] != Shist[i])
+      {
+         Nhist = 0;
+         return;
+      }
+   }
+
+   /* Weights of solutions for linear extrapolation */
+   x = Dsystem;
+   x0 = Dhist[0];
+   x1 = Dhist[1];
+   x2 = Dhist[2];
+   dx = 1.e-3*ABS(x0);
+   if (ABS(x0 - x1) <= dx) return;
+   if (ABS(x - x0) > 2.0*ABS(x0 - x1)) return;
+   w1 = (x0 - x)/(x0 - x1);
+   w0 = 1.0 - w1;
+   w2 = 0.0;
+
+   /* Weights for quadratic extrapolation (Lagrange polynomial), */
+   /* if demand has kept changing in the same direction           */
+   if (Predictor == QUADPRED && Nhist > 2
+   && (x0 - x1)*(x1 - x2) > 0.0 && (x - x0)*(x0 - x1) >= 0.0
+   && ABS(x1 - x2) > dx)
+   {
+      w0 = (x - x1)*(x - x2)/((x0 - x1)*(x0 - x2));
+      w1 = (x - x0)*(x - x2)/((x1 - x0)*(x1 - x2));
+      w2 = (x - x0)*(x - x1)/((x2 - x0)*(x2 - x1));
+   }
+
+   /* Predict flows in open links & heads at junctions */
+   for (i=1; i<=Nlinks; i++)
+   {
+      if (S[i] <= CLOSED) continue;
+      q = w0*Qhist[0][i] + w1*Qhist[1][i] + w2*Qhist[2][i];
+      if (q*Qhist[0][i] > 0.0) Q[i] = q;
+   }
+   for (i=1; i<=Njuncs; i++)
+   {
+      H[i] = w0*Hhist[0][i] + w1*Hhist[1][i] + w2*Hhist[2][i];
+   }
+}                               /* end of predictor */
+
+
+int  alloccache()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  returns error code                                  
+**  Purpose: allocates the cache of solutions used by            
+**           findcache() (only if a cache tolerance is set)      
+**                                                              
+**  NOTE: The storage of each cached solution is allocated by    
+**        savecache() the first time it is used.                 
+**--------------------------------------------------------------
+*/
+{
+   Cache = NULL;
+   Ckey = NULL;
+   Cstat = NULL;
+   Ncache = 0;
+   Cnext = 0;
+   if (CacheTol <= 0.0) return(0);
+   Nkey = Npats + 1 + Xtype[GPV+1] - Xtype[PUMP] + Ntanks;
+   Cache = (Scache *) calloc(MAXCACHE, sizeof(Scache));
+   Ckey = (double *) calloc(Nkey, sizeof(double));
+   Cstat = (char *) calloc(Nlinks+1, sizeof(char));
+   if (Cache == NULL || Ckey == NULL || Cstat == NULL) return(101);
+   return(0);
+}                               /* end of alloccache */
+
+
+void  clearcache()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  none                                                
+**  Purpose: discards all cached solutions (e.g. after a change  
+**           to the network's data)                              
+**--------------------------------------------------------------
+*/
+{
+   Ncache = 0;
+   Cnext = 0;
+}                               /* end of clearcache */
+
+
+int  findcache(int *iter, double *relerr)
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  *iter   = # trials taken by the cached solution     
+**           *relerr = its convergence error                     
+**           returns 1 if a cached solution was used, 0 if not   
+**  Purpose: looks for the solution of an earlier period with    
+**           the same boundary conditions as the current one and 
+**           if found makes it the current solution              
+**                                                              
+**  NOTE: The key of a period is its pattern factors, the status 
+**        of all links & settings of pumps & valves after        
+**        controls() and the heads of tanks & reservoirs rounded 
+**        to a multiple of CacheTol. Junction heads, link flows, 
+**        emitter flows and link status & settings are restored, 
+**        while tank heads keep their current values.            
+**--------------------------------------------------------------
+*/
+{
+   int      i, j, n;
+   unsigned h;
+   unsigned char *p;
+   double   *x;
+   Scache   *c;
+
+   /* Form the key of the current period */
+   n = 0;
+   for (j=0; j<=Npats; j++) Ckey[n++] = Pfactor[j];
+   for (i=Xtype[PUMP]; i<Xtype[GPV+1]; i++) Ckey[n++] = K[Typelist[i]];
+   for (i=Njuncs+1; i<=Nnodes; i++) Ckey[n++] = floor(H[i]/CacheTol + 0.5);
+   memcpy(Cstat, S, (Nlinks+1)*sizeof(char));
+
+   /* Hash the key (FNV-1a) */
+   h = 2166136261u;
+   p = (unsigned char *)Ckey;
+   for (i=0; i<Nkey*(int)sizeof(double); i++) h = (h ^ p[i])*16777619u;
+   p = (unsigned char *)Cstat;
+   for (i=0; i<=Nlinks; i++) h = (h ^ p[i])*16777619u;
+   Chash = h;
+
+   /* Look for a cached solution with the same key */
+   for (j=0; j<Ncache; j++)
+   {
+      c = &Cache[j];
+      if (c->Hash != h
+      || memcmp(c->X, Ckey, Nkey*sizeof(double)) != 0
+      || memcmp(c->S, Cstat, (Nlinks+1)*sizeof(char)) != 0) continue;
+
+      /* Restore its solution */
+      x = c->X + Nkey;
+      memcpy(H, x, (Njuncs+1)*sizeof(double));
+      x += Njuncs + 1;
+      memcpy(Q, x, (Nlinks+1)*sizeof(double));
+      x += Nlinks + 1;
+      memcpy(E, x, (Njuncs+1)*sizeof(double));
+      x += Njuncs + 1;
+      for (i=Xtype[PUMP]; i<Xtype[GPV+1]; i++) K[Typelist[i]] = *x++;
+      memcpy(S, c->S + Nlinks + 1, (Nlinks+1)*sizeof(char));
+
+      /* Update tank inflows & add emitter flows to demands */
+      /* as netsolve() would                                */
+      tankflows();
+      for (i=1; i<=Njuncs; i++) D[i] += E[i];
+      *iter = c->Iter;
+      *relerr = c->Relerr;
+      CacheHits++;
+      return(1);
+   }
+   CacheMisses++;
+   return(0);
+}                               /* end of findcache */
+
+
+void  savecache(int iter, double relerr)
+/*
+**--------------------------------------------------------------
+**  Input:   iter   = # trials taken by the solution             
+**           relerr = its convergence error                      
+**  Output:  none                                                
+**  Purpose: saves the solution just found in the cache under    
+**           the key formed by findcache(), replacing the oldest 
+**           cached solution once the cache is full              
+**--------------------------------------------------------------
+*/
+{
+   int    i;
+   double *x;
+   Scache *c = &Cache[Cnext];
+
+   /* Allocate storage for a new entry (not caching if none) */
+   if (c->X == NULL)
+   {
+      c->X = (double *) calloc(Nkey + 2*(Njuncs+1) + Nlinks + 1
+                               + Xtype[GPV+1] - Xtype[PUMP], sizeof(double));
+      c->S = (char *) calloc(2*(Nlinks+1), sizeof(char));
+      if (c->X == NULL || c->S == NULL)
+      {
+         free(c->X);
+         free(c->S);
+         c->X = NULL;
+         c->S = NULL;
+         return;
+      }
+   }
+
+   /* Save the key & the solution */
+   c->Hash = Chash;
+   memcpy(c->X, Ckey, Nkey*sizeof(double));
+   memcpy(c->S, Cstat, (Nlinks+1)*sizeof(char));
+   x = c->X + Nkey;
+   memcpy(x, H, (Njuncs+1)*sizeof(double));
+   x += Njuncs + 1;
+   memcpy(x, Q, (Nlinks+1)*sizeof(double));
+   x += Nlinks + 1;
+   memcpy(x, E, (Njuncs+1)*sizeof(double));
+   x += Njuncs + 1;
+   for (i=Xtype[PUMP]; i<Xtype[GPV+1]; i++) *x++ = K[Typelist[i]];
+   memcpy(c->S + Nlinks + 1, S, (Nlinks+1)*sizeof(char));
+   c->Iter = iter;
+   c->Relerr = relerr;
+   Cnext = (Cnext + 1) % MAXCACHE;
+   if (Ncache < MAXCACHE) Ncache++;
+}                               /* end of savecache */
+
+
+void  loadpipes()
+/*
+**--------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  none                                                
+**  Purpose: copies the resistance & minor loss coeffs. of each  
+**           pipe (plus the D-W friction factor's diameter terms)
+**           into the pipe arrays used by pipecoeffs()           
+**                                                              
+**  NOTE: These only change between calls to netsolve(), e.g.    
+**        by ENsetlinkvalue(), so are copied once per call.      
+**--------------------------------------------------------------
+*/
+{
+   int  i, k;
+
+   for (i=0; i<Xtype[PUMP]; i++)
+   {
+      k = Typelist[i];
+      Pr[i]  = Link[k].R;
+      Pkm[i] = Link[k].Km;
+   }
+   if (Formflag == DW) for (i=0; i<Xtype[PUMP]; i++)
+   {
+      k = Typelist[i];
+      Pvd[i] = Viscos*Link[k].Diam;
+      Prr[i] = Link[k].Kc/(3.7*Link[k].Diam);
+   }
+}                               /* end of loadpipes */
+
+
 void  initlinkflow(int i, char s, double k)
 /*
 **--------------------------------------------------------------------
@@ -578,28 +1408,36 @@ void  demands()
 **--------------------------------------------------------------------
 */
 {
-   int i,j,n;
+   int i,j,m,n;
    long k,p;
    double djunc, sum;
-   Pdemand demand;
 
    /* Determine total elapsed number of pattern periods */
    p = (Htime+Pstart)/Pstep;
 
-   /* Update demand at each node according to its assigned pattern */
+   /* Find the current factor of each pattern, where    */
+   /*   pattern period (k) = (elapsed periods) modulus  */
+   /*                        (periods per pattern)      */
+   /* (Unused pattern slots can have no periods.)       */
+   for (j=0; j<=Npats; j++)
+   {
+      if (Pattern[j].Length == 0) continue;
+      k = p % (long) Pattern[j].Length;
+      Pfactor[j] = Pattern[j].F[k];
+   }
+
+   /* Compute the flow of every demand category at once */
+   n = Xdemand[Njuncs+1];
+   for (m=0; m<n; m++) Dflow[m] = Dbase[m]*Pfactor[Dpat[m]]*Dmult;
+
+   /* Update demand at each node by summing its categories */
    Dsystem = 0.0;          /* System-wide demand */
    for (i=1; i<=Njuncs; i++)
    {
       sum = 0.0;
-      for (demand = Node[i].D; demand != NULL; demand = demand->next)
+      for (m=Xdemand[i]; m<Xdemand[i+1]; m++)
       {
-         /*
-            pattern period (k) = (elapsed periods) modulus
-                                 (periods per pattern)
-         */
-         j = demand->Pat;
-         k = p % (long) Pattern[j].Length;
-         djunc = (demand->Base)*Pattern[j].F[k]*Dmult;
+         djunc = Dflow[m];
          if (djunc > 0.0) Dsystem += djunc;
          sum += djunc;
       }
@@ -614,9 +1452,8 @@ void  demands()
          j = Tank[n].Pat;
          if (j > 0)
          {
-            k = p % (long) Pattern[j].Length;
             i = Tank[n].Node;
-            H[i] = Node[i].El*Pattern[j].F[k];
+            H[i] = Node[i].El*Pfactor[j];
          }
       }
    }
@@ -628,8 +1465,7 @@ void  demands()
       if (j > 0)
       {
          i = Pump[n].Link;           
-         k = p % (long) Pattern[j].Length;
-         setlinksetting(i, Pattern[j].F[k], &S[i], &K[i]);
+         setlinksetting(i, Pfactor[j], &S[i], &K[i]);
       }
    }
 }                        /* End of demands */
@@ -641,66 +1477,93 @@ int  controls()
 **  Input:   none                                                   
 **  Output:  number of links whose setting changes                  
 **  Purpose: implements simple controls based on time or tank levels  
+**
+**  NOTE: Uses the lists made by controllists(), so that only the
+**        level controls whose tank level has been reached (plus
+**        one more per list) and the time controls due at the
+**        current time are examined. The controls that apply are
+**        then carried out in order of index, as if all had been
+**        examined in turn.
 **---------------------------------------------------------------------
 */
 {
-   int   i, k, n, reset, setsum;
+   int   i, j, k, m, n, nfired, setsum;
    double h, vplus;
    double v1, v2;
    double k1, k2;
    char  s1, s2;
-
-   /* Examine each control statement */
-   setsum = 0;
-   for (i=1; i<=Ncontrols; i++)
-   {
-      /* Make sure that link is defined */
-      reset = 0;
-      if ( (k = Control[i].Link) <= 0) continue;
-
-      /* Link is controlled by tank level */
-      if ((n = Control[i].Node) > 0 && n > Njuncs)
+   long  t1;
+
+   /* Level controls on each tank: LOWLEVEL ones from the highest */
+   /* level down and HILEVEL ones from the lowest level up, until */
+   /* one isn't reached */
+   nfired = 0;
+   for (j=Njctlnodes; j<Nctlnodes; j++)
+   {
+      n = Ctlnode[j];
+      h = H[n];
+      vplus = ABS(D[n]);
+      v1 = tankvolume(n-Njuncs,h);
+      for (m=Xhictl[n]-1; m>=Xnodectl[n]; m--)
       {
-         h = H[n];
-         vplus = ABS(D[n]);
-         v1 = tankvolume(n-Njuncs,h);
+         i = Nodectl[m];
+         ControlEvals++;
          v2 = tankvolume(n-Njuncs,Control[i].Grade);
-         if (Control[i].Type == LOWLEVEL && v1 <= v2 + vplus)
-            reset = 1;
-         if (Control[i].Type == HILEVEL && v1 >= v2 - vplus)
-            reset = 1;
+         if (v1 > v2 + vplus) break;
+         Ctlfired[nfired++] = i;
       }
-
-      /* Link is time-controlled */
-      if (Control[i].Type == TIMER)
+      for (m=Xhictl[n]; m<Xnodectl[n+1]; m++)
       {
-          if (Control[i].Time == Htime) reset = 1;
+         i = Nodectl[m];
+         ControlEvals++;
+         v2 = tankvolume(n-Njuncs,Control[i].Grade);
+         if (v1 < v2 - vplus) break;
+         Ctlfired[nfired++] = i;
       }
+   }
 
-      /* Link is time-of-day controlled */
-      if (Control[i].Type == TIMEOFDAY)
-      {
-          if ((Htime + Tstart) % SECperDAY == Control[i].Time) reset = 1;
-      }
+   /* TIMER controls due at the current time */
+   for (m=nextcontrol(Timerctl,Ntimers,Htime-1); m<Ntimers; m++)
+   {
+      i = Timerctl[m];
+      ControlEvals++;
+      if (Control[i].Time != Htime) break;
+      Ctlfired[nfired++] = i;
+   }
+
+   /* TIMEOFDAY controls due at the current time of day */
+   t1 = (Htime + Tstart) % SECperDAY;
+   for (m=nextcontrol(Todctl,Ntods,t1-1); m<Ntods; m++)
+   {
+      i = Todctl[m];
+      ControlEvals++;
+      if (Control[i].Time != t1) break;
+      Ctlfired[nfired++] = i;
+   }
+
+   /* Examine each control that applies in order of index */
+   qsort(Ctlfired, nfired, sizeof(int), cmpindex);
+   setsum = 0;
+   for (m=0; m<nfired; m++)
+   {
+      i = Ctlfired[m];
+      k = Control[i].Link;
 
       /* Update link status & pump speed or valve setting */
-      if (reset == 1)
+      if (S[k] <= CLOSED) s1 = CLOSED;
+      else                s1 = OPEN;
+      s2 = Control[i].Status;
+      k1 = K[k];
+      k2 = k1;
+      if (Link[k].Type > PIPE) k2 = Control[i].Setting;
+      if (s1 != s2 || k1 != k2)
       {
-         if (S[k] <= CLOSED) s1 = CLOSED;
-         else                s1 = OPEN;
-         s2 = Control[i].Status;
-         k1 = K[k];
-         k2 = k1;
-         if (Link[k].Type > PIPE) k2 = Control[i].Setting;
-         if (s1 != s2 || k1 != k2)
-         {
-            S[k] = s2;
-            K[k] = k2;
-            if (Statflag) writecontrolaction(k,i);
- //           if (s1 != s2) initlinkflow(k, S[k], K[k]);
-            setsum++;
-         }
-      }   
+         S[k] = s2;
+         K[k] = k2;
+         if (Statflag) writecontrolaction(k,i);
+ //        if (s1 != s2) initlinkflow(k, S[k], K[k]);
+         setsum++;
+      }
    }
    return(setsum);
 }                        /* End of controls */
@@ -786,22 +1649,40 @@ void  controltimestep(long *tstep)
 **  Output:  *tstep = modified current time step   
 **  Purpose: revises time step based on shortest time to activate
 **           a simple control  
+**
+**  NOTE: Uses the lists made by controllists(), so that only the
+**        HILEVEL controls on tanks that are filling, LOWLEVEL ones
+**        on tanks that are draining and the time controls due
+**        within the time step are examined.
+**        Time controls are examined in order of time until one is
+**        found that would change its link.
 **------------------------------------------------------------------
 */
 {
-   int   i,j,k,n;
+   int   i,j,m,m0,m1,n;
    double h,q,v;
-   long  t,t1,t2;
+   long  t,t1;
 
-   for (i=1; i<=Ncontrols; i++)
+   /* Level controls on each tank */
+   for (j=1; j<=Ntanks; j++)
    {
-      t = 0;
-      if ( (n = Control[i].Node) > 0)           /* Node control:       */
+      n = Tank[j].Node;
+      h = H[n];                                 /* Current tank grade  */
+      q = D[n];                                 /* Flow into tank      */
+      if (ABS(q) <= QZERO) continue;
+      if (q > 0.0)
+      {
+         m0 = Xhictl[n];
+         m1 = Xnodectl[n+1];
+      }
+      else
+      {
+         m0 = Xnodectl[n];
+         m1 = Xhictl[n];
+      }
+      for (m=m0; m<m1; m++)
       {
-         if ((j = n-Njuncs) <= 0) continue;     /* Node is a tank      */
-         h = H[n];                              /* Current tank grade  */
-         q = D[n];                              /* Flow into tank      */
-         if (ABS(q) <= QZERO) continue;
+         i = Nodectl[m];
          if
          ( (h < Control[i].Grade &&
             Control[i].Type == HILEVEL &&       /* Tank below hi level */
@@ -813,35 +1694,72 @@ void  controltimestep(long *tstep)
          {                                      /* Time to reach level  */
             v = tankvolume(j,Control[i].Grade)-Tank[j].V;
             t = (long)ROUND(v/q);
+            if (t > 0 && t < *tstep && controlchange(i)) *tstep = t;
          }
       }
+   }
 
-      if (Control[i].Type == TIMER)             /* Time control:        */
-      {              
-         if (Control[i].Time > Htime)
-             t = Control[i].Time - Htime;
+   /* TIMER controls due after the current time */
+   for (m=nextcontrol(Timerctl,Ntimers,Htime); m<Ntimers; m++)
+   {
+      i = Timerctl[m];
+      t = Control[i].Time - Htime;
+      if (t >= *tstep) break;
+      if (controlchange(i))
+      {
+         *tstep = t;
+         break;
       }
+   }
 
-      if (Control[i].Type == TIMEOFDAY)         /* Time-of-day control: */
+   /* TIMEOFDAY controls due later today, and then those */
+   /* due tomorrow (before the current time of day)      */
+   t1 = (Htime + Tstart) % SECperDAY;
+   m0 = nextcontrol(Todctl,Ntods,t1);
+   for (m=m0; m<Ntods; m++)
+   {
+      i = Todctl[m];
+      t = Control[i].Time - t1;
+      if (t >= *tstep) break;
+      if (controlchange(i))
       {
-         t1 = (Htime + Tstart) % SECperDAY;
-         t2 = Control[i].Time;
-         if (t2 >= t1) t = t2 - t1;
-         else t = SECperDAY - t1 + t2;
+         *tstep = t;
+         break;
       }
-
-      if (t > 0 && t < *tstep)               /* Revise time step     */
+   }
+   for (m=0; m<m0; m++)
+   {
+      i = Todctl[m];
+      if (Control[i].Time == t1) break;
+      t = SECperDAY - t1 + Control[i].Time;
+      if (t >= *tstep) break;
+      if (controlchange(i))
       {
-         /* Check if rule actually changes link status or setting */
-         k = Control[i].Link;
-         if (
-              (Link[k].Type > PIPE && K[k] != Control[i].Setting) ||
-              (S[k] != Control[i].Status)
-            )
-            *tstep = t;
+         *tstep = t;
+         break;
       }
    }
-}                        /* End of timestep */
+}                        /* End of controltimestep */
+
+
+int  controlchange(int i)
+/*
+**------------------------------------------------------------------
+**  Input:   i = control index                                                
+**  Output:  returns 1 if control would change its link, 0 if not
+**  Purpose: checks if a simple control actually changes its link's
+**           status or setting
+**------------------------------------------------------------------
+*/
+{
+   int k = Control[i].Link;
+   if (
+        (Link[k].Type > PIPE && K[k] != Control[i].Setting) ||
+        (S[k] != Control[i].Status)
+      )
+      return(1);
+   return(0);
+}                        /* End of controlchange */
 
 
 void  ruletimestep(long *tstep)
@@ -856,8 +1774,10 @@ void  ruletimestep(long *tstep)
 {
    long tnow,      /* Start of time interval for rule evaluation */
         tmax,      /* End of time interval for rule evaluation   */
+        tnext,     /* Time when rules must next be checked       */
         dt,        /* Normal time increment for rule evaluation  */
         dt1;       /* Actual time increment for rule evaluation  */
+   int  all;       /* TRUE if all rules must be checked          */
 
    /* Find interval of time for rule evaluation */
    tnow = Htime;
@@ -894,12 +1814,24 @@ void  ruletimestep(long *tstep)
    **       rule evaluation process is completed (see below).
    **       Also note that dt1 will equal dt after the first
    **       time increment is taken.
+   **       Rules are only checked once the time is reached at
+   **       which some premise might change (see nextrulecheck()
+   **       in RULES.C); before then none of them can fire.
+   **       Only the first check evaluates all rules, later
+   **       ones just those on time & tank levels.
    */
+   tnext = tnow;
+   all = TRUE;
    do
    {
       Htime += dt1;               /* Update simulation clock */
       tanklevels(dt1);            /* Find new tank levels    */
-      if (checkrules(dt1)) break; /* Stop if rules fire      */
+      if (Htime >= tnext)
+      {
+         if (checkrules(dt1, all)) break;  /* Stop if rules fire */
+         all = FALSE;
+         tnext = nextrulecheck(dt, tmax);  /* Next time to check */
+      }
       dt = MIN(dt, tmax - Htime); /* Update time increment   */
       dt1 = dt;                   /* Update actual increment */
    }  while (dt > 0);             /* Stop if no time left    */
@@ -1137,7 +2069,15 @@ int  netsolve(int *iter, double *relerr)
 **           another ExtraIter trials are made with no status changes
 **           made to any links and a warning message is generated.
 **                                                             
-**   This procedure calls linsolve() which appears in SMATRIX.C. 
+**   This procedure calls linsolve(), pcgsolve(), updsolve() or  
+**   mixsolve() which appear in SMATRIX.C. If pcgsolve() fails  
+**   to converge, the direct solver is used from then on (see   
+**   pcgfallback()). If a trial solved by mixsolve() does not   
+**   reduce the convergence error, the rest of the trials use   
+**   the double precision linsolve(), since a single precision  
+**   factor of an ill-conditioned matrix (e.g. one with nodes   
+**   cut off by closed links) may not give Newton steps that    
+**   converge.                                                  
 **-------------------------------------------------------------------
 */
 {
@@ -1148,11 +2088,18 @@ int  netsolve(int *iter, double *relerr)
    double newerr;                /* New convergence error */
    int    valveChange;           /* Valve status change flag */
    int    statChange;
+   int    mixed;                 /* Mixed precision solver flag */
+   double lasterr;               /* Last convergence error */
 
    /* Initialize status checking & relaxation factor */   
    nextcheck = CheckFreq;
    RelaxFactor = 1.0;
+   mixed = (Precision == MIXEDPREC);
+   lasterr = 0.0;
   
+   /* Pick up any changes made to pipe properties */
+   loadpipes();
+
    /* Repeat iterations until convergence or trial limit is exceeded. */
    /* (ExtraIter used to increase trials in case of status cycling.)  */
    if (Statflag == FULL) writerelerr(0,0);
@@ -1168,7 +2115,14 @@ int  netsolve(int *iter, double *relerr)
       ** Solution for H is returned in F from call to linsolve().
       */
       newcoeffs();
-      errcode = linsolve(Njuncs,Aii,Aij,F);
+      if (Solver == PCG && (errcode = pcgsolve(Njuncs,Aii,Aij,F)) < 0)
+      {
+         if (pcgfallback()) break;
+      }
+      if      (Solver == PCG)          ;
+      else if (UpdateLimit > 0.0)      errcode = updsolve(Njuncs,Aii,Aij,F);
+      else if (mixed)                  errcode = mixsolve(Njuncs,Aii,Aij,F);
+      else                             errcode = linsolve(Njuncs,Aii,Aij,F);
 
       /* Take action depending on error code */
       if (errcode < 0) break;    /* Memory allocation problem */
@@ -1186,6 +2140,11 @@ int  netsolve(int *iter, double *relerr)
       newerr = newflows();                          /* Update flows */
       *relerr = newerr;
 
+      /* Switch to a double precision factor if mixed */
+      /* precision fails to reduce the error          */
+      if (mixed && *iter > 1 && newerr >= lasterr) mixed = FALSE;
+      lasterr = newerr;
+
       /* Write convergence error to status report if called for */
       if (Statflag == FULL) writerelerr(*iter,*relerr);
 
@@ -1243,6 +2202,38 @@ int  netsolve(int *iter, double *relerr)
 }                        /* End of netsolve */
 
 
+int  pcgfallback()
+/*
+**-----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns 0 if successful, -1 if out of memory
+**  Purpose: switches from the PCG solver, which failed to converge,
+**           to the direct (Cholesky) solver for the rest of the
+**           run and re-computes the current coeff. matrix for it.
+**
+**  Note:    The sparse storage scheme is re-created with the fill-
+**           ins that the direct solver needs, so the off-diagonal
+**           coeffs. array is re-sized to match. The SOLVER option
+**           is restored by closehyd().
+**-----------------------------------------------------------------
+*/
+{
+   int    errcode = 0;
+   double *aij;
+
+   freesparse();
+   Solver = CHOLESKY;
+   Pcgfail = TRUE;
+   errcode = createsparse();
+   if (errcode) return(-1);
+   aij = (double *) realloc(Aij, (Ncoeffs+1)*sizeof(double));
+   if (aij == NULL) return(-1);
+   Aij = aij;
+   newcoeffs();
+   return(0);
+}                        /* End of pcgfallback */
+
+
 int  badvalve(int n)
 /*
 **-----------------------------------------------------------------
@@ -1653,66 +2644,79 @@ int  pswitch()
 **  Output:  returns 1 if status of any link changes, 0 if not   
 **  Purpose: adjusts settings of links controlled by junction    
 **           pressures after a hydraulic solution is found       
+**                                                              
+**  NOTE: Like controls(), only examines the controls on each    
+**        junction whose level has been reached (plus one more   
+**        per list) and carries them out in order of index.      
 **--------------------------------------------------------------
 */
 {
    int   i,                 /* Control statement index */
+         j,                 /* Position in Ctlnode */
          k,                 /* Link being controlled */
+         m,                 /* Position in Nodectl */
          n,                 /* Node controlling link */
-         reset,             /* Flag on control conditions */
+         nfired,            /* Number of controls that apply */
          change,            /* Flag for status or setting change */
          anychange = 0;     /* Flag for 1 or more changes */
    char  s;                 /* Current link status */
 
-   /* Check each control statement */
-   for (i=1; i<=Ncontrols; i++)
+   /* Find the controls whose conditions are satisfied on each junction */
+   nfired = 0;
+   for (j=0; j<Njctlnodes; j++)
    {
-      reset = 0;
-      if ( (k = Control[i].Link) <= 0) continue;
-
-      /* Determine if control based on a junction, not a tank */
-      if ( (n = Control[i].Node) > 0 && n <= Njuncs)
+      n = Ctlnode[j];
+      for (m=Xhictl[n]-1; m>=Xnodectl[n]; m--)
+      {
+         i = Nodectl[m];
+         ControlEvals++;
+         if (H[n] > Control[i].Grade + Htol) break;
+         Ctlfired[nfired++] = i;
+      }
+      for (m=Xhictl[n]; m<Xnodectl[n+1]; m++)
       {
-         /* Determine if control conditions are satisfied */
-         if (Control[i].Type == LOWLEVEL
-             && H[n] <= Control[i].Grade + Htol )
-             reset = 1;
-         if (Control[i].Type == HILEVEL
-             && H[n] >= Control[i].Grade - Htol )
-             reset = 1;
+         i = Nodectl[m];
+         ControlEvals++;
+         if (H[n] < Control[i].Grade - Htol) break;
+         Ctlfired[nfired++] = i;
       }
+   }
+
+   /* Check each such control statement in order of index */
+   qsort(Ctlfired, nfired, sizeof(int), cmpindex);
+   for (m=0; m<nfired; m++)
+   {
+      i = Ctlfired[m];
+      k = Control[i].Link;
 
       /* Determine if control forces a status or setting change */
-      if (reset == 1)
+      change = 0;
+      s = S[k];
+      if (Link[k].Type == PIPE)
       {
-         change = 0;
-         s = S[k];
-         if (Link[k].Type == PIPE)
-         {
-            if (s != Control[i].Status) change = 1;
-         }
-         if (Link[k].Type == PUMP)
-         {
-            if (K[k] != Control[i].Setting) change = 1;
-         }
-         if (Link[k].Type >= PRV)
-         {
-            if (K[k] != Control[i].Setting) change = 1;
-            else if (K[k] == MISSING &&
-                     s != Control[i].Status) change = 1;
-         }
+         if (s != Control[i].Status) change = 1;
+      }
+      if (Link[k].Type == PUMP)
+      {
+         if (K[k] != Control[i].Setting) change = 1;
+      }
+      if (Link[k].Type >= PRV)
+      {
+         if (K[k] != Control[i].Setting) change = 1;
+         else if (K[k] == MISSING &&
+                  s != Control[i].Status) change = 1;
+      }
 
-         /* If a change occurs, update status & setting */
-         if (change)
-         {
-            S[k] = Control[i].Status;
-            if (Link[k].Type > PIPE) K[k] = Control[i].Setting;
-            if (Statflag == FULL) writestatchange(k,s,S[k]); 
+      /* If a change occurs, update status & setting */
+      if (change)
+      {
+         S[k] = Control[i].Status;
+         if (Link[k].Type > PIPE) K[k] = Control[i].Setting;
+         if (Statflag == FULL) writestatchange(k,s,S[k]); 
 
-            /* Re-set flow if status has changed */
+         /* Re-set flow if status has changed */
 //            if (S[k] != s) initlinkflow(k, S[k], K[k]);
-            anychange = 1;
-         }
+         anychange = 1;
       }
    }
    return(anychange);
@@ -1728,21 +2732,99 @@ double newflows()
 **----------------------------------------------------------------
 */
 {
-   double  dh,                    /* Link head loss       */
-           dq;                    /* Link flow change     */
+   double  dq;                    /* Link flow change     */
    double  dqsum,                 /* Network flow change  */
            qsum;                  /* Network total flow   */
-   int   k, n, n1, n2;
+   int   b, k, nb;
+
+   /* Update flows in all links, one block of QBLOCK links   */
+   /* at a time. The flows & corrections are summed by block */
+   /* and then the block sums are added up in order, so the  */
+   /* totals don't depend on the number of threads used.     */
+   nb = (Nlinks + QBLOCK - 1)/QBLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for private(b) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (b=0; b<nb; b++) blockflows(b);
+   qsum  = 0.0;
+   dqsum = 0.0;
+   for (b=0; b<nb; b++)
+   {
+      qsum += Qblock[b];
+      dqsum += Dqblock[b];
+   }
+
+   /* Update net flows to tanks (i.e., their demands) */
+   tankflows();
+
+   /* Update emitter flows */
+   for (k=1; k<=Njuncs; k++)
+   {
+      if (Node[k].Ke == 0.0) continue;
+      dq = emitflowchange(k);
+      E[k] -= dq;
+      qsum += ABS(E[k]);
+      dqsum += ABS(dq);
+   }
+
+   /* Return ratio of total flow corrections to total flow */
+   if (qsum > Hacc) return(dqsum/qsum);
+   else return(dqsum);
+
+}                        /* End of newflows */
+
+
+void  tankflows()
+/*
+**----------------------------------------------------------------
+**  Input:   none                                                
+**  Output:  none                                                
+**  Purpose: updates net flows into tanks (i.e., their demands)   
+**           from the current link flows                          
+**----------------------------------------------------------------
+*/
+{
+   int   i, k, n;
+
+   for (n=Njuncs+1; n <= Nnodes; n++)
+   {
+      D[n] = 0.0;
+      for (i=Xnode[n]; i<Xnode[n+1]; i++)
+      {
+         k = Nodelink[i];
+         if (S[k] <= CLOSED) continue;                                        //(2.00.12 - LR)
+         if (Link[k].N1 == n) D[n] -= Q[k];
+         else                 D[n] += Q[k];
+      }
+   }
+}                        /* End of tankflows */
 
-   /* Initialize net inflows (i.e., demands) at tanks */
-   for (n=Njuncs+1; n <= Nnodes; n++) D[n] = 0.0;
+
+void  blockflows(int b)
+/*
+**----------------------------------------------------------------
+**  Input:   b = block index                                     
+**  Output:  none                                                
+**  Purpose: updates flows in the links of block b (links        
+**           b*QBLOCK+1 to (b+1)*QBLOCK) and sums their absolute 
+**           flows & flow corrections in Qblock[b] & Dqblock[b]  
+**----------------------------------------------------------------
+*/
+{
+   double  dh,                    /* Link head loss       */
+           dq;                    /* Link flow change     */
+   double  dqsum,                 /* Block flow change    */
+           qsum;                  /* Block total flow     */
+   int   k, k1, k2, n, n1, n2;
 
    /* Initialize sum of flows & corrections */
    qsum  = 0.0;
    dqsum = 0.0;
 
-   /* Update flows in all links */
-   for (k=1; k<=Nlinks; k++)
+   /* Update flows in the block's links */
+   k1 = b*QBLOCK + 1;
+   k2 = MIN(Nlinks, (b+1)*QBLOCK);
+   for (k=k1; k<=k2; k++)
    {
 
       /*
@@ -1772,31 +2854,10 @@ double newflows()
       /* Update sum of absolute flows & flow corrections */
       qsum += ABS(Q[k]);
       dqsum += ABS(dq);
-
-      /* Update net flows to tanks */
-      if ( S[k] > CLOSED )                                                     //(2.00.12 - LR)
-      {
-         if (n1 > Njuncs) D[n1] -= Q[k];
-         if (n2 > Njuncs) D[n2] += Q[k];
-      }
-
-   }
-
-   /* Update emitter flows */
-   for (k=1; k<=Njuncs; k++)
-   {
-      if (Node[k].Ke == 0.0) continue;
-      dq = emitflowchange(k);
-      E[k] -= dq;
-      qsum += ABS(E[k]);
-      dqsum += ABS(dq);
    }
-
-   /* Return ratio of total flow corrections to total flow */
-   if (qsum > Hacc) return(dqsum/qsum);
-   else return(dqsum);
-
-}                        /* End of newflows */
+   Qblock[b] = qsum;
+   Dqblock[b] = dqsum;
+}                        /* End of blockflows */
 
 
 void   newcoeffs()
@@ -1830,56 +2891,106 @@ void  linkcoeffs()
 **--------------------------------------------------------------
 */
 {
-   int   k,n1,n2;
+   int   b,i,k,n,nb;
+
+   /* Compute P[k] = 1 / (dh/dQ) and Y[k] = h * P[k]   */
+   /* for each link k (where h = link head loss), one  */
+   /* type of link at a time (see typelists()). Pipes  */
+   /* are done in blocks of QBLOCK, split among the    */
+   /* threads.                                         */
+   n = Xtype[PUMP];
+   nb = (n + QBLOCK - 1)/QBLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for private(b) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (b=0; b<nb; b++) pipecoeffs(b*QBLOCK, MIN(n, (b+1)*QBLOCK));
+   for (i=Xtype[PUMP]; i<Xtype[PUMP+1]; i++) pumpcoeff(Typelist[i]);
+   for (i=Xtype[PBV]; i<Xtype[PBV+1]; i++)   pbvcoeff(Typelist[i]);
+   for (i=Xtype[TCV]; i<Xtype[TCV+1]; i++)   tcvcoeff(Typelist[i]);
+   for (i=Xtype[GPV]; i<Xtype[GPV+1]; i++)   gpvcoeff(Typelist[i]);
 
-   /* Examine each link of network */
-   for (k=1; k<=Nlinks; k++)
+   /* If status of a FCV, PRV or PSV is fixed then treat */
+   /* it as a pipe, otherwise ignore the valve for now.  */
+   for (i=Xtype[PRV]; i<Xtype[PSV+1]; i++)
    {
-      n1 = Link[k].N1;           /* Start node of link */
-      n2 = Link[k].N2;           /* End node of link   */
+      k = Typelist[i];
+      if (K[k] == MISSING) valvecoeff(k);
+   }
+   for (i=Xtype[FCV]; i<Xtype[FCV+1]; i++)
+   {
+      k = Typelist[i];
+      if (K[k] == MISSING) valvecoeff(k);
+   }
 
-      /* Compute P[k] = 1 / (dh/dQ) and Y[k] = h * P[k]   */
-      /* for each link k (where h = link head loss).      */
-      /* FCVs, PRVs, and PSVs with non-fixed status       */
-      /* are analyzed later.                              */
+   /* Add the links' coeffs. to the matrix one node at a */
+   /* time, so that no two threads update the same entry */
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (i=1; i<=Nnodes; i++) nodelinkcoeffs(i);
+}                        /* End of linkcoeffs */
 
-      switch (Link[k].Type)
-      {
-         case CV:
-         case PIPE:  pipecoeff(k); break;
-         case PUMP:  pumpcoeff(k); break;
-         case PBV:   pbvcoeff(k);  break;
-         case TCV:   tcvcoeff(k);  break;
-         case GPV:   gpvcoeff(k);  break;
-         case FCV:   
-         case PRV:
-         case PSV:   /* If valve status fixed then treat as pipe */
-                     /* otherwise ignore the valve for now. */
-                     if (K[k] == MISSING) valvecoeff(k);  //pipecoeff(k);      //(2.00.11 - LR)    
-                     else continue;
-                     break;
-         default:    continue;                  
-      }                                         
+
+void  nodelinkcoeffs(int i)
+/*
+**--------------------------------------------------------------
+**   Input:   i = node index                                      
+**   Output:  none                                                
+**   Purpose: adds the coeffs. of the links incident on node i    
+**            to its row of the solution matrix                   
+**                                                              
+**   NOTE: The links are taken in order of link index (see      
+**         nodelinks()), so the sums are the same as when each  
+**         link's coeffs. are added to both its end nodes in    
+**         turn. The off-diagonal coeff. of a link between two  
+**         junctions is updated only from its lower numbered    
+**         node, which also holds any links parallel to it.     
+**--------------------------------------------------------------
+*/
+{
+   int    j,k,n1,n2,t;
+   double aii,f,x;
+
+   aii = Aii[Row[i]];
+   f = F[Row[i]];
+   x = X[i];
+   for (j=Xnode[i]; j<Xnode[i+1]; j++)
+   {
+      k = Nodelink[j];
+      t = Link[k].Type;
+      if ((t == PRV || t == PSV || t == FCV) && K[k] != MISSING) continue;
+      n1 = Link[k].N1;           /* Start node of link */
+      n2 = Link[k].N2;           /* End node of link   */
 
       /* Update net nodal inflows (X), solution matrix (A) and RHS array (F) */
       /* (Use covention that flow out of node is (-), flow into node is (+)) */
-      X[n1] -= Q[k];
-      X[n2] += Q[k];
-      Aij[Ndx[k]] -= P[k];              /* Off-diagonal coeff. */
-      if (n1 <= Njuncs)                 /* Node n1 is junction */
+      if (i == n1)                      /* Node i is start node */
       {
-         Aii[Row[n1]] += P[k];          /* Diagonal coeff. */
-         F[Row[n1]] += Y[k];            /* RHS coeff.      */
+         x -= Q[k];
+         if (i <= Njuncs)
+         {
+            aii += P[k];                /* Diagonal coeff. */
+            f += Y[k];                  /* RHS coeff.      */
+         }
+         if (n2 > Njuncs) f += (P[k]*H[n2]);         /* Node n2 is a tank */
+         else if (i < n2) Aij[Ndx[k]] -= P[k];       /* Off-diag. coeff.  */
       }
-      else F[Row[n2]] += (P[k]*H[n1]);  /* Node n1 is a tank   */
-      if (n2 <= Njuncs)                 /* Node n2 is junction */
+      else                              /* Node i is end node   */
       {
-         Aii[Row[n2]] += P[k];          /* Diagonal coeff. */
-         F[Row[n2]] -= Y[k];            /* RHS coeff.      */
+         x += Q[k];
+         if (n1 > Njuncs) f += (P[k]*H[n1]);         /* Node n1 is a tank */
+         else if (i < n1) Aij[Ndx[k]] -= P[k];       /* Off-diag. coeff.  */
+         if (i <= Njuncs)
+         {
+            aii += P[k];                /* Diagonal coeff. */
+            f -= Y[k];                  /* RHS coeff.      */
+         }
       }
-      else  F[Row[n1]] += (P[k]*H[n2]); /* Node n2 is a tank   */
    }
-}                        /* End of linkcoeffs */
+   Aii[Row[i]] = aii;
+   F[Row[i]] = f;
+   X[i] = x;
+}                        /* End of nodelinkcoeffs */
 
 
 void  nodecoeffs()
@@ -1896,6 +3007,9 @@ void  nodecoeffs()
 
    /* For junction nodes, subtract demand flow from net */
    /* flow imbalance & add imbalance to RHS array F.    */
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
    for (i=1; i<=Njuncs; i++)
    {
       X[i] -= D[i];
@@ -1953,6 +3067,9 @@ void  emittercoeffs()
    double  q;
    double  y;
    double  z;
+#ifdef _OPENMP
+#pragma omp parallel for private(i,ke,p,q,y,z) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
    for (i=1; i<=Njuncs; i++)
    {
       if (Node[i].Ke == 0.0) continue;
@@ -1990,18 +3107,71 @@ double  emitflowchange(int i)
 }
 
 
-void  pipecoeff(int k)
+void  pipecoeffs(int i1, int i2)
 /*
 **--------------------------------------------------------------
-**   Input:   k = link index                                      
+**   Input:   i1 = position of first pipe in Typelist             
+**            i2 = position after last pipe in Typelist           
 **   Output:  none                                                
-**  Purpose:  computes P & Y coefficients for pipe k              
+**  Purpose:  computes P & Y coefficients for pipes and CVs       
 **                                                              
 **    P = inverse head loss gradient = 1/(dh/dQ)                
 **    Y = flow correction term = h*P                            
+**                                                              
+**  NOTE: The pipes' flows are gathered into array Pq and their  
+**        coeffs. are computed into arrays Pp and Py by the      
+**        kernel for the network's headloss formula (hwcoeffs(), 
+**        dwcoeffs() or cmcoeffs()), which typelists() picks     
+**        once when the hydraulics system is opened. Closed      
+**        pipes (h = CBIG*q) are handled when the results are    
+**        copied back to P and Y.                                
 **--------------------------------------------------------------
 */
 {
+   int     i, k;
+
+   /* Gather pipe flows */
+   for (i=i1; i<i2; i++) Pq[i] = Q[Typelist[i]];
+
+   /* Apply kernel for headloss formula */
+   Pipekernel(i1, i2);
+
+   /* Copy coeffs. back, using headloss formula h = CBIG*q */
+   /* for closed pipes                                      */
+   for (i=i1; i<i2; i++)
+   {
+      k = Typelist[i];
+      if (S[k] <= CLOSED)
+      {
+         P[k] = 1.0/CBIG;
+         Y[k] = Q[k];
+      }
+      else
+      {
+         P[k] = Pp[i];
+         Y[k] = Py[i];
+      }
+   }
+}                        /* End of pipecoeffs */
+
+
+void  hwcoeffs(int i1, int i2)
+/*
+**--------------------------------------------------------------
+**   Input:   i1 = position of first pipe in pipe arrays          
+**            i2 = position after last pipe in pipe arrays        
+**   Output:  none                                                
+**  Purpose:  computes P & Y coeffs. of pipes (in Pp & Py) for    
+**            the Hazen-Williams formula                          
+**                                                              
+**  NOTE: The loop has no branches (a minor loss coeff. of 0     
+**        just adds 0) and copies globals into locals, so the    
+**        compiler can vectorize it when it has a vector math    
+**        library for pow().                                     
+**--------------------------------------------------------------
+*/
+{
+   int     i;
    double  hpipe,     /* Normal head loss          */
          hml,       /* Minor head loss           */
          ml,        /* Minor loss coeff.         */
@@ -2009,64 +3179,119 @@ void  pipecoeff(int k)
          q,         /* Abs. value of flow        */
          r,         /* Resistance coeff.         */
          r1,        /* Total resistance factor   */
-         f,         /* D-W friction factor       */
-         dfdq;      /* Derivative of fric. fact. */
+         hexp,      /* Local copy of Hexp        */
+         rqtol;     /* Local copy of RQtol       */
 
-   /* For closed pipe use headloss formula: h = CBIG*q */
-   if (S[k] <= CLOSED)
+   hexp = Hexp;
+   rqtol = RQtol;
+   for (i=i1; i<i2; i++)
    {
-      P[k] = 1.0/CBIG;
-      Y[k] = Q[k];
-      return;
+      q = ABS(Pq[i]);
+      r = Pr[i];
+      ml = Pkm[i];
+      hpipe = r*pow(q,hexp);            /* Friction head loss  */
+      hml = ml*q*q;                     /* Minor head loss     */
+      p = hexp*hpipe + 2.0*hml;         /* Q*dh(Total)/dQ      */
+      p = Pq[i]/p;                      /* 1 / (dh/dQ)         */
+
+      /* Use large P coefficient for small flow resistance product */
+      r1 = r + ml;
+      Pp[i] = (r1*q < rqtol) ? 1.0/rqtol : ABS(p);
+      Py[i] = (r1*q < rqtol) ? Pq[i]/hexp : p*(hpipe + hml);
    }
+}                        /* End of hwcoeffs */
 
-   /* Evaluate headloss coefficients */
-   q = ABS(Q[k]);                         /* Absolute flow       */
-   ml = Link[k].Km;                       /* Minor loss coeff.   */
-   r = Link[k].R;                         /* Resistance coeff.   */
-   f = 1.0;                               /* D-W friction factor */
-   if (Formflag == DW) f = DWcoeff(k,&dfdq);   
-   r1 = f*r+ml;
- 
-   /* Use large P coefficient for small flow resistance product */
-   if (r1*q < RQtol)
+
+void  cmcoeffs(int i1, int i2)
+/*
+**--------------------------------------------------------------
+**   Input:   i1 = position of first pipe in pipe arrays          
+**            i2 = position after last pipe in pipe arrays        
+**   Output:  none                                                
+**  Purpose:  computes P & Y coeffs. of pipes (in Pp & Py) for    
+**            the Chezy-Manning formula                           
+**                                                              
+**  NOTE: Same as hwcoeffs() with a flow exponent of 2, so that  
+**        no call to pow() is needed.                            
+**--------------------------------------------------------------
+*/
+{
+   int     i;
+   double  hpipe,     /* Normal head loss          */
+         hml,       /* Minor head loss           */
+         ml,        /* Minor loss coeff.         */
+         p,         /* q*(dh/dq)                 */
+         q,         /* Abs. value of flow        */
+         r,         /* Resistance coeff.         */
+         r1,        /* Total resistance factor   */
+         rqtol;     /* Local copy of RQtol       */
+
+   rqtol = RQtol;
+   for (i=i1; i<i2; i++)
    {
-      P[k] = 1.0/RQtol;
-      Y[k] = Q[k]/Hexp;
-      return;
+      q = ABS(Pq[i]);
+      r = Pr[i];
+      ml = Pkm[i];
+      hpipe = r*(q*q);                  /* Friction head loss  */
+      hml = ml*q*q;                     /* Minor head loss     */
+      p = 2.0*hpipe + 2.0*hml;          /* Q*dh(Total)/dQ      */
+      p = Pq[i]/p;                      /* 1 / (dh/dQ)         */
+
+      /* Use large P coefficient for small flow resistance product */
+      r1 = r + ml;
+      Pp[i] = (r1*q < rqtol) ? 1.0/rqtol : ABS(p);
+      Py[i] = (r1*q < rqtol) ? Pq[i]/2.0 : p*(hpipe + hml);
    }
+}                        /* End of cmcoeffs */
 
-   /* Compute P and Y coefficients */
-   if (Formflag == DW)                  /* D-W eqn. */
+
+void  dwcoeffs(int i1, int i2)
+/*
+**--------------------------------------------------------------
+**   Input:   i1 = position of first pipe in pipe arrays          
+**            i2 = position after last pipe in pipe arrays        
+**   Output:  none                                                
+**  Purpose:  computes P & Y coeffs. of pipes (in Pp & Py) for    
+**            the Darcy-Weisbach formula                          
+**--------------------------------------------------------------
+*/
+{
+   int     i;
+   double  hpipe,     /* Normal head loss          */
+         p,         /* q*(dh/dq)                 */
+         q,         /* Abs. value of flow        */
+         r1,        /* Total resistance factor   */
+         f;         /* D-W friction factor       */
+
+   for (i=i1; i<i2; i++)
    {
+      q = ABS(Pq[i]);
+      f = DWcoeff(q, Pvd[i], Prr[i]);
+      r1 = f*Pr[i] + Pkm[i];
+
+      /* Use large P coefficient for small flow resistance product */
+      if (r1*q < RQtol)
+      {
+         Pp[i] = 1.0/RQtol;
+         Py[i] = Pq[i]/Hexp;
+         continue;
+      }
       hpipe = r1*SQR(q);                /* Total head loss */
       p = 2.0*r1*q;                     /* |dh/dQ| */
      /* + dfdq*r*q*q;*/                 /* Ignore df/dQ term */
       p = 1.0/p;
-      P[k] = p;
-      Y[k] = SGN(Q[k])*hpipe*p;
+      Pp[i] = p;
+      Py[i] = SGN(Pq[i])*hpipe*p;
    }
-   else                                 /* H-W or C-M eqn.   */
-   {
-      hpipe = r*pow(q,Hexp);            /* Friction head loss  */
-      p = Hexp*hpipe;                   /* Q*dh(friction)/dQ   */
-      if (ml > 0.0)
-      {
-         hml = ml*q*q;                  /* Minor head loss   */
-         p += 2.0*hml;                  /* Q*dh(Total)/dQ    */
-      }
-      else  hml = 0.0;
-      p = Q[k]/p;                       /* 1 / (dh/dQ) */
-      P[k] = ABS(p);
-      Y[k] = p*(hpipe + hml);
-   }
-}                        /* End of pipecoeff */
+}                        /* End of dwcoeffs */
 
 
-double DWcoeff(int k, double *dfdq)
+double DWcoeff(double q, double s, double e)
 /*
 **--------------------------------------------------------------
-**   Input:   k = link index                                      
+**   Input:   q = abs. value of flow                              
+**            s = viscosity times diameter                        
+**            e = roughness divided by 3.7 times diameter         
 **   Output:  returns Darcy-Weisbach friction factor              
 **   Purpose: computes Darcy-Weisbach friction factor             
 **                                                              
@@ -2077,29 +3302,24 @@ double DWcoeff(int k, double *dfdq)
 **--------------------------------------------------------------
 */
 {
-   double q,             /* Abs. value of flow */
-          f;             /* Friction factor    */
+   double f;             /* Friction factor    */
    double x1,x2,x3,x4,
           y1,y2,y3,
           fa,fb,r;
-   double s,w;
+   double w;
 
-   *dfdq = 0.0;
-   if (Link[k].Type > PIPE) return(1.0); /* Only apply to pipes */
-   q = ABS(Q[k]);
-   s = Viscos*Link[k].Diam;
    w = q/s;                       /* w = Re(Pi/4) */
    if (w >= A1)                   /* Re >= 4000; Colebrook Formula */
    {
       y1 = A8/pow(w,0.9);
-      y2 = Link[k].Kc/(3.7*Link[k].Diam) + y1;
+      y2 = e + y1;
       y3 = A9*log(y2);
       f = 1.0/SQR(y3);
       /*  *dfdq = (2.0+AA*y1/(y2*y3))*f; */   /* df/dq */
    }
    else if (w > A2)              /* Re > 2000; Interpolation formula */
    {
-      y2 = Link[k].Kc/(3.7*Link[k].Diam) + AB;
+      y2 = e + AB;
       y3 = A9*log(y2);
       fa = 1.0/SQR(y3);
       fb = (2.0+AC/(y2*y3))*fa;
@@ -2119,7 +3339,6 @@ double DWcoeff(int k, double *dfdq)
    else
    {
       f = 8.0;
-      *dfdq = 0.0;
    }
    return(f);
 }                        /* End of DWcoeff */
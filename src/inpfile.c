@@ -37,6 +37,11 @@ data describing a piping network to a file in EPANET's text format.
 /* Defined in enumstxt.h in EPANET.C */
 extern char *LinkTxt[];
 extern char *FormTxt[];
+extern char *OrderTxt[];
+extern char *SolverTxt[];
+extern char *PrecTxt[];
+extern char *PredTxt[];
+extern char *RouteTxt[];
 extern char *StatTxt[];
 extern char *FlowUnitsTxt[];
 extern char *PressUnitsTxt[];
@@ -539,6 +544,15 @@ int  saveinpfile(char *fname)
    fprintf(f, "\n QUALITY             AGE");
    if (Qualflag == NONE)
    fprintf(f, "\n QUALITY             NONE");
+   for (i=1; i<=Ncons; i++)
+   {
+      if (Cons[i].Type == TRACE)
+      fprintf(f, "\n CONSTITUENT         TRACE %-31s", Node[Cons[i].Node].ID);
+      else
+      fprintf(f, "\n CONSTITUENT         AGE");
+   }
+   for (i=1; i<=Nrecept; i++)
+   fprintf(f, "\n RECEPTOR            %-31s", Node[Recept[i]].ID);
    fprintf(f, "\n DEMAND MULTIPLIER   %-.4f", Dmult);
    fprintf(f, "\n EMITTER EXPONENT    %-.4f", 1.0/Qexp);
    fprintf(f, "\n VISCOSITY           %-.6f", Viscos/VISCOS);                                  
@@ -547,9 +561,27 @@ int  saveinpfile(char *fname)
    fprintf(f, "\n TRIALS              %-d",   MaxIter);                                  
    fprintf(f, "\n ACCURACY            %-.8f", Hacc);                                  
    fprintf(f, "\n TOLERANCE           %-.8f", Ctol*Ucf[QUALITY]);
+   if (Routing != STDROUTE)
+   fprintf(f, "\n ROUTING             %s", RouteTxt[(int)Routing]);
    fprintf(f, "\n CHECKFREQ           %-d", CheckFreq);
    fprintf(f, "\n MAXCHECK            %-d", MaxCheck);
    fprintf(f, "\n DAMPLIMIT           %-.8f", DampLimit);
+   if (Ordering != MINDEG)
+   fprintf(f, "\n ORDERING            %s", OrderTxt[(int)Ordering]);
+   if (Threads > 1)
+   fprintf(f, "\n THREADS             %-d", Threads);
+   if (strlen(SymFname) > 0)
+   fprintf(f, "\n SYMBOLIC            %s", SymFname);
+   if (Solver != CHOLESKY)
+   fprintf(f, "\n SOLVER              %s", SolverTxt[(int)Solver]);
+   if (UpdateLimit > 0.0)
+   fprintf(f, "\n UPDATE              %-.8f", UpdateLimit);
+   if (Precision != DOUBLEPREC)
+   fprintf(f, "\n PRECISION           %s", PrecTxt[(int)Precision]);
+   if (Predictor != NOPRED)
+   fprintf(f, "\n PREDICTOR           %s", PredTxt[(int)Predictor]);
+   if (CacheTol > 0.0)
+   fprintf(f, "\n CACHE               %-.8f", CacheTol*Ucf[HEAD]);
 
 /* Write [REPORT] section */
 
@@ -104,6 +104,7 @@ void  setdefaults()
    strncpy(TmpFname,"",MAXFNAME);                                              //(2.00.12 - LR)
    strncpy(HydFname,"",MAXFNAME);
    strncpy(MapFname,"",MAXFNAME);
+   strncpy(SymFname,"",MAXFNAME);
    strncpy(ChemName,t_CHEMICAL,MAXID);
    strncpy(ChemUnits,u_MGperL,MAXID);
    strncpy(DefPatID,DEFPATID,MAXID);
@@ -153,6 +154,14 @@ void  setdefaults()
    CheckFreq = CHECKFREQ;
    MaxCheck  = MAXCHECK;
    DampLimit = DAMPLIMIT;                                                      //(2.00.12 - LR)
+   Ordering  = MINDEG;          /* Original node re-ordering      */
+   Threads   = 1;               /* Single threaded solver         */
+   Solver    = CHOLESKY;        /* Direct linear equation solver  */
+   UpdateLimit = 0.0;           /* Always re-factorize matrix     */
+   Precision = DOUBLEPREC;      /* Double precision factor        */
+   Predictor = NOPRED;          /* Start from last period's flows */
+   CacheTol  = 0.0;             /* No solution cache              */
+   Routing   = STDROUTE;        /* Route all links, then nodes    */
 }                       /*  End of setdefaults  */
 
 
@@ -540,6 +549,9 @@ void  convertunits()
    Climit /= Ucf[QUALITY];
    Ctol   /= Ucf[QUALITY];
 
+/* Convert solution cache tolerance units */
+   CacheTol /= Ucf[HEAD];
+
 /* Convert global reaction coeffs. */
    Kbulk /= SECperDAY;
    Kwall /= SECperDAY;
@@ -77,6 +77,8 @@ int  netsize()
    MaxControls = 0;
    MaxRules    = 0;
    MaxCurves   = 0;
+   MaxCons     = 0;
+   MaxRecept   = 0;
    sect        = -1;
 
 /* Add a default pattern 0 */
@@ -119,6 +121,9 @@ int  netsize()
                               break;
             case _CURVES:     errcode = addcurve(tok);
                               break;
+            case _OPTIONS:    if (match(tok,w_CONSTIT)) MaxCons++;
+                              if (match(tok,w_RECEPT))  MaxRecept++;
+                              break;
       }
       if (errcode) break;
    }
@@ -167,6 +172,8 @@ int  readdata()
       Npumps    = 0;
       Nvalves   = 0;
       Ncontrols = 0;
+      Ncons     = 0;
+      Nrecept   = 0;
       Nrules    = 0;
       Ncurves   = MaxCurves;
       Npats     = MaxPats;
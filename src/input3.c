@@ -1474,6 +1474,14 @@ int  optionchoice(int n)
 **    VERIFY              filename                               
 **    UNBALANCED          STOP/CONTINUE {Niter}
 **    PATTERN             id
+**    ORDERING            MINDEGREE/AMD
+**    SYMBOLIC            filename
+**    SOLVER              CHOLESKY/PCG
+**    PRECISION           DOUBLE/MIXED
+**    PREDICTOR           NONE/LINEAR/QUADRATIC
+**    ROUTING             STANDARD/ORDERED
+**    CONSTITUENT         AGE/TRACE  (TraceNode)
+**    RECEPTOR            node
 **--------------------------------------------------------------
 */
 {
@@ -1575,6 +1583,75 @@ int  optionchoice(int n)
       if (n < 1) return(0);
       strncpy(DefPatID,Tok[1],MAXID);
    }
+   else if (match(Tok[0],w_ORDERING))           /* Node ordering option */
+   {
+      if (n < 1) return(0);
+      else if (match(Tok[1],w_MINDEGREE)) Ordering = MINDEG;
+      else if (match(Tok[1],w_AMD))       Ordering = AMD;
+      else return(201);
+   }
+   else if (match(Tok[0],w_SYMBOLIC))           /* Symbolic factor file */
+   {
+      if (n < 1) return(0);
+      strncpy(SymFname,Tok[1],MAXFNAME);
+   }
+   else if (match(Tok[0],w_SOLVER))             /* Linear solver option */
+   {
+      if (n < 1) return(0);
+      else if (match(Tok[1],w_CHOLESKY)) Solver = CHOLESKY;
+      else if (match(Tok[1],w_PCG))      Solver = PCG;
+      else return(201);
+   }
+   else if (match(Tok[0],w_PRECISION))          /* Factor precision */
+   {
+      if (n < 1) return(0);
+      else if (match(Tok[1],w_DOUBLE)) Precision = DOUBLEPREC;
+      else if (match(Tok[1],w_MIXED))  Precision = MIXEDPREC;
+      else return(201);
+   }
+   else if (match(Tok[0],w_PREDICTOR))          /* Starting flow predictor */
+   {
+      if (n < 1) return(0);
+      else if (match(Tok[1],w_NONE))      Predictor = NOPRED;
+      else if (match(Tok[1],w_LINEAR))    Predictor = LINEARPRED;
+      else if (match(Tok[1],w_QUADRATIC)) Predictor = QUADPRED;
+      else return(201);
+   }
+   else if (match(Tok[0],w_ROUTING))            /* Water quality routing */
+   {
+      if (n < 1) return(0);
+      else if (match(Tok[1],w_STANDARD))  Routing = STDROUTE;
+      else if (match(Tok[1],w_ORDER))     Routing = ORDROUTE;
+      else return(201);
+   }
+   else if (match(Tok[0],w_CONSTIT))            /* Extra WQ constituent */
+   {
+      if (n < 1) return(0);
+      if (Ncons >= MaxCons) return(200);
+      Ncons++;
+      Cons[Ncons].Node = 0;
+      if (match(Tok[1],w_AGE)) Cons[Ncons].Type = AGE;
+      else if (match(Tok[1],w_TRACE))
+      {
+      /* Copy Trace Node ID to Tok[0] for error reporting */
+         Cons[Ncons].Type = TRACE;
+         strcpy(Tok[0],"");
+         if (n < 2) return(212);
+         strcpy(Tok[0],Tok[2]);
+         Cons[Ncons].Node = findnode(Tok[2]);
+         if (Cons[Ncons].Node == 0) return(212);
+      }
+      else return(213);
+   }
+   else if (match(Tok[0],w_RECEPT))             /* Influence receptor node */
+   {
+      if (n < 1) return(0);
+      if (Nrecept >= MaxRecept) return(200);
+      Nrecept++;
+      strcpy(Tok[0],Tok[1]);
+      Recept[Nrecept] = findnode(Tok[1]);
+      if (Recept[Nrecept] == 0) return(203);
+   }
    else return(-1);
    return(0);
 }                        /* end of optionchoice */
@@ -1603,6 +1680,9 @@ int  optionvalue(int n)
 **    CHECKFREQ           value                                  
 **    MAXCHECK            value
 **    DAMPLIMIT           value                                                //(2.00.12 - LR)                                  
+**    THREADS             value
+**    UPDATE              value
+**    CACHE               value
 **--------------------------------------------------------------
 */
 {
@@ -1643,6 +1723,22 @@ int  optionvalue(int n)
       return(0);
    }
 
+/* Check for factor update limit option (0 = no updates) */
+   if (match(Tok[0],w_UPDATE))
+   {
+      if (y < 0.0) return(213);
+      UpdateLimit = y;
+      return(0);
+   }
+
+/* Check for solution cache tolerance option (0 = no cache) */
+   if (match(Tok[0],w_CACHE))
+   {
+      if (y < 0.0) return(213);
+      CacheTol = y;
+      return(0);
+   }
+
 /* All other options must be > 0 */
    if (y <= 0.0) return(213);
 
@@ -1667,6 +1763,15 @@ int  optionvalue(int n)
    else if (match(Tok[0],w_MAXCHECK))    MaxCheck = (int)y;
    else if (match(Tok[0],w_EMITTER))     Qexp = 1.0/y;
    else if (match(Tok[0],w_DEMAND))      Dmult = y;
+   else if (match(Tok[0],w_THREADS))                       /* Threads */
+   {
+      Threads = (int)y;
+#ifndef _OPENMP
+      /* Without OpenMP only a single thread can be used */
+      if (Threads > 1) writeline(WARN07);
+      Threads = 1;
+#endif
+   }
    else return(201);
    return(0);
 }                        /* end of optionvalue */
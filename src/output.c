@@ -30,6 +30,9 @@ AUTHOR:     L. Rossman
 /* Macro to write x[1] to x[n] to file OutFile: */
 #define   FSAVE(n)  (fwrite(x+1,sizeof(REAL4),(n),OutFile))
 
+/* Smallest fraction of a receptor's water saved to an influence file: */
+#define   ITOL      1.0e-4
+
 int  savenetdata()
 /*
 **---------------------------------------------------------------
@@ -702,4 +705,98 @@ int  saveepilog()
 }
 
 
+int  saveinflhead(FILE *f, int nsamp)
+/*
+**--------------------------------------------------------------
+**  Input:   f     = binary influence file
+**           nsamp = number of reporting periods
+**  Output:  returns error code
+**  Purpose: starts the file of influences of each node on each
+**           receptor found by influence() in QUALITY.C.
+**
+**  NOTE: The file holds the magic number, code version, number
+**        of nodes, number of receptors, number of reporting
+**        periods, report start time & report time step, then
+**        the index of each receptor node (all as 4-byte
+**        integers). One record follows for each period &
+**        receptor, in no set order, holding the period, the
+**        receptor's position in the list, the number of nodes
+**        that supplied at least ITOL of the receptor's water
+**        and then the index (4-byte integer) & fraction (4-byte
+**        real) of each of them. The magic number ends the file.
+**--------------------------------------------------------------
+*/
+{
+   int   i;
+   INT4  ibuf[7];
+
+   ibuf[0] = MAGICNUMBER;
+   ibuf[1] = CODEVERSION;
+   ibuf[2] = Nnodes;
+   ibuf[3] = Nrecept;
+   ibuf[4] = nsamp;
+   ibuf[5] = Rstart;
+   ibuf[6] = Rstep;
+   if (fwrite(ibuf,sizeof(INT4),7,f) < 7) return(308);
+   for (i=1; i<=Nrecept; i++)
+   {
+      ibuf[0] = Recept[i];
+      if (fwrite(ibuf,sizeof(INT4),1,f) < 1) return(308);
+   }
+   return(0);
+}
+
+
+int  saveinflpulse(FILE *f, int m, double *a, int stride)
+/*
+**--------------------------------------------------------------
+**  Input:   f      = binary influence file
+**           m      = pulse index (for receptor m % Nrecept + 1
+**                    at reporting period m / Nrecept)
+**           a      = fraction of the receptor's water that came
+**                    through each node
+**           stride = spacing of the nodes' values in a
+**  Output:  returns error code
+**  Purpose: saves the nodes with a significant influence on a
+**           receptor in one reporting period to file f.
+**--------------------------------------------------------------
+*/
+{
+   int   n;
+   INT4  ibuf[3];
+   REAL4 x;
+
+   ibuf[0] = m / Nrecept;
+   ibuf[1] = m % Nrecept + 1;
+   ibuf[2] = 0;
+   for (n=1; n<=Nnodes; n++) if (a[n*stride] >= ITOL) ibuf[2]++;
+   if (fwrite(ibuf,sizeof(INT4),3,f) < 3) return(308);
+   for (n=1; n<=Nnodes; n++)
+   {
+      if (a[n*stride] < ITOL) continue;
+      ibuf[0] = n;
+      x = (REAL4)MIN(a[n*stride],1.0);
+      if (fwrite(ibuf,sizeof(INT4),1,f) < 1) return(308);
+      if (fwrite(&x,sizeof(REAL4),1,f) < 1) return(308);
+   }
+   return(0);
+}
+
+
+int  saveinflend(FILE *f)
+/*
+**--------------------------------------------------------------
+**  Input:   f = binary influence file
+**  Output:  returns error code
+**  Purpose: ends the influence file with the magic number.
+**--------------------------------------------------------------
+*/
+{
+   INT4  i = MAGICNUMBER;
+
+   if (fwrite(&i,sizeof(INT4),1,f) < 1) return(308);
+   return(0);
+}
+
+
 /********************** END OF OUTPUT.C **********************/
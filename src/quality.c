@@ -20,6 +20,19 @@ AUTHOR:     L. Rossman
   is a reporting period), and the water quality is transported
   and reacted over the duration of the time period.                                      
 
+  The transport of each WQ time step is done link by link and then node
+  by node, so that the work on links can be split between the THREADS
+  given in the [OPTIONS] when compiled with OpenMP (as the build files
+  do; otherwise THREADS is ignored). Each link's new
+  volume & mass outflow are gathered at its downstream node in order of
+  link index, so the results don't depend on the number of threads.
+
+  With ROUTING ORDERED, the nodes are visited instead in order of flow
+  (see sortnodes()), each one taking in the flow out of its inflow links
+  and releasing its own outflow before the nodes downstream of it are
+  visited. Water can then pass through several short links in one WQ
+  time step.
+
   The entry points for this module are:
     openqual()   -- called from ENopenQ() in EPANET.C
     initqual()   -- called from ENinitQ() in EPANET.C
@@ -27,14 +40,26 @@ AUTHOR:     L. Rossman
     nextqual()   -- called from ENnextQ() in EPANET.C
     stepqual()   -- called from ENstepQ() in EPANET.C
     closequal()  -- called from ENcloseQ() in EPANET.C
+    influence()  -- called from ENsolveI() in EPANET.C
                                                                       
-  Calls are made to:
-    AllocInit()
-    Alloc()
-    AllocFree()   
-  in MEMPOOL.C to utilize a memory pool to prevent excessive malloc'ing  
-  when constantly creating and destroying pipe sub-segments during    
-  the water quality transport calculations.
+  Any extra constituents given by CONSTITUENT options (water age or
+  flow traced from a node) are carried in segment lists of their own,
+  Segx[], which take in & release the same volumes as the main ones
+  but are split on the extras' tolerance (see samecons()), with values
+  kept in Cx[] at nodes. The main constituent's segments are thus the
+  same as without the extras, and a single extra gives the results of
+  a run with it as the main constituent.
+
+  The same routing is used by influence() to run the saved hydraulics
+  backward in time from the RECEPTOR nodes, carrying one extra
+  constituent for each receptor & reporting period, to find how much
+  of the water at each receptor came through every other node.
+
+  The segments of each pipe (and of tanks that use them) are kept in
+  a ring buffer of volumes and concentrations that doubles in size
+  when full, so that segments are created and destroyed during the
+  water quality transport calculations without any malloc'ing and are
+  visited in order of memory.
 
   Calls are also made to:
     readhyd()
@@ -42,6 +67,9 @@ AUTHOR:     L. Rossman
     savenetdata()
     saveoutput()
     savefinaloutput()
+    saveinflhead()
+    saveinflpulse()
+    saveinflend()
   in OUTPUT.C to retrieve hydraulic results and save all results.
 
 ******************************************************************************* 
@@ -61,7 +89,6 @@ AUTHOR:     L. Rossman
 #include "funcs.h"
 #define  EXTERN  extern
 #include "vars.h"
-#include "mempool.h"
 
 /*
 ** Macros to identify upstream & downstream nodes of a link
@@ -71,12 +98,41 @@ AUTHOR:     L. Rossman
 #define   DOWN_NODE(x) ( (FlowDir[(x)]=='+') ? Link[(x)].N2 : Link[(x)].N1 )
 #define   LINKVOL(k)   ( 0.785398*Link[(k)].Len*SQR(Link[(k)].Diam) )
 
-Pseg      FreeSeg;              /* Pointer to unused segment               */
-Pseg      *FirstSeg,            /* First (downstream) segment in each pipe */
-          *LastSeg;             /* Last (upstream) segment in each pipe    */
+/*
+** Macro giving the position in a segment list's buffer of its
+** i-th segment counting upstream from the first (downstream) one,
+** and initial size of a list's buffer
+*/
+#define   SEG(s,i)     ( ((s)->first + (i)) & ((s)->size - 1) )
+#define   SEGSIZE      4
+#define   LBLOCK       1024     /* Links per block of work */
+
+/*
+** Macros giving the values of the extra constituents held for the
+** i-th node or link of an array of Ncons values per item and for
+** the segment at position i of an extra constituent segment list's
+** buffer (where they follow the volumes), and the tolerance used
+** for them (in hours of age or percent)
+*/
+#define   XCONS(a,i)   ( (a) + (i)*Ncons )
+#define   SEGX(s,i)    ( (s)->c + (i)*Ncons )
+#define   XTOL         0.01
+#define   PTOL         1.0e-4   /* Fraction of a pulse left when saved */
+
+Pseglist  Seg;                  /* Segments in each pipe & tank            */
+Pseglist  Segx;                 /* Extra constituent segments, likewise    */
 char      *FlowDir;             /* Flow direction for each pipe            */
 double    *VolIn;               /* Total volume inflow to node             */
 double    *MassIn;              /* Total mass inflow to node               */
+double    *MassInx;             /* Extra constituent inflow to node        */
+double    *MassOutx;            /* Extra constituent outflow of link       */
+double    *Xx;                  /* Extra constituent work array            */
+double    *VolOut;              /* Flow volume out of each link            */
+double    *MassOut;             /* Mass flow out of each link              */
+double    *Wblock;              /* Mass reacted in each block of links     */
+int       *Adjlink,             /* Links incident on each node, in order   */
+          *Xadj;                /* Start of each node in Adjlink           */
+int       *Sorted;              /* Nodes in order of flow                  */
 double    Sc;                   /* Schmidt Number                          */
 double    Bucf;                 /* Bulk reaction units conversion factor   */
 double    Tucf;                 /* Tank reaction units conversion factor   */
@@ -85,7 +141,10 @@ double    Tucf;                 /* Tank reaction units conversion factor   */
 //char      Reactflag;            /* Reaction indicator                      */
 
 char      OutOfMemory;          /* Out of memory indicator                 */
-static    alloc_handle_t *SegPool; // Memory pool for water quality segments   //(2.00.11 - LR)
+char      Ageflag;              /* Extra water age constituent indicator   */
+int       *Pulse;               /* Pulse held in each extra WQ slot        */
+double    *Pscale;              /* Pulse mass to water fraction factors    */
+double    *Pinfl;               /* Pulse fraction that entered each node   */
 
 
 int  openqual()
@@ -98,12 +157,9 @@ int  openqual()
 */
 {
    int errcode = 0;
-   int n;
+   int i, k, n;
 
-   /* Allocate memory pool for WQ segments */
    OutOfMemory = FALSE;
-   SegPool = AllocInit();                                                      //(2.00.11 - LR)
-   if (SegPool == NULL) errcode = 101;                                         //(2.00.11 - LR)
 
    /* Allocate scratch array & reaction rate array*/
    X  = (double *) calloc(MAX((Nnodes+1),(Nlinks+1)),sizeof(double));
@@ -113,17 +169,55 @@ int  openqual()
 
    /* Allocate memory for WQ solver */
    n        = Nlinks+Ntanks+1;
-   FirstSeg = (Pseg *) calloc(n, sizeof(Pseg));
-   LastSeg  = (Pseg *) calloc(n, sizeof(Pseg));
+   Seg      = (Pseglist) calloc(n, sizeof(Sseglist));
+   Segx     = (Pseglist) calloc(n, sizeof(Sseglist));
    FlowDir  = (char *) calloc(n, sizeof(char));
    n        = Nnodes+1;
    VolIn    = (double *) calloc(n, sizeof(double));
    MassIn   = (double *) calloc(n, sizeof(double));
-   ERRCODE(MEMCHECK(FirstSeg));
-   ERRCODE(MEMCHECK(LastSeg));
+   Xadj     = (int *) calloc(n+1, sizeof(int));
+   n        = Nlinks+1;
+   VolOut   = (double *) calloc(n, sizeof(double));
+   MassOut  = (double *) calloc(n, sizeof(double));
+   Adjlink  = (int *) calloc(2*n, sizeof(int));
+   Wblock   = (double *) calloc(2*(Nlinks/LBLOCK+1), sizeof(double));
+   Sorted   = (int *) calloc(2*(Nnodes+1), sizeof(int));
+   n        = MAX(Ncons,1);
+   Cx       = (double *) calloc((Nnodes+1)*n, sizeof(double));
+   Xx       = (double *) calloc((Nnodes+1)*n, sizeof(double));
+   MassInx  = (double *) calloc((Nnodes+1)*n, sizeof(double));
+   MassOutx = (double *) calloc((Nlinks+1)*n, sizeof(double));
+   ERRCODE(MEMCHECK(Seg));
+   ERRCODE(MEMCHECK(Segx));
    ERRCODE(MEMCHECK(FlowDir));
    ERRCODE(MEMCHECK(VolIn));
    ERRCODE(MEMCHECK(MassIn));
+   ERRCODE(MEMCHECK(Xadj));
+   ERRCODE(MEMCHECK(VolOut));
+   ERRCODE(MEMCHECK(MassOut));
+   ERRCODE(MEMCHECK(Adjlink));
+   ERRCODE(MEMCHECK(Wblock));
+   ERRCODE(MEMCHECK(Sorted));
+   ERRCODE(MEMCHECK(Cx));
+   ERRCODE(MEMCHECK(Xx));
+   ERRCODE(MEMCHECK(MassInx));
+   ERRCODE(MEMCHECK(MassOutx));
+   if (errcode) return(errcode);
+
+   /* List the links incident on each node in order of link index */
+   for (k=1; k<=Nlinks; k++)
+   {
+      Xadj[Link[k].N1+1]++;
+      Xadj[Link[k].N2+1]++;
+   }
+   for (i=1; i<=Nnodes+1; i++) Xadj[i] += Xadj[i-1];
+   for (k=1; k<=Nlinks; k++)
+   {
+      Adjlink[Xadj[Link[k].N1]++] = k;
+      Adjlink[Xadj[Link[k].N2]++] = k;
+   }
+   for (i=Nnodes+1; i>0; i--) Xadj[i] = Xadj[i-1];
+   Xadj[0] = 0;
    return(errcode);
 }
 
@@ -147,6 +241,16 @@ void  initqual()
 {
    int i;
 
+   /* Initialize extra constituents (zero age, or 100 */
+   /* percent at the node traced)                     */
+   memset(Cx,0,(Nnodes+1)*Ncons*sizeof(double));
+   Ageflag = 0;
+   for (i=1; i<=Ncons; i++)
+   {
+      if (Cons[i].Type == AGE) Ageflag = 1;
+      else XCONS(Cx,Cons[i].Node)[i-1] = 100.0;
+   }
+
    /* Initialize quality, tank volumes, & source mass flows */
    for (i=1; i<=Nnodes; i++) C[i] = Node[i].C0;
    for (i=1; i<=Ntanks; i++) Tank[i].C = Node[Tank[i].Node].C0;
@@ -175,11 +279,6 @@ void  initqual()
 
       /* Check if modeling a reactive substance */
       Reactflag = setReactflag();
-
-      /* Reset memory pool */
-      FreeSeg = NULL;
-      AllocSetPool(SegPool);                                                   //(2.00.11 - LR)
-      AllocReset();                                                            //(2.00.11 - LR)
    }
 
    /* Initialize avg. reaction rates */
@@ -307,25 +406,463 @@ int closequal()
 */
 {
    int errcode = 0;
+   int k;
 
-   /* Free memory pool */
-   if ( SegPool )                                                              //(2.00.11 - LR)
-   {                                                                           //(2.00.11 - LR)
-        AllocSetPool(SegPool);                                                 //(2.00.11 - LR)
-        AllocFreePool();                                                       //(2.00.11 - LR)
-   }                                                                           //(2.00.11 - LR)
-
-   free(FirstSeg);
-   free(LastSeg);
+   /* Free segment buffers */
+   if (Seg != NULL)
+   {
+      for (k=1; k<=Nlinks+Ntanks; k++) free(Seg[k].v);
+   }
+   if (Segx != NULL)
+   {
+      for (k=1; k<=Nlinks+Ntanks; k++) free(Segx[k].v);
+   }
+   free(Seg);
+   free(Segx);
    free(FlowDir);
    free(VolIn);
    free(MassIn);
+   free(VolOut);
+   free(MassOut);
+   free(Adjlink);
+   free(Xadj);
+   free(Wblock);
+   free(Sorted);
+   free(Cx);
+   free(Xx);
+   free(MassInx);
+   free(MassOutx);
    free(R);
    free(X);
    return(errcode);
 }
 
 
+int  influence(FILE *f)
+/*
+**--------------------------------------------------------------
+**   Input:   f = binary file to which results are written
+**   Output:  returns error code
+**   Purpose: finds the fraction of the water at each receptor
+**            node in each reporting period that came through
+**            each node of the network, and saves it to file f.
+**
+**   Note:    The hydraulic periods are read back from the last
+**            one to the first with their flows & demands
+**            reversed, so that water is routed upstream from
+**            the receptors. For each receptor & reporting time
+**            a pulse of 100 is released, over the WQ time step
+**            before that time, into the links that feed the
+**            receptor (or put in a receptor tank's contents).
+**            It is carried as an extra constituent, and the
+**            part of it that later enters a node, in proportion
+**            to the receptor's total inflow, is the fraction of
+**            the receptor's water that passed through the node.
+**            This is what a forward TRACE from the node would
+**            show at the receptor, found for all nodes at once,
+**            except that water passing a node again after a
+**            flow reversal is counted for each pass and that a
+**            receptor tank's whole contents are traced (which
+**            is what it reports only for the complete mix model).
+**
+**            A pulse only takes up an extra constituent slot
+**            once it has started, and when less than PTOL of it
+**            is left in the network it is saved to file and its
+**            slot is used again. The memory needed thus depends
+**            on the number of pulses under way at one time, not
+**            on the number of reporting periods.
+**--------------------------------------------------------------
+*/
+{
+   int      errcode = 0;
+   int      i, j, k, k1, m, ncons, nper, nsamp;
+   char     qualflag;
+   long     dt, hydstep, hydtime, recsize, tcur;
+   Scons    *cons;
+
+   /* Count the reporting periods & the hydraulic periods, */
+   /* leaving the heads of the last one in H[]             */
+   if (Dur >= Rstart) nsamp = (Dur - Rstart)/Rstep + 1;
+   else               nsamp = 0;
+   recsize = 2*sizeof(INT4) + (2*Nnodes + 3*Nlinks)*sizeof(REAL4);
+   fseek(HydFile,HydOffset,SEEK_SET);
+   nper = 0;
+   do
+   {
+      if (!readhyd(&hydtime) || !readhydstep(&hydstep)) return(307);
+      nper++;
+   }  while (hydstep > 0);
+
+   /* Replace the extra constituents with slots for the */
+   /* pulses under way, starting with one per receptor  */
+   ncons = Ncons;
+   cons = Cons;
+   qualflag = Qualflag;
+   Ncons = Nrecept;
+   Cons = (Scons *) calloc(Ncons+1, sizeof(Scons));
+   Pulse = (int *) calloc(Ncons, sizeof(int));
+   Pscale = (double *) calloc(Ncons, sizeof(double));
+   Pinfl = (double *) calloc((Nnodes+1)*Ncons, sizeof(double));
+   ERRCODE(MEMCHECK(Cons));
+   ERRCODE(MEMCHECK(Pulse));
+   ERRCODE(MEMCHECK(Pscale));
+   ERRCODE(MEMCHECK(Pinfl));
+   if (!errcode)
+   {
+      for (i=0; i<Ncons; i++)
+      {
+         Cons[i+1].Type = NONE;
+         Pulse[i] = -1;
+      }
+      errcode = openqual();
+
+      /* Start from zero quality & the final tank volumes */
+      if (!errcode)
+      {
+         for (i=1; i<=Nnodes; i++) C[i] = 0.0;
+         for (i=1; i<=Ntanks; i++)
+         {
+            Tank[i].C = 0.0;
+            if (Tank[i].A > 0.0)
+               Tank[i].V = tankvolume(i,H[Tank[i].Node]);
+         }
+         Qualflag = NONE;
+         Reactflag = 0;
+         Ageflag = 0;
+         errcode = saveinflhead(f,nsamp);
+      }
+
+      /* Route each hydraulic period backward in time */
+      k = nsamp - 1;
+      tcur = Dur;
+      for (j=nper-2; j>=0 && !errcode; j--)
+      {
+         fseek(HydFile,HydOffset+j*recsize,SEEK_SET);
+         if (!readhyd(&hydtime) || !readhydstep(&hydstep))
+         {
+            errcode = 307;
+            break;
+         }
+         for (i=1; i<=Nnodes; i++) D[i] = -D[i];
+         for (i=1; i<=Nlinks; i++) Q[i] = -Q[i];
+         if (j == nper-2) initsegs();
+         else             reorientsegs();
+         if (Routing == ORDROUTE) sortnodes();
+
+         while (!errcode && !OutOfMemory && tcur > hydtime)
+         {
+            /* Start the pulses for reporting times reached, */
+            /* ending the time step at the next one          */
+            k1 = k;
+            while (k >= 0 && Rstart + k*Rstep >= tcur) k--;
+            dt = MIN(Qstep,tcur-hydtime);
+            if (k >= 0) dt = MIN(dt,tcur-Rstart-k*Rstep);
+            for (m=(k+1)*Nrecept; m<(k1+1)*Nrecept && !errcode; m++)
+               errcode = newpulse(m,dt);
+            if (errcode) break;
+
+            /* Route the pulses & add the parts of them */
+            /* that entered each node                   */
+            routestep(dt);
+            addinfluence();
+            for (i=1; i<=Ncons; i++) Cons[i].Type = NONE;
+            tcur -= dt;
+         }
+         if (OutOfMemory) errcode = 101;
+
+         /* Save the pulses that have left the network */
+         if (!errcode) errcode = endpulses(f,FALSE);
+      }
+
+      /* Receptors at reporting times not reached only */
+      /* receive water from themselves                 */
+      for (m=0; m<(k+1)*Nrecept && !errcode; m++) errcode = newpulse(m,0);
+      if (!errcode) errcode = endpulses(f,TRUE);
+      if (!errcode) errcode = saveinflend(f);
+      closequal();
+   }
+
+   /* Restore the extra constituents & leave the (forward) */
+   /* hydraulics of the last period in place, as after a   */
+   /* forward WQ run                                       */
+   free(Cons);
+   free(Pulse);
+   free(Pscale);
+   free(Pinfl);
+   Cons = cons;
+   Ncons = ncons;
+   Qualflag = qualflag;
+   fseek(HydFile,HydOffset+(nper-1)*recsize,SEEK_SET);
+   if (!readhyd(&hydtime) || !readhydstep(&hydstep)) ERRCODE(307);
+   return(errcode);
+}
+
+
+int  newpulse(int m, long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   m  = pulse index (for receptor m % Nrecept + 1 at
+**                 reporting period m / Nrecept)
+**            dt = current WQ time step (0 if not routed)
+**   Output:  returns error code
+**   Purpose: starts pulse m in a free extra constituent slot.
+**--------------------------------------------------------------
+*/
+{
+   int i, n;
+
+   /* Find a free slot, adding more if there are none */
+   for (i=0; i<Ncons; i++)
+   {
+      if (Pulse[i] < 0) break;
+   }
+   if (i == Ncons && growpulses(2*Ncons)) return(101);
+
+   /* The receptor receives all of its own water */
+   n = Recept[m % Nrecept + 1];
+   Pulse[i] = m;
+   Cons[i+1].Node = n;
+   XCONS(Pinfl,n)[i] = 1.0;
+   if (dt > 0) Pscale[i] = startpulse(i,dt);
+   else        Pscale[i] = 0.0;
+   return(0);
+}
+
+
+int  growpulses(int n)
+/*
+**--------------------------------------------------------------
+**   Input:   n = new number of extra constituent slots
+**   Output:  returns error code
+**   Purpose: adds free slots for pulses, moving the values of
+**            the current ones in segments, nodes & links.
+**--------------------------------------------------------------
+*/
+{
+   int      i, k, p, size;
+   int      *pulse;
+   double   *buf, *pscale;
+   Scons    *cons;
+   Pseglist s;
+
+   /* Re-space the values held after each extra constituent */
+   /* segment list's volumes                                */
+   for (k=1; k<=Nlinks+Ntanks; k++)
+   {
+      s = &Segx[k];
+      size = s->size;
+      if (size == 0) continue;
+      buf = (double *) calloc((1+n)*size, sizeof(double));
+      if (buf == NULL) return(101);
+      memcpy(buf,s->v,size*sizeof(double));
+      for (p=0; p<size; p++)
+         memcpy(buf+size+p*n,SEGX(s,p),Ncons*sizeof(double));
+      free(s->v);
+      s->v = buf;
+      s->c = buf + size;
+   }
+
+   /* Re-space the values held at nodes & links */
+   if (resizecons(&Cx,Nnodes+1,n)       ||
+       resizecons(&Xx,Nnodes+1,n)       ||
+       resizecons(&MassInx,Nnodes+1,n)  ||
+       resizecons(&MassOutx,Nlinks+1,n) ||
+       resizecons(&Pinfl,Nnodes+1,n)) return(101);
+
+   /* Extend the slot data */
+   cons = (Scons *) realloc(Cons, (n+1)*sizeof(Scons));
+   if (cons == NULL) return(101);
+   Cons = cons;
+   pulse = (int *) realloc(Pulse, n*sizeof(int));
+   if (pulse == NULL) return(101);
+   Pulse = pulse;
+   pscale = (double *) realloc(Pscale, n*sizeof(double));
+   if (pscale == NULL) return(101);
+   Pscale = pscale;
+   for (i=Ncons; i<n; i++)
+   {
+      Cons[i+1].Type = NONE;
+      Cons[i+1].Node = 0;
+      Pulse[i] = -1;
+      Pscale[i] = 0.0;
+   }
+   Ncons = n;
+   return(0);
+}
+
+
+int  resizecons(double **x, int rows, int n)
+/*
+**--------------------------------------------------------------
+**   Input:   x    = array of Ncons values per item
+**            rows = number of items
+**            n    = new number of values per item
+**   Output:  returns 1 if out of memory, 0 if not
+**   Purpose: re-spaces array *x for n values per item.
+**--------------------------------------------------------------
+*/
+{
+   int    i;
+   double *y;
+
+   y = (double *) calloc(rows*n, sizeof(double));
+   if (y == NULL) return(1);
+   for (i=0; i<rows; i++) memcpy(y+i*n,*x+i*Ncons,Ncons*sizeof(double));
+   free(*x);
+   *x = y;
+   return(0);
+}
+
+
+double  startpulse(int m, long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   m  = pulse slot
+**            dt = current WQ time step
+**   Output:  returns factor that converts the pulse's mass at
+**            a node to a fraction of the receptor's water
+**   Purpose: starts the pulse in slot m from its receptor node.
+**--------------------------------------------------------------
+*/
+{
+   int      i, j, k, n;
+   double   q;
+   Pseglist s;
+
+   /* At a junction, release the pulse over this time step */
+   /* into the links that (in forward time) feed it        */
+   n = Cons[m+1].Node;
+   if (n <= Njuncs)
+   {
+      Cons[m+1].Type = TRACE;
+      q = MAX(0.0,D[n]);
+      for (i=Xadj[n]; i<Xadj[n+1]; i++)
+      {
+         k = Adjlink[i];
+         if (UP_NODE(k) == n) q += ABS(Q[k]);
+      }
+      if (q > 0.0) return(1.0/(100.0*q*dt));
+      return(0.0);
+   }
+
+   /* In a tank, put the pulse in all of its contents */
+   j = n - Njuncs;
+   if (Tank[j].A == 0.0 || Tank[j].V <= 0.0) return(0.0);
+   XCONS(Cx,n)[m] = 100.0;
+   s = &Segx[Nlinks+j];
+   for (i=0; i<s->n; i++) SEGX(s,SEG(s,i))[m] = 100.0;
+   return(1.0/(100.0*Tank[j].V));
+}
+
+
+void  addinfluence()
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: adds the mass of each pulse that entered each node
+**            over the last WQ time step to Pinfl[].
+**--------------------------------------------------------------
+*/
+{
+   int    m, n;
+   double *an, *xin;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(m,n,an,xin) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (n=1; n<=Nnodes; n++)
+   {
+      an = XCONS(Pinfl,n);
+      xin = XCONS(MassInx,n);
+      for (m=0; m<Ncons; m++) an[m] += xin[m]*Pscale[m];
+   }
+}
+
+
+int  endpulses(FILE *f, int all)
+/*
+**--------------------------------------------------------------
+**   Input:   f   = binary influence file
+**            all = TRUE if all pulses are to be ended
+**   Output:  returns error code
+**   Purpose: saves the pulses with less than PTOL of their mass
+**            left in the network (or all of them) to file f and
+**            frees their slots.
+**--------------------------------------------------------------
+*/
+{
+   int      errcode = 0;
+   int      i, j, k, n, p;
+   double   *mass, *x;
+   Pseglist s;
+
+   /* Find the mass of each pulse left in segments & */
+   /* in complete mix tanks                          */
+   mass = (double *) calloc(Ncons, sizeof(double));
+   if (mass == NULL) return(101);
+   for (k=1; k<=Nlinks+Ntanks && !all; k++)
+   {
+      s = &Segx[k];
+      for (j=0; j<s->n; j++)
+      {
+         p = SEG(s,j);
+         x = SEGX(s,p);
+         for (i=0; i<Ncons; i++) mass[i] += s->v[p]*x[i];
+      }
+   }
+   for (j=1; j<=Ntanks && !all; j++)
+   {
+      if (Tank[j].A == 0.0 || Tank[j].MixModel != MIX1) continue;
+      x = XCONS(Cx,Tank[j].Node);
+      for (i=0; i<Ncons; i++) mass[i] += Tank[j].V*x[i];
+   }
+
+   /* Save the pulses that are done (marking their mass -1) */
+   for (i=0; i<Ncons && !errcode; i++)
+   {
+      if (Pulse[i] < 0 || (!all && mass[i]*Pscale[i] >= PTOL))
+      {
+         mass[i] = 0.0;
+         continue;
+      }
+      errcode = saveinflpulse(f,Pulse[i],Pinfl+i,Ncons);
+      mass[i] = -1.0;
+      Pulse[i] = -1;
+      Pscale[i] = 0.0;
+   }
+
+   /* Clear what is left of them from segments, nodes & links */
+   for (k=1; k<=Nlinks+Ntanks && !errcode; k++)
+   {
+      s = &Segx[k];
+      for (j=0; j<s->n; j++)
+      {
+         x = SEGX(s,SEG(s,j));
+         for (i=0; i<Ncons; i++) if (mass[i] < 0.0) x[i] = 0.0;
+      }
+   }
+   for (n=1; n<=Nnodes && !errcode; n++)
+   {
+      for (i=0; i<Ncons; i++)
+      {
+         if (mass[i] >= 0.0) continue;
+         XCONS(Cx,n)[i] = 0.0;
+         XCONS(Xx,n)[i] = 0.0;
+         XCONS(MassInx,n)[i] = 0.0;
+         XCONS(Pinfl,n)[i] = 0.0;
+      }
+   }
+   for (k=1; k<=Nlinks && !errcode; k++)
+   {
+      for (i=0; i<Ncons; i++)
+         if (mass[i] < 0.0) XCONS(MassOutx,k)[i] = 0.0;
+   }
+   free(mass);
+   return(errcode);
+}
+
+
 int  gethyd(long *hydtime, long *hydstep)
 /*
 **-----------------------------------------------------------
@@ -371,6 +908,9 @@ int  gethyd(long *hydtime, long *hydstep)
       /* else re-orient segments if flow reverses.*/
       if (Qtime == 0) initsegs();
       else            reorientsegs();
+
+      /* Order nodes by flow for node-by-node routing */
+      if (Routing == ORDROUTE) sortnodes();
    }
    return(errcode);
 }
@@ -417,23 +957,41 @@ void  transport(long tstep)
    long   qtime, dt;
 
    /* Repeat until elapsed time equals hydraulic time step */
-
-   AllocSetPool(SegPool);                                                      //(2.00.11 - LR)
    qtime = 0;
    while (!OutOfMemory && qtime < tstep)
    {                                  /* Qstep is quality time step */
       dt = MIN(Qstep,tstep-qtime);    /* Current time step */
       qtime += dt;                    /* Update elapsed time */
-      if (Reactflag) updatesegs(dt);  /* Update quality in inner link segs */
-      accumulate(dt);                 /* Accumulate flow at nodes */
-      updatenodes(dt);                /* Update nodal quality */
-      sourceinput(dt);                /* Compute inputs from sources */
-      release(dt);                    /* Release new nodal flows */
+      routestep(dt);                  /* Transport mass over time step */
    }
    updatesourcenodes(tstep);          /* Update quality at source nodes */
 }
 
 
+void  routestep(long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   dt = current WQ time step
+**   Output:  none
+**   Purpose: transports constituent mass through pipe network
+**            over a single WQ time step.
+**--------------------------------------------------------------
+*/
+{
+   if (Reactflag || Ageflag)       /* Update quality in inner link segs */
+      updatesegs(dt);
+   if (Routing == ORDROUTE)
+   {
+      routenodes(dt);              /* Route flow node by node */
+      return;
+   }
+   accumulate(dt);                 /* Accumulate flow at nodes */
+   updatenodes(dt);                /* Update nodal quality */
+   sourceinput(dt);                /* Compute inputs from sources */
+   release(dt);                    /* Release new nodal flows */
+}
+
+
 void  initsegs()
 /*
 **--------------------------------------------------------------
@@ -445,6 +1003,7 @@ void  initsegs()
 {
    int     j,k;
    double   c,v;
+   double   *x;
 
    /* Examine each link */
    for (k=1; k<=Nlinks; k++)
@@ -455,8 +1014,7 @@ void  initsegs()
       if (Q[k] < 0.) FlowDir[k] = '-';
 
       /* Set segs to zero */
-      LastSeg[k] = NULL;
-      FirstSeg[k] = NULL;
+      removesegs(k);
 
       /* Find quality of downstream node */
       j = DOWN_NODE(k);
@@ -465,6 +1023,7 @@ void  initsegs()
 
       /* Fill link with single segment with this quality */
       addseg(k,LINKVOL(k),c);
+      addsegx(k,LINKVOL(k),XCONS(Cx,j));
    }
 
    /* Initialize segments in tanks that use them */
@@ -478,16 +1037,18 @@ void  initsegs()
       /* Tank segment pointers are stored after those for links */
       k = Nlinks + j;
       c = Tank[j].C;
-      LastSeg[k] = NULL;
-      FirstSeg[k] = NULL;
+      x = XCONS(Cx,Tank[j].Node);
+      removesegs(k);
 
       /* Add 2 segments for 2-compartment model */
       if (Tank[j].MixModel == MIX2)
       {
          v = MAX(0,Tank[j].V-Tank[j].V1max);
          addseg(k,v,c);
+         addsegx(k,v,x);
          v = Tank[j].V - v;
          addseg(k,v,c);
+         addsegx(k,v,x);
       }
 
       /* Add one segment for FIFO & LIFO models */
@@ -495,6 +1056,7 @@ void  initsegs()
       {
          v = Tank[j].V;
          addseg(k,v,c);
+         addsegx(k,v,x);
       }
    }
 }
@@ -509,9 +1071,10 @@ void  reorientsegs()
 **--------------------------------------------------------------
 */
 {
-   Pseg   seg, nseg, pseg;
-   int    k;
-   char   newdir;
+   Pseglist s;
+   int      i, j, k, m, pi, pj;
+   double   t, *xi, *xj;
+   char     newdir;
 
    /* Examine each link */
    for (k=1; k<=Nlinks; k++)
@@ -526,16 +1089,28 @@ void  reorientsegs()
       /* (first to last) and save new direction */
       if (newdir != FlowDir[k])
       {
-         seg = FirstSeg[k];
-         FirstSeg[k] = LastSeg[k];
-         LastSeg[k] = seg;
-         pseg = NULL;
-         while (seg != NULL)
+         s = &Seg[k];
+         for (i=0, j=s->n-1; i<j; i++, j--)
          {
-            nseg = seg->prev;
-            seg->prev = pseg;
-            pseg = seg;
-            seg = nseg;
+            pi = SEG(s,i);
+            pj = SEG(s,j);
+            t = s->v[pi]; s->v[pi] = s->v[pj]; s->v[pj] = t;
+            t = s->c[pi]; s->c[pi] = s->c[pj]; s->c[pj] = t;
+         }
+
+         /* Likewise for the extra constituents */
+         s = &Segx[k];
+         for (i=0, j=s->n-1; i<j; i++, j--)
+         {
+            pi = SEG(s,i);
+            pj = SEG(s,j);
+            t = s->v[pi]; s->v[pi] = s->v[pj]; s->v[pj] = t;
+            xi = SEGX(s,pi);
+            xj = SEGX(s,pj);
+            for (m=0; m<Ncons; m++)
+            {
+               t = xi[m]; xi[m] = xj[m]; xj[m] = t;
+            }
          }
          FlowDir[k] = newdir;
       }
@@ -549,15 +1124,51 @@ void  updatesegs(long dt)
 **   Input:   t = time from last WQ segment update     
 **   Output:  none
 **   Purpose: reacts material in pipe segments up to time t               
+**
+**   Note:    The links are reacted in blocks of LBLOCK links
+**            and the mass reacted in each block is added up
+**            in order of block.
 **-------------------------------------------------------------
 */
 {
-   int    k;
-   Pseg   seg;
-   double  cseg, rsum, vsum;
+   int    b, nb;
 
-   /* Examine each link in network */
-   for (k=1; k<=Nlinks; k++)
+   nb = (Nlinks + LBLOCK - 1)/LBLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for private(b) schedule(dynamic) if (Threads > 1) num_threads(Threads)
+#endif
+   for (b=0; b<nb; b++) blocksegs(b,dt);
+   for (b=0; b<nb; b++)
+   {
+      Wbulk += Wblock[2*b];
+      Wwall += Wblock[2*b+1];
+   }
+}
+
+
+void  blocksegs(int b, long dt)
+/*
+**-------------------------------------------------------------
+**   Input:   b  = block of links
+**            dt = time from last WQ segment update
+**   Output:  none
+**   Purpose: reacts material in the pipe segments of the links
+**            in block b and sums the mass reacted in Wblock[]
+**-------------------------------------------------------------
+*/
+{
+   int      i, k, k1, k2, p;
+   Pseglist s;
+   double   cseg, rsum, vsum;
+   double   *w = &Wblock[2*b];
+
+   w[0] = 0.0;
+   w[1] = 0.0;
+   k1 = b*LBLOCK + 1;
+   k2 = MIN(k1 + LBLOCK - 1, Nlinks);
+
+   /* Examine each link in the block */
+   for (k=k1; k<=k2; k++)
    {
 
       /* Skip zero-length links (pumps & valves) */
@@ -565,22 +1176,30 @@ void  updatesegs(long dt)
       vsum = 0.0;
       if (Link[k].Len == 0.0) continue;
 
+      /* Age any extra water age constituents */
+      if (Ageflag)
+      {
+         s = &Segx[k];
+         for (i=0; i<s->n; i++) reactcons(SEGX(s,SEG(s,i)),dt);
+      }
+      if (!Reactflag) continue;
+
       /* Examine each segment of the link */
-      seg = FirstSeg[k];
-      while (seg != NULL)
+      s = &Seg[k];
+      for (i=0; i<s->n; i++)
       {
+            p = SEG(s,i);
 
             /* React segment over time dt */
-            cseg = seg->c;
-            seg->c = pipereact(k,seg->c,seg->v,dt);
+            cseg = s->c[p];
+            s->c[p] = pipereact(k,cseg,s->v[p],dt,w);
 
             /* Accumulate volume-weighted reaction rate */
             if (Qualflag == CHEM)
             {
-               rsum += ABS((seg->c - cseg))*seg->v;
-               vsum += seg->v;
+               rsum += ABS((s->c[p] - cseg))*s->v[p];
+               vsum += s->v[p];
             }
-            seg = seg->prev;
       }
 
       /* Normalize volume-weighted reaction rate */
@@ -599,16 +1218,10 @@ void  removesegs(int k)
 **-------------------------------------------------------------
 */
 {
-    Pseg seg;
-    seg = FirstSeg[k];
-    while (seg != NULL)
-    {
-        FirstSeg[k] = seg->prev;
-        seg->prev = FreeSeg;
-        FreeSeg = seg;
-        seg = FirstSeg[k];
-    }
-    LastSeg[k] = NULL;
+    Seg[k].first = 0;
+    Seg[k].n = 0;
+    Segx[k].first = 0;
+    Segx[k].n = 0;
 }
 
 
@@ -624,28 +1237,80 @@ void  addseg(int k, double v, double c)
 **-------------------------------------------------------------
 */
 {
-    Pseg seg;
+    Pseglist s = &Seg[k];
+    int      p;
+
+    if (s->n == s->size && growsegs(s,1))
+    {
+       OutOfMemory = TRUE;
+       return;
+    }
+    p = SEG(s,s->n);
+    s->v[p] = v;
+    s->c[p] = c;
+    s->n++;
+}
+
+
+void  addsegx(int k, double v, double *x)
+/*
+**-------------------------------------------------------------
+**   Input:   k = link segment
+**            v = segment volume
+**            x = segment's extra constituents
+**   Output:  none
+**   Purpose: adds an extra constituent segment to start of
+**            link k (i.e., upstream of current last segment).
+**-------------------------------------------------------------
+*/
+{
+    Pseglist s = &Segx[k];
+    int      p;
 
-    if (FreeSeg != NULL)
+    if (Ncons == 0) return;
+    if (s->n == s->size && growsegs(s,Ncons))
     {
-       seg = FreeSeg;
-       FreeSeg = seg->prev;
+       OutOfMemory = TRUE;
+       return;
     }
-    else
+    p = SEG(s,s->n);
+    s->v[p] = v;
+    memcpy(SEGX(s,p),x,Ncons*sizeof(double));
+    s->n++;
+}
+
+
+int  growsegs(Pseglist s, int w)
+/*
+**-------------------------------------------------------------
+**   Input:   s = segment list
+**            w = number of values held for each segment
+**                after its volume
+**   Output:  returns 1 if out of memory, 0 if not
+**   Purpose: replaces the buffer of segment list s by one
+**            twice its size with the segments moved to its
+**            start.
+**-------------------------------------------------------------
+*/
+{
+    double   *buf;
+    int      i, p, size;
+
+    size = (s->size > 0) ? 2*s->size : SEGSIZE;
+    buf = (double *) malloc((1+w)*size*sizeof(double));
+    if (buf == NULL) return(1);
+    for (i=0; i<s->n; i++)
     {
-        seg = (struct Sseg *) Alloc(sizeof(struct Sseg));
-        if (seg == NULL)
-        {
-           OutOfMemory = TRUE;
-           return;
-        }     
+       p = SEG(s,i);
+       buf[i] = s->v[p];
+       memcpy(buf+size+i*w,s->c+p*w,w*sizeof(double));
     }
-    seg->v = v;
-    seg->c = c;
-    seg->prev = NULL;
-    if (FirstSeg[k] == NULL) FirstSeg[k] = seg;
-    if (LastSeg[k] != NULL) LastSeg[k]->prev = seg;
-    LastSeg[k] = seg;
+    free(s->v);
+    s->v = buf;
+    s->c = buf + size;
+    s->first = 0;
+    s->size = size;
+    return(0);
 }
 
 
@@ -656,113 +1321,292 @@ void accumulate(long dt)
 **   Output:  none
 **   Purpose: accumulates mass flow at nodes and updates nodal
 **            quality   
+**
+**   Note:    The flow volume & mass leaving each link are found
+**            first (in parallel over links) and then summed at
+**            each node over its links in order of link index.
 **-------------------------------------------------------------
 */
 {
    int    i,j,k;
-   double  cseg,v,vseg;
-   Pseg   seg;
-
-   /* Re-set memory used to accumulate mass & volume */
-   memset(VolIn,0,(Nnodes+1)*sizeof(double));
-   memset(MassIn,0,(Nnodes+1)*sizeof(double));
-   memset(X,0,(Nnodes+1)*sizeof(double));
+   double  vsum,msum;
 
    /* Compute average conc. of segments adjacent to each node */
    /* (For use if there is no transport through the node) */
-   for (k=1; k<=Nlinks; k++)
+   adjqual();
+
+   /* Move mass from first segment of each pipe out of link */
+#ifdef _OPENMP
+#pragma omp parallel for private(k) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (k=1; k<=Nlinks; k++) linkoutflow(k,dt);
+
+   /* Accumulate volume & mass entering each downstream node */
+#ifdef _OPENMP
+#pragma omp parallel for private(i,j,k,msum,vsum) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (j=1; j<=Nnodes; j++)
    {
-      j = DOWN_NODE(k);             /* Downstream node */
-      if (FirstSeg[k] != NULL)      /* Accumulate concentrations */
-      {
-         MassIn[j] += FirstSeg[k]->c;
-         VolIn[j]++;
-      }
-      j = UP_NODE(k);              /* Upstream node */
-      if (LastSeg[k] != NULL)      /* Accumulate concentrations */
+      msum = 0.0;
+      vsum = 0.0;
+      for (i=Xadj[j]; i<Xadj[j+1]; i++)
       {
-         MassIn[j] += LastSeg[k]->c;
-         VolIn[j]++;
+         k = Adjlink[i];
+         if (DOWN_NODE(k) != j) continue;
+         vsum += VolOut[k];
+         msum += MassOut[k];
       }
+      VolIn[j] = vsum;
+      MassIn[j] = msum;
    }
-   for (k=1; k<=Nnodes; k++)
-     if (VolIn[k] > 0.0) X[k] = MassIn[k]/VolIn[k];
 
-   /* Move mass from first segment of each pipe into downstream node */
-   memset(VolIn,0,(Nnodes+1)*sizeof(double));
-   memset(MassIn,0,(Nnodes+1)*sizeof(double));
-   for (k=1; k<=Nlinks; k++)
+   /* Accumulate extra constituents entering each node */
+   if (Ncons > 0)
    {
-      i = UP_NODE(k);               /* Upstream node */
-      j = DOWN_NODE(k);             /* Downstream node */
-      v = ABS(Q[k])*dt;             /* Flow volume */
+#ifdef _OPENMP
+#pragma omp parallel for private(j) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+      for (j=1; j<=Nnodes; j++) gathercons(j);
+   }
+}
 
-////  Start of deprecated code segment  ////                                   //(2.00.12 - LR)
-         
-      /* If link volume < flow volume, then transport upstream    */
-      /* quality to downstream node and remove all link segments. */
-/*      if (LINKVOL(k) < v)
-      {
-         VolIn[j] += v;
-         seg = FirstSeg[k];
-         cseg = C[i];
-         if (seg != NULL) cseg = seg->c;
-         MassIn[j] += v*cseg;
-         removesegs(k);
-      }
-*/
-      /* Otherwise remove flow volume from leading segments */
-      /* and accumulate flow mass at downstream node        */
-      //else
 
-////  End of deprecated code segment.  ////                                    //(2.00.12 - LR)
+void adjqual()
+/*
+**-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: computes average concen. of the segments adjacent
+**            to each node in X[] (for use if there is no flow
+**            through the node)
+**-------------------------------------------------------------
+*/
+{
+   int    i,k,n;
+   double  vsum,msum;
+   Pseglist s;
 
-      while (v > 0.0)                                                          //(2.00.12 - LR)
+#ifdef _OPENMP
+#pragma omp parallel for private(i,k,n,msum,vsum,s) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (n=1; n<=Nnodes; n++)
+   {
+      msum = 0.0;
+      vsum = 0.0;
+      for (i=Xadj[n]; i<Xadj[n+1]; i++)
       {
-         /* Identify leading segment in pipe */
-         seg = FirstSeg[k];
-         if (seg == NULL) break;
-
-         /* Volume transported from this segment is */
-         /* minimum of flow volume & segment volume */
-         /* (unless leading segment is also last segment) */
-         vseg = seg->v;
-         vseg = MIN(vseg,v);
-         if (seg == LastSeg[k]) vseg = v;
-
-         /* Update volume & mass entering downstream node  */
-         cseg = seg->c;
-         VolIn[j] += vseg;
-         MassIn[j] += vseg*cseg;
-
-         /* Reduce flow volume by amount transported */
-         v -= vseg;
-
-         /* If all of segment's volume was transferred, then */
-         /* replace leading segment with the one behind it   */
-         /* (Note that the current seg is recycled for later use.) */
-         if (v >= 0.0 && vseg >= seg->v)
-         {
-            FirstSeg[k] = seg->prev;
-            if (FirstSeg[k] == NULL) LastSeg[k] = NULL;
-            seg->prev = FreeSeg;
-            FreeSeg = seg;
-         }
-
-         /* Otherwise reduce segment's volume */
-         else
-         {
-            seg->v -= vseg;
-         }
-      }     /* End while */
-   }        /* Next link */
+         k = Adjlink[i];
+         s = &Seg[k];
+         if (s->n == 0) continue;
+         if (DOWN_NODE(k) == n) msum += s->c[s->first];
+         else                   msum += s->c[SEG(s,s->n-1)];
+         vsum++;
+      }
+      if (vsum > 0.0) X[n] = msum/vsum;
+      else            X[n] = 0.0;
+   }
+   if (Ncons > 0) adjcons();
 }
 
 
-void updatenodes(long dt)
+void adjcons()
 /*
-**---------------------------------------------------------------------------
-**   Input:   dt = current WQ time step     
+**-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: computes average extra constituents of the
+**            segments adjacent to each node in Xx[]
+**-------------------------------------------------------------
+*/
+{
+   int    i,k,m,n,p;
+   double  vsum;
+   double  *x, *xseg;
+   Pseglist s;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(i,k,m,n,p,vsum,x,xseg,s) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (n=1; n<=Nnodes; n++)
+   {
+      vsum = 0.0;
+      x = XCONS(Xx,n);
+      for (m=0; m<Ncons; m++) x[m] = 0.0;
+      for (i=Xadj[n]; i<Xadj[n+1]; i++)
+      {
+         k = Adjlink[i];
+         s = &Segx[k];
+         if (s->n == 0) continue;
+         if (DOWN_NODE(k) == n) p = s->first;
+         else                   p = SEG(s,s->n-1);
+         xseg = SEGX(s,p);
+         for (m=0; m<Ncons; m++) x[m] += xseg[m];
+         vsum++;
+      }
+      if (vsum > 0.0)
+      {
+         for (m=0; m<Ncons; m++) x[m] /= vsum;
+      }
+   }
+}
+
+
+void gathercons(int n)
+/*
+**-------------------------------------------------------------
+**   Input:   n = node index
+**   Output:  none
+**   Purpose: sums the extra constituents leaving the flowing
+**            links into node n (in order of link index)
+**-------------------------------------------------------------
+*/
+{
+   int    i,k,m;
+   double  *xin, *xout;
+
+   xin = XCONS(MassInx,n);
+   for (m=0; m<Ncons; m++) xin[m] = 0.0;
+   for (i=Xadj[n]; i<Xadj[n+1]; i++)
+   {
+      k = Adjlink[i];
+      if (Q[k] == 0.0 || DOWN_NODE(k) != n) continue;
+      xout = XCONS(MassOutx,k);
+      for (m=0; m<Ncons; m++) xin[m] += xout[m];
+   }
+}
+
+
+void linkoutflow(int k, long dt)
+/*
+**-------------------------------------------------------------
+**   Input:   k  = link index
+**            dt = current WQ time step
+**   Output:  none
+**   Purpose: removes the flow volume over time dt from the
+**            leading segments of link k and finds the volume
+**            & mass leaving the link (in VolOut[k] & MassOut[k])
+**-------------------------------------------------------------
+*/
+{
+   int    p;
+   double  cseg,v,vseg;
+   Pseglist s;
+
+   v = ABS(Q[k])*dt;             /* Flow volume */
+   s = &Seg[k];
+   VolOut[k] = 0.0;
+   MassOut[k] = 0.0;
+   if (Ncons > 0) linkcons(k,v);
+
+////  Start of deprecated code segment  ////                                   //(2.00.12 - LR)
+         
+   /* If link volume < flow volume, then transport upstream    */
+   /* quality to downstream node and remove all link segments. */
+/*   if (LINKVOL(k) < v)
+   {
+      VolIn[j] += v;
+      seg = FirstSeg[k];
+      cseg = C[i];
+      if (seg != NULL) cseg = seg->c;
+      MassIn[j] += v*cseg;
+      removesegs(k);
+   }
+*/
+   /* Otherwise remove flow volume from leading segments */
+   /* and accumulate flow mass leaving the link          */
+   //else
+
+////  End of deprecated code segment.  ////                                    //(2.00.12 - LR)
+
+   while (v > 0.0)                                                             //(2.00.12 - LR)
+   {
+      /* Identify leading segment in pipe */
+      if (s->n == 0) break;
+      p = s->first;
+
+      /* Volume transported from this segment is */
+      /* minimum of flow volume & segment volume */
+      /* (unless leading segment is also last segment) */
+      vseg = s->v[p];
+      vseg = MIN(vseg,v);
+      if (s->n == 1) vseg = v;
+
+      /* Update volume & mass leaving the link */
+      cseg = s->c[p];
+      VolOut[k] += vseg;
+      MassOut[k] += vseg*cseg;
+
+      /* Reduce flow volume by amount transported */
+      v -= vseg;
+
+      /* If all of segment's volume was transferred, then */
+      /* replace leading segment with the one behind it   */
+      if (v >= 0.0 && vseg >= s->v[p])
+      {
+         s->first = SEG(s,1);
+         s->n--;
+      }
+
+      /* Otherwise reduce segment's volume */
+      else
+      {
+         s->v[p] -= vseg;
+      }
+   }     /* End while */
+
+   /* An emptied link is refilled in releaselink(), so */
+   /* the extra constituents are emptied along with it */
+   if (s->n == 0) Segx[k].n = 0;
+}
+
+
+void linkcons(int k, double v)
+/*
+**-------------------------------------------------------------
+**   Input:   k = link index
+**            v = flow volume leaving the link
+**   Output:  none
+**   Purpose: removes flow volume v from the leading extra
+**            constituent segments of link k and finds the
+**            extra constituents leaving the link (in MassOutx[])
+**-------------------------------------------------------------
+*/
+{
+   int    m,p;
+   double  vseg;
+   double  *xout, *xseg;
+   Pseglist s;
+
+   s = &Segx[k];
+   xout = XCONS(MassOutx,k);
+   for (m=0; m<Ncons; m++) xout[m] = 0.0;
+   while (v > 0.0)
+   {
+      if (s->n == 0) break;
+      p = s->first;
+      vseg = s->v[p];
+      vseg = MIN(vseg,v);
+      if (s->n == 1) vseg = v;
+      xseg = SEGX(s,p);
+      for (m=0; m<Ncons; m++) xout[m] += vseg*xseg[m];
+      v -= vseg;
+      if (v >= 0.0 && vseg >= s->v[p])
+      {
+         s->first = SEG(s,1);
+         s->n--;
+      }
+      else
+      {
+         s->v[p] -= vseg;
+      }
+   }
+}
+
+
+void updatenodes(long dt)
+/*
+**---------------------------------------------------------------------------
+**   Input:   dt = current WQ time step     
 **   Output:  none
 **   Purpose: updates concentration at all nodes to mixture of accumulated
 **            inflow from connecting pipes.
@@ -781,6 +1625,7 @@ void updatenodes(long dt)
       if (D[i] < 0.0) VolIn[i] -= D[i]*dt;
       if (VolIn[i] > 0.0) C[i] = MassIn[i]/VolIn[i];
       else                C[i] = X[i];
+      if (Ncons > 0) nodecons(i);
    }
 
    /* Update tank quality */
@@ -788,6 +1633,33 @@ void updatenodes(long dt)
 
    /* For flow tracing, set source node concen. to 100. */
    if (Qualflag == TRACE) C[TraceNode] = 100.0;
+   for (i=1; i<=Ncons; i++)
+   {
+      if (Cons[i].Type == TRACE) XCONS(Cx,Cons[i].Node)[i-1] = 100.0;
+   }
+}
+
+
+void nodecons(int n)
+/*
+**---------------------------------------------------------------------------
+**   Input:   n = junction index
+**   Output:  none
+**   Purpose: updates extra constituents at junction n to mixture of its
+**            accumulated inflow (or to average of adjacent segments if
+**            there was no inflow)
+**---------------------------------------------------------------------------
+*/
+{
+   int m;
+   double *x = XCONS(Cx,n),
+          *xin = XCONS(MassInx,n);
+
+   if (VolIn[n] > 0.0)
+   {
+      for (m=0; m<Ncons; m++) x[m] = xin[m]/VolIn[n];
+   }
+   else memcpy(x,XCONS(Xx,n),Ncons*sizeof(double));
 }
 
 
@@ -801,96 +1673,120 @@ void sourceinput(long dt)
 **---------------------------------------------------------------------
 */
 {
-   int   j,n;
-   double massadded = 0.0, s, volout;
-   double qout, qcutoff;
-   Psource source;
-
-   /* Establish a flow cutoff which indicates no outflow from a node */
-   qcutoff = 10.0*TINY;
+   int   n;
 
    /* Zero-out the work array X */
    memset(X,0,(Nnodes+1)*sizeof(double));
    if (Qualflag != CHEM) return;
 
    /* Consider each node */
-   for (n=1; n<=Nnodes; n++)
-   {
+   for (n=1; n<=Nnodes; n++) X[n] = nodesource(n,dt);
 
-      /* Skip node if no WQ source */
-      source = Node[n].S;
-      if (source == NULL) continue;
-      if (source->C0 == 0.0) continue;
+   /* Add mass inflows from reservoirs to Wsource*/
+   reservoirmass(dt);
+}
+
+
+double nodesource(int n, long dt)
+/*
+**---------------------------------------------------------------------
+**   Input:   n  = node index
+**            dt = current WQ time step     
+**   Output:  returns concen. added to outflow of node n by its source
+**   Purpose: computes contribution (if any) of mass addition from a WQ
+**            source at node n.
+**---------------------------------------------------------------------
+*/
+{
+   double massadded = 0.0, s, volout;
+   double qout, qcutoff;
+   Psource source;
+
+   /* Establish a flow cutoff which indicates no outflow from a node */
+   qcutoff = 10.0*TINY;
+
+   /* Skip node if no WQ source */
+   source = Node[n].S;
+   if (source == NULL) return(0.0);
+   if (source->C0 == 0.0) return(0.0);
     
-      /* Find total flow volume leaving node */
-      if (n <= Njuncs) volout = VolIn[n];  /* Junctions */
-      else volout = VolIn[n] - D[n]*dt;    /* Tanks */
-      qout = volout / (double) dt;
+   /* Find total flow volume leaving node */
+   if (n <= Njuncs) volout = VolIn[n];  /* Junctions */
+   else volout = VolIn[n] - D[n]*dt;    /* Tanks */
+   qout = volout / (double) dt;
 
-      /* Evaluate source input only if node outflow > cutoff flow */
-      if (qout > qcutoff)
-      {
+   /* Evaluate source input only if node outflow > cutoff flow */
+   if (qout <= qcutoff) return(0.0);
+
+   /* Mass added depends on type of source */
+   s = sourcequal(source);
+   switch(source->Type)
+   {
+      /* Concen. Source: */
+      /* Mass added = source concen. * -(demand) */
+      case CONCEN:
 
-         /* Mass added depends on type of source */
-         s = sourcequal(source);
-         switch(source->Type)
+         /* Only add source mass if demand is negative */
+         if (D[n] < 0.0)
          {
-            /* Concen. Source: */
-            /* Mass added = source concen. * -(demand) */
-            case CONCEN:
-
-               /* Only add source mass if demand is negative */
-               if (D[n] < 0.0)
-               {
-                  massadded = -s*D[n]*dt;
-
-                  /* If node is a tank then set concen. to 0. */
-                  /* (It will be re-set to true value in updatesourcenodes()) */
-                  if (n > Njuncs) C[n] = 0.0;
-               }
-               else massadded = 0.0;
-               break;
-
-            /* Mass Inflow Booster Source: */
-            case MASS:
-               massadded = s*dt;
-               break;
-
-            /* Setpoint Booster Source: */
-            /* Mass added is difference between source */
-            /* & node concen. times outflow volume  */
-            case SETPOINT:
-               if (s > C[n]) massadded = (s-C[n])*volout;
-               else massadded = 0.0;
-               break;
-
-            /* Flow-Paced Booster Source: */
-            /* Mass added = source concen. times outflow volume */
-            case FLOWPACED:
-               massadded = s*volout;
-               break;
+            massadded = -s*D[n]*dt;
+
+            /* If node is a tank then set concen. to 0. */
+            /* (It will be re-set to true value in updatesourcenodes()) */
+            if (n > Njuncs) C[n] = 0.0;
          }
+         else massadded = 0.0;
+         break;
+
+      /* Mass Inflow Booster Source: */
+      case MASS:
+         massadded = s*dt;
+         break;
+
+      /* Setpoint Booster Source: */
+      /* Mass added is difference between source */
+      /* & node concen. times outflow volume  */
+      case SETPOINT:
+         if (s > C[n]) massadded = (s-C[n])*volout;
+         else massadded = 0.0;
+         break;
+
+      /* Flow-Paced Booster Source: */
+      /* Mass added = source concen. times outflow volume */
+      case FLOWPACED:
+         massadded = s*volout;
+         break;
+   }
 
-         /* Source concen. contribution = (mass added / outflow volume) */
-         X[n] = massadded/volout;
+   /* Update total mass added for time period & simulation */
+   source->Smass += massadded;
+   if (Htime >= Rstart) Wsource += massadded;
 
-         /* Update total mass added for time period & simulation */
-         source->Smass += massadded;
-         if (Htime >= Rstart) Wsource += massadded;
-      }
-   }
+   /* Source concen. contribution = (mass added / outflow volume) */
+   return(massadded/volout);
+}
 
-   /* Add mass inflows from reservoirs to Wsource*/
-   if (Htime >= Rstart)
+
+void reservoirmass(long dt)
+/*
+**---------------------------------------------------------------------
+**   Input:   dt = current WQ time step     
+**   Output:  none
+**   Purpose: adds mass inflows from reservoirs to Wsource.
+**---------------------------------------------------------------------
+*/
+{
+   int   j,n;
+   double volout;
+
+   if (Htime < Rstart) return;
+   for (j=1; j<=Ntanks; j++)
    {
-      for (j=1; j<=Ntanks; j++)
+      if (Tank[j].A == 0.0)
       {
-         if (Tank[j].A == 0.0)
-         {
-            n = Njuncs + j;
-            volout = VolIn[n] - D[n]*dt;
-            if (volout > 0.0) Wsource += volout*C[n];
-         }
+         n = Njuncs + j;
+         volout = VolIn[n] - D[n]*dt;
+         if (volout > 0.0) Wsource += volout*C[n];
       }
    }
 }
@@ -905,44 +1801,229 @@ void release(long dt)
 **---------------------------------------------------------
 */
 {
-   int    k,n;
-   double  c,q,v;
-   Pseg   seg;
+   int    k;
 
    /* Examine each link */
-   for (k=1; k<=Nlinks; k++)
+#ifdef _OPENMP
+#pragma omp parallel for private(k) schedule(static) if (Threads > 1) num_threads(Threads)
+#endif
+   for (k=1; k<=Nlinks; k++) releaselink(k,dt);
+}
+
+
+void releaselink(int k, long dt)
+/*
+**---------------------------------------------------------
+**   Input:   k  = link index
+**            dt = current WQ time step
+**   Output:  none
+**   Purpose: creates new segment (if needed) in link k for
+**            the flow released from its upstream node.
+**---------------------------------------------------------
+*/
+{
+   int    n,p;
+   double  c,q,v;
+   Pseglist s;
+
+   /* Ignore links with no flow */
+   if (Q[k] == 0.0) return;
+
+   /* Find flow volume released to link from upstream node */
+   /* (NOTE: Flow volume is allowed to be > link volume.) */
+   n = UP_NODE(k);
+   q = ABS(Q[k]);
+   v = q*dt;
+
+   /* Include source contribution in quality released from node. */
+   c = C[n] + X[n];
+
+   /* Release the extra constituents into their own segments */
+   /* (filling an empty link, as is done below)              */
+   s = &Seg[k];
+   if (Ncons > 0)
+      releasecons(k,(s->n > 0) ? v : LINKVOL(k),XCONS(Cx,n));
+
+   /* If link has a last seg, check if its quality     */
+   /* differs from that of the flow released from node.*/
+   if (s->n > 0)
+   {
+      /* Quality of seg close to that of node */
+      p = SEG(s,s->n-1);
+      if (ABS(s->c[p] - c) < Ctol)
+      {
+         s->c[p] = (s->c[p]*s->v[p] + c*v) / (s->v[p] + v);                    //(2.00.11 - LR)
+         s->v[p] += v;
+      }
+
+      /* Otherwise add a new seg to end of link */
+      else addseg(k,v,c);
+   }
+
+   /* If link has no segs then add a new one. */
+   else addseg(k,LINKVOL(k),c);
+}
+
+
+void releasecons(int k, double v, double *x)
+/*
+**---------------------------------------------------------
+**   Input:   k = link index
+**            v = flow volume released into the link
+**            x = extra constituents of the flow
+**   Output:  none
+**   Purpose: adds the flow released into link k to its last
+**            extra constituent segment if they are the same,
+**            or as a new segment if not.
+**---------------------------------------------------------
+*/
+{
+   int    p;
+   Pseglist s = &Segx[k];
+
+   if (s->n > 0)
    {
+      p = SEG(s,s->n-1);
+      if (samecons(SEGX(s,p),x))
+      {
+         mixcons(SEGX(s,p),s->v[p],x,v);
+         s->v[p] += v;
+         return;
+      }
+   }
+   addsegx(k,v,x);
+}
 
-      /* Ignore links with no flow */
-      if (Q[k] == 0.0) continue;
 
-      /* Find flow volume released to link from upstream node */
-      /* (NOTE: Flow volume is allowed to be > link volume.) */
-      n = UP_NODE(k);
-      q = ABS(Q[k]);
-      v = q*dt;
+int  sortnodes()
+/*
+**---------------------------------------------------------
+**   Input:   none
+**   Output:  returns number of nodes taken out of order
+**   Purpose: lists the nodes in Sorted[] so that each node
+**            comes after the upstream nodes of its inflow
+**            links under the current flows.
+**
+**   Note:    Nodes with no unlisted upstream nodes are
+**            listed in the order they are found. If nodes
+**            are left that are all on flow loops, the one
+**            with lowest index is listed next, and then the
+**            flow out of it through the loop is routed with
+**            the link contents of the last time step.
+**---------------------------------------------------------
+*/
+{
+   int i, j, k, m, n, next, nloops;
+   int *nin = Sorted + Nnodes + 1;   /* Unlisted inflow links */
 
-      /* Include source contribution in quality released from node. */
-      c = C[n] + X[n];
+   /* Count flowing inflow links of each node */
+   memset(nin,0,(Nnodes+1)*sizeof(int));
+   for (k=1; k<=Nlinks; k++)
+   {
+      if (Q[k] != 0.0) nin[DOWN_NODE(k)]++;
+   }
 
-      /* If link has a last seg, check if its quality     */
-      /* differs from that of the flow released from node.*/
-      if ( (seg = LastSeg[k]) != NULL)
+   /* List the nodes with no inflow links */
+   m = 0;
+   for (n=1; n<=Nnodes; n++)
+   {
+      if (nin[n] == 0)
+      {
+         Sorted[++m] = n;
+         nin[n] = -1;
+      }
+   }
+
+   /* List the nodes downstream of each listed node */
+   /* once all of their inflow links are listed     */
+   nloops = 0;
+   next = 1;
+   for (i=1; i<=Nnodes; i++)
+   {
+      if (i > m)
+      {
+         while (nin[next] < 0) next++;
+         Sorted[++m] = next;
+         nin[next] = -1;
+         nloops++;
+      }
+      n = Sorted[i];
+      for (j=Xadj[n]; j<Xadj[n+1]; j++)
       {
-         /* Quality of seg close to that of node */
-         if (ABS(seg->c - c) < Ctol)
+         k = Adjlink[j];
+         if (Q[k] == 0.0 || UP_NODE(k) != n) continue;
+         k = DOWN_NODE(k);
+         if (nin[k] > 0 && --nin[k] == 0)
          {
-            seg->c = (seg->c*seg->v + c*v) / (seg->v + v);                     //(2.00.11 - LR)
-            seg->v += v;
+            Sorted[++m] = k;
+            nin[k] = -1;
          }
+      }
+   }
+   return(nloops);
+}
+
 
-         /* Otherwise add a new seg to end of link */
-         else addseg(k,v,c);
+void routenodes(long dt)
+/*
+**---------------------------------------------------------
+**   Input:   dt = current WQ time step
+**   Output:  none
+**   Purpose: transports flow over time dt node by node, in
+**            the order of Sorted[], so that the flow released
+**            from a node is carried on downstream in the same
+**            time step.
+**---------------------------------------------------------
+*/
+{
+   int    i, j, k, m, n;
+
+   /* Find average concen. of segments adjacent to each node */
+   adjqual();
+
+   for (i=1; i<=Nnodes; i++)
+   {
+      n = Sorted[i];
+
+      /* Take in the flow leaving the node's inflow links */
+      VolIn[n] = 0.0;
+      MassIn[n] = 0.0;
+      for (j=Xadj[n]; j<Xadj[n+1]; j++)
+      {
+         k = Adjlink[j];
+         if (Q[k] == 0.0 || DOWN_NODE(k) != n) continue;
+         linkoutflow(k,dt);
+         VolIn[n] += VolOut[k];
+         MassIn[n] += MassOut[k];
       }
+      if (Ncons > 0) gathercons(n);
 
-      /* If link has no segs then add a new one. */
-      else addseg(k,LINKVOL(k),c);
+      /* Update the node's quality & add any source input */
+      if (n <= Njuncs)
+      {
+         if (D[n] < 0.0) VolIn[n] -= D[n]*dt;
+         if (VolIn[n] > 0.0) C[n] = MassIn[n]/VolIn[n];
+         else                C[n] = X[n];
+         nodecons(n);
+      }
+      else updatetank(n-Njuncs,dt);
+      if (Qualflag == TRACE && n == TraceNode) C[n] = 100.0;
+      for (m=1; m<=Ncons; m++)
+      {
+         if (Cons[m].Type == TRACE && Cons[m].Node == n)
+            XCONS(Cx,n)[m-1] = 100.0;
+      }
+      if (Qualflag == CHEM) X[n] = nodesource(n,dt);
+      else                  X[n] = 0.0;
+
+      /* Release the node's outflow into its outflow links */
+      for (j=Xadj[n]; j<Xadj[n+1]; j++)
+      {
+         k = Adjlink[j];
+         if (UP_NODE(k) == n) releaselink(k,dt);
+      }
    }
+   if (Qualflag == CHEM) reservoirmass(dt);
 }
 
 
@@ -992,27 +2073,40 @@ void  updatetanks(long dt)
 **---------------------------------------------------
 */
 {
-    int   i,n;
+    int   i;
 
    /* Examine each reservoir & tank */
-   for (i=1; i<=Ntanks; i++)
-   {
+   for (i=1; i<=Ntanks; i++) updatetank(i,dt);
+}
 
-      /* Use initial quality for reservoirs */
-      if (Tank[i].A == 0.0)
-      {
-         n = Tank[i].Node;
-         C[n] = Node[n].C0;
-      }
 
-      /* Update tank WQ based on mixing model */
-      else switch(Tank[i].MixModel)
-      {
-         case MIX2: tankmix2(i,dt); break;
-         case FIFO: tankmix3(i,dt); break;
-         case LIFO: tankmix4(i,dt); break;
-         default:   tankmix1(i,dt); break;
-      }
+void  updatetank(int i, long dt)
+/*
+**---------------------------------------------------
+**   Input:   i  = tank index
+**            dt = current WQ time step     
+**   Output:  none
+**   Purpose: updates volume & concentration of tank i
+**---------------------------------------------------
+*/
+{
+    int   n;
+
+   /* Use initial quality for reservoirs */
+   if (Tank[i].A == 0.0)
+   {
+      n = Tank[i].Node;
+      C[n] = Node[n].C0;
+      memset(XCONS(Cx,n),0,Ncons*sizeof(double));
+   }
+
+   /* Update tank WQ based on mixing model */
+   else switch(Tank[i].MixModel)
+   {
+      case MIX2: tankmix2(i,dt); break;
+      case FIFO: tankmix3(i,dt); break;
+      case LIFO: tankmix4(i,dt); break;
+      default:   tankmix1(i,dt); break;
    }
 }
 
@@ -1061,6 +2155,7 @@ void  tankmix1(int i, long dt)
     int   n;
     double cin;
     double c, cmax, vold, vin;
+    double *x;
 
    /* React contents of tank */
    c = tankreact(Tank[i].C,Tank[i].V,Tank[i].Kb,dt);
@@ -1068,6 +2163,8 @@ void  tankmix1(int i, long dt)
    /* Determine tank & volumes */
    vold = Tank[i].V;
    n = Tank[i].Node;
+   x = XCONS(Cx,n);
+   reactcons(x,dt);
    Tank[i].V += D[n]*dt;
    vin  = VolIn[n];
 
@@ -1082,6 +2179,7 @@ void  tankmix1(int i, long dt)
    c = MAX(c, 0.0);
    Tank[i].C = c;
    C[n] = Tank[i].C;
+   if (vin > 0.0) mixcons(x,vold,inflowcons(n),vin);
 }
 
 /*** Updated 10/25/00 ***/
@@ -1098,23 +2196,24 @@ void  tankmix2(int i, long dt)
 **------------------------------------------------
 */
 {
-    int     k,n;
+    int     k,n,p1,p2;
     double  cin,        /* Inflow quality */
             vin,        /* Inflow volume */
             vt,         /* Transferred volume */
             vnet,       /* Net volume change */
             v1max;      /* Full mixing zone volume */
-   Pseg     seg1,seg2;  /* Compartment segments */
+   Pseglist s;          /* Compartment segments */
 
    /* Identify segments for each compartment */
    k = Nlinks + i;
-   seg1 = LastSeg[k];
-   seg2 = FirstSeg[k];
-   if (seg1 == NULL || seg2 == NULL) return;
+   s = &Seg[k];
+   if (s->n == 0) return;
+   p1 = SEG(s,s->n-1);
+   p2 = s->first;
 
    /* React contents of each compartment */
-   seg1->c = tankreact(seg1->c,seg1->v,Tank[i].Kb,dt);
-   seg2->c = tankreact(seg2->c,seg2->v,Tank[i].Kb,dt);
+   s->c[p1] = tankreact(s->c[p1],s->v[p1],Tank[i].Kb,dt);
+   s->c[p2] = tankreact(s->c[p2],s->v[p2],Tank[i].Kb,dt);
 
    /* Find inflows & outflows */
    n = Tank[i].Node;
@@ -1128,44 +2227,44 @@ void  tankmix2(int i, long dt)
    vt = 0.0;
    if (vnet > 0.0)
    {
-      vt = MAX(0.0, (seg1->v + vnet - v1max));
+      vt = MAX(0.0, (s->v[p1] + vnet - v1max));
       if (vin > 0.0)
       {
-         seg1->c = ((seg1->c)*(seg1->v) + cin*vin) / (seg1->v + vin);
+         s->c[p1] = (s->c[p1]*s->v[p1] + cin*vin) / (s->v[p1] + vin);
       }
       if (vt > 0.0)
       {
-         seg2->c = ((seg2->c)*(seg2->v) + (seg1->c)*vt) / (seg2->v + vt);
+         s->c[p2] = (s->c[p2]*s->v[p2] + s->c[p1]*vt) / (s->v[p2] + vt);
       }
    }
 
    /* Tank is emptying */
    if (vnet < 0.0)
    {
-      if (seg2->v > 0.0)
+      if (s->v[p2] > 0.0)
       {
-         vt = MIN(seg2->v, (-vnet));
+         vt = MIN(s->v[p2], (-vnet));
       }
       if (vin + vt > 0.0)
       {
-         seg1->c = ((seg1->c)*(seg1->v) + cin*vin + (seg2->c)*vt) /
-                   (seg1->v + vin + vt);
+         s->c[p1] = (s->c[p1]*s->v[p1] + cin*vin + s->c[p2]*vt) /
+                    (s->v[p1] + vin + vt);
       }
    }
 
    /* Update segment volumes */
    if (vt > 0.0)
    {
-      seg1->v = v1max;
-      if (vnet > 0.0) seg2->v += vt;
-      else            seg2->v = MAX(0.0, ((seg2->v)-vt));
+      s->v[p1] = v1max;
+      if (vnet > 0.0) s->v[p2] += vt;
+      else            s->v[p2] = MAX(0.0, (s->v[p2]-vt));
    }
    else
    {
-      seg1->v += vnet;
-      seg1->v = MIN(seg1->v, v1max);
-      seg1->v = MAX(0.0, seg1->v);
-      seg2->v = 0.0;
+      s->v[p1] += vnet;
+      s->v[p1] = MIN(s->v[p1], v1max);
+      s->v[p1] = MAX(0.0, s->v[p1]);
+      s->v[p2] = 0.0;
    }
    Tank[i].V += vnet;
    Tank[i].V = MAX(0.0, Tank[i].V);
@@ -1173,8 +2272,11 @@ void  tankmix2(int i, long dt)
    /* Use quality of mixed compartment (seg1) to */
    /* represent quality of tank since this is where */
    /* outflow begins to flow from */
-   Tank[i].C = seg1->c;
+   Tank[i].C = s->c[p1];
    C[n] = Tank[i].C;
+
+   /* Update the extra constituents in their own segments */
+   if (Ncons > 0) mix2cons(i,dt);
 }
 
 
@@ -1188,22 +2290,22 @@ void  tankmix3(int i, long dt)
 **----------------------------------------------------------
 */
 {
-   int   k,n;
+   int   j,k,n,p;
    double vin,vnet,vout,vseg;
    double cin,vsum,csum;
-   Pseg  seg;
+   Pseglist s;
 
    k = Nlinks + i;
-   if (LastSeg[k] == NULL || FirstSeg[k] == NULL) return;
+   s = &Seg[k];
+   if (s->n == 0) return;
 
    /* React contents of each compartment */
    if (Reactflag)
    {
-      seg = FirstSeg[k];
-      while (seg != NULL)
+      for (j=0; j<s->n; j++)
       {
-         seg->c = tankreact(seg->c,seg->v,Tank[i].Kb,dt);
-         seg = seg->prev;
+         p = SEG(s,j);
+         s->c[p] = tankreact(s->c[p],s->v[p],Tank[i].Kb,dt);
       }
    }
 
@@ -1222,51 +2324,46 @@ void  tankmix3(int i, long dt)
    csum = 0.0;
    while (vout > 0.0)
    {
-      seg = FirstSeg[k];
-      if (seg == NULL) break;
-      vseg = seg->v;           /* Flow volume from leading seg */
+      p = s->first;
+      vseg = s->v[p];          /* Flow volume from leading seg */
       vseg = MIN(vseg,vout);
-      if (seg == LastSeg[k]) vseg = vout;
+      if (s->n == 1) vseg = vout;
       vsum += vseg;
-      csum += (seg->c)*vseg;
+      csum += s->c[p]*vseg;
       vout -= vseg;            /* Remaining flow volume */
-      if (vout >= 0.0 && vseg >= seg->v)  /* Seg used up */
+      if (vout >= 0.0 && vseg >= s->v[p])  /* Seg used up */
       {
-         if (seg->prev)                                                        //(2.00.12 - LR)
+         if (s->n > 1)                                                         //(2.00.12 - LR)
          {                                                                     //(2.00.12 - LR)
-            FirstSeg[k] = seg->prev;
-            //if (FirstSeg[k] == NULL) LastSeg[k] = NULL;                      //(2.00.12 - LR)
-            seg->prev = FreeSeg;
-            FreeSeg = seg;
+            s->first = SEG(s,1);
+            s->n--;
          }                                                                     //(2.00.12 - LR)
       }
       else                /* Remaining volume in segment */
       {
-         seg->v -= vseg;
+         s->v[p] -= vseg;
       }
    }
 
    /* Use quality withdrawn from 1st segment */
    /* to represent overall quality of tank */
    if (vsum > 0.0) Tank[i].C = csum/vsum;
-   else            Tank[i].C = FirstSeg[k]->c;
+   else            Tank[i].C = s->c[s->first];
    C[n] = Tank[i].C;
 
    /* Add new last segment for new flow entering tank */
    if (vin > 0.0)
    {
-      if ( (seg = LastSeg[k]) != NULL)
-      {
-         /* Quality is the same, so just add flow volume to last seg */
-         if (ABS(seg->c - cin) < Ctol) seg->v += vin;
-
-         /* Otherwise add a new seg to tank */
-         else addseg(k,vin,cin);
-      }
+      /* Quality is the same, so just add flow volume to last seg */
+      p = SEG(s,s->n-1);
+      if (ABS(s->c[p] - cin) < Ctol) s->v[p] += vin;
 
-      /* If no segs left then add a new one. */
+      /* Otherwise add a new seg to tank */
       else addseg(k,vin,cin);
    }
+
+   /* Update the extra constituents in their own segments */
+   if (Ncons > 0) fifocons(i,dt);
 }   
 
 
@@ -1277,24 +2374,27 @@ void  tankmix4(int i, long dt)
 **            dt = current WQ time step     
 **   Output:  none
 **   Purpose: Last In-First Out (LIFO) tank model                     
+**
+**   Note:    The last segment is the top of the stack of
+**            segments and the first one is its bottom.
 **----------------------------------------------------------
 */
 {
-   int   k, n;
+   int   j, k, n, p;
    double vin, vnet, cin, vsum, csum, vseg;
-   Pseg  seg, tmpseg;
+   Pseglist s;
 
    k = Nlinks + i;
-   if (LastSeg[k] == NULL || FirstSeg[k] == NULL) return;
+   s = &Seg[k];
+   if (s->n == 0) return;
 
    /* React contents of each compartment */
    if (Reactflag)
    {
-      seg = LastSeg[k];
-      while (seg != NULL)
+      for (j=0; j<s->n; j++)
       {
-         seg->c = tankreact(seg->c,seg->v,Tank[i].Kb,dt);
-         seg = seg->prev;
+         p = SEG(s,j);
+         s->c[p] = tankreact(s->c[p],s->v[p],Tank[i].Kb,dt);
       }
    }
 
@@ -1306,32 +2406,20 @@ void  tankmix4(int i, long dt)
    else           cin = 0.0;
    Tank[i].V += vnet;
    Tank[i].V = MAX(0.0, Tank[i].V);                                            //(2.00.12 - LR)
-   Tank[i].C = LastSeg[k]->c;
+   p = SEG(s,s->n-1);
+   Tank[i].C = s->c[p];
 
    /* If tank filling, then create new last seg */ 
    if (vnet > 0.0)
    {
-      if ( (seg = LastSeg[k]) != NULL)
-      {
-         /* Quality is the same, so just add flow volume to last seg */
-         if (ABS(seg->c - cin) < Ctol) seg->v += vnet;
+      /* Quality is the same, so just add flow volume to last seg */
+      if (ABS(s->c[p] - cin) < Ctol) s->v[p] += vnet;
 
-         /* Otherwise add a new last seg to tank */
-         /* which points to old last seg */ 
-         else
-         {
-            tmpseg = seg;
-            LastSeg[k] = NULL;
-            addseg(k,vnet,cin);
-            LastSeg[k]->prev = tmpseg;
-         }
-      }
-
-      /* If no segs left then add a new one. */
+      /* Otherwise add a new last seg to tank */
       else addseg(k,vnet,cin);
 
       /* Update reported tank quality */
-      Tank[i].C = LastSeg[k]->c;
+      Tank[i].C = s->c[SEG(s,s->n-1)];
    }
 
    /* If net emptying then remove last segments until vnet consumed */
@@ -1342,33 +2430,248 @@ void  tankmix4(int i, long dt)
       vnet = -vnet;
       while (vnet > 0.0)
       {
-         seg = LastSeg[k];
-         if (seg == NULL) break;
-         vseg = seg->v;
+         p = SEG(s,s->n-1);
+         vseg = s->v[p];
          vseg = MIN(vseg,vnet);
-         if (seg == FirstSeg[k]) vseg = vnet;
+         if (s->n == 1) vseg = vnet;
          vsum += vseg;
-         csum += (seg->c)*vseg;
+         csum += s->c[p]*vseg;
          vnet -= vseg;
-         if (vnet >= 0.0 && vseg >= seg->v)  /* Seg used up */
+         if (vnet >= 0.0 && vseg >= s->v[p])  /* Seg used up */
          {
-            if (seg->prev)                                                     //(2.00.12 - LR)
-            {                                                                  //(2.00.12 - LR)
-               LastSeg[k] = seg->prev;
-               //if (LastSeg[k] == NULL) FirstSeg[k] = NULL;                   //(2.00.12 - LR)
-               seg->prev = FreeSeg;
-               FreeSeg = seg;
-            }                                                                  //(2.00.12 - LR)
+            if (s->n > 1) s->n--;                                              //(2.00.12 - LR)
          }
          else                /* Remaining volume in segment */
          {
-            seg->v -= vseg;
+            s->v[p] -= vseg;
          }
       }
       /* Reported tank quality is mixture of flow released and any inflow */
       Tank[i].C = (csum + MassIn[n])/(vsum + vin);
    }
    C[n] = Tank[i].C;
+
+   /* Update the extra constituents in their own segments */
+   if (Ncons > 0) lifocons(i,dt);
+}
+
+void  mix2cons(int i, long dt)
+/*
+**------------------------------------------------
+**   Input:   i = tank index
+**            dt = current WQ time step
+**   Output:  none
+**   Purpose: updates the extra constituents of the
+**            compartments of 2-compartment tank i
+**            as tankmix2() does its quality
+**------------------------------------------------
+*/
+{
+   int      n,p1,p2;
+   double   vin,vt,vnet,v1max;
+   double   *x1, *x2, *xin;
+   Pseglist s;
+
+   s = &Segx[Nlinks+i];
+   if (s->n == 0) return;
+   p1 = SEG(s,s->n-1);
+   p2 = s->first;
+   x1 = SEGX(s,p1);
+   x2 = SEGX(s,p2);
+   reactcons(x1,dt);
+   reactcons(x2,dt);
+
+   /* Find inflows & outflows */
+   n = Tank[i].Node;
+   vnet = D[n]*dt;
+   vin = VolIn[n];
+   xin = inflowcons(n);
+   v1max = Tank[i].V1max;
+
+   /* Tank is filling */
+   vt = 0.0;
+   if (vnet > 0.0)
+   {
+      vt = MAX(0.0, (s->v[p1] + vnet - v1max));
+      if (vin > 0.0) mixcons(x1,s->v[p1],xin,vin);
+      if (vt > 0.0)  mixcons(x2,s->v[p2],x1,vt);
+   }
+
+   /* Tank is emptying */
+   if (vnet < 0.0)
+   {
+      if (s->v[p2] > 0.0) vt = MIN(s->v[p2], (-vnet));
+      if (vin + vt > 0.0)
+      {
+         mixcons(x1,s->v[p1],xin,vin);
+         mixcons(x1,s->v[p1]+vin,x2,vt);
+      }
+   }
+
+   /* Update segment volumes */
+   if (vt > 0.0)
+   {
+      s->v[p1] = v1max;
+      if (vnet > 0.0) s->v[p2] += vt;
+      else            s->v[p2] = MAX(0.0, (s->v[p2]-vt));
+   }
+   else
+   {
+      s->v[p1] += vnet;
+      s->v[p1] = MIN(s->v[p1], v1max);
+      s->v[p1] = MAX(0.0, s->v[p1]);
+      s->v[p2] = 0.0;
+   }
+   memcpy(XCONS(Cx,n),x1,Ncons*sizeof(double));
+}
+
+
+void  fifocons(int i, long dt)
+/*
+**----------------------------------------------------------
+**   Input:   i = tank index
+**            dt = current WQ time step
+**   Output:  none
+**   Purpose: updates the extra constituents of the segments
+**            of FIFO tank i as tankmix3() does its quality
+**----------------------------------------------------------
+*/
+{
+   int   j,k,m,n,p;
+   double vin,vout,vseg,vsum;
+   double *x, *xin, *xseg;
+   Pseglist s;
+
+   k = Nlinks + i;
+   s = &Segx[k];
+   if (s->n == 0) return;
+   if (Ageflag)
+   {
+      for (j=0; j<s->n; j++) reactcons(SEGX(s,SEG(s,j)),dt);
+   }
+
+   /* Find inflows & outflows */
+   n = Tank[i].Node;
+   vin = VolIn[n];
+   vout = vin - D[n]*dt;
+   x = XCONS(Cx,n);
+
+   /* Withdraw flow from first segment */
+   vsum = 0.0;
+   for (m=0; m<Ncons; m++) x[m] = 0.0;
+   while (vout > 0.0)
+   {
+      p = s->first;
+      vseg = s->v[p];
+      vseg = MIN(vseg,vout);
+      if (s->n == 1) vseg = vout;
+      vsum += vseg;
+      xseg = SEGX(s,p);
+      for (m=0; m<Ncons; m++) x[m] += xseg[m]*vseg;
+      vout -= vseg;
+      if (vout >= 0.0 && vseg >= s->v[p])
+      {
+         if (s->n > 1)
+         {
+            s->first = SEG(s,1);
+            s->n--;
+         }
+      }
+      else s->v[p] -= vseg;
+   }
+   if (vsum > 0.0)
+   {
+      for (m=0; m<Ncons; m++) x[m] /= vsum;
+   }
+   else memcpy(x,SEGX(s,s->first),Ncons*sizeof(double));
+
+   /* Add new last segment for new flow entering tank */
+   if (vin > 0.0)
+   {
+      xin = inflowcons(n);
+      p = SEG(s,s->n-1);
+      if (samecons(SEGX(s,p),xin))
+      {
+         mixcons(SEGX(s,p),s->v[p],xin,vin);
+         s->v[p] += vin;
+      }
+      else addsegx(k,vin,xin);
+   }
+}
+
+
+void  lifocons(int i, long dt)
+/*
+**----------------------------------------------------------
+**   Input:   i = tank index
+**            dt = current WQ time step
+**   Output:  none
+**   Purpose: updates the extra constituents of the segments
+**            of LIFO tank i as tankmix4() does its quality
+**----------------------------------------------------------
+*/
+{
+   int   j,k,m,n,p;
+   double vin,vnet,vseg,vsum;
+   double *x, *xin, *xseg;
+   Pseglist s;
+
+   k = Nlinks + i;
+   s = &Segx[k];
+   if (s->n == 0) return;
+   if (Ageflag)
+   {
+      for (j=0; j<s->n; j++) reactcons(SEGX(s,SEG(s,j)),dt);
+   }
+
+   /* Find inflows & outflows */
+   n = Tank[i].Node;
+   vnet = D[n]*dt;
+   vin = VolIn[n];
+   x = XCONS(Cx,n);
+   p = SEG(s,s->n-1);
+   memcpy(x,SEGX(s,p),Ncons*sizeof(double));
+
+   /* If tank filling, then add inflow to top of stack */
+   if (vnet > 0.0)
+   {
+      xin = inflowcons(n);
+      if (samecons(SEGX(s,p),xin))
+      {
+         mixcons(SEGX(s,p),s->v[p],xin,vnet);
+         s->v[p] += vnet;
+      }
+      else addsegx(k,vnet,xin);
+      memcpy(x,SEGX(s,SEG(s,s->n-1)),Ncons*sizeof(double));
+   }
+
+   /* If net emptying then remove last segments until vnet consumed */
+   else if (vnet < 0.0)
+   {
+      vsum = 0.0;
+      for (m=0; m<Ncons; m++) x[m] = 0.0;
+      vnet = -vnet;
+      while (vnet > 0.0)
+      {
+         p = SEG(s,s->n-1);
+         vseg = s->v[p];
+         vseg = MIN(vseg,vnet);
+         if (s->n == 1) vseg = vnet;
+         vsum += vseg;
+         xseg = SEGX(s,p);
+         for (m=0; m<Ncons; m++) x[m] += xseg[m]*vseg;
+         vnet -= vseg;
+         if (vnet >= 0.0 && vseg >= s->v[p])
+         {
+            if (s->n > 1) s->n--;
+         }
+         else s->v[p] -= vseg;
+      }
+
+      /* Reported values are mixture of flow released and any inflow */
+      xin = XCONS(MassInx,n);
+      for (m=0; m<Ncons; m++) x[m] = (x[m] + xin[m])/(vsum + vin);
+   }
 }         
 
 
@@ -1412,21 +2715,135 @@ double  avgqual(int k)
 {
    double  vsum = 0.0,
           msum = 0.0;
-   Pseg   seg;
+   Pseglist s;
+   int     i, p;
 
    if (Qualflag == NONE) return(0.);
-   seg = FirstSeg[k];
-   while (seg != NULL)
+   s = &Seg[k];
+   for (i=0; i<s->n; i++)
    {
-       vsum += seg->v;
-       msum += (seg->c)*(seg->v);
-       seg = seg->prev;
+       p = SEG(s,i);
+       vsum += s->v[p];
+       msum += s->c[p]*s->v[p];
    }
    if (vsum > 0.0) return(msum/vsum);
    else return( (C[Link[k].N1] + C[Link[k].N2])/2. );
 }
 
 
+double  avgcons(int k, int m)
+/*
+**--------------------------------------------------------------
+**   Input:   k = link index
+**            m = extra constituent index
+**   Output:  returns value of constituent
+**   Purpose: computes average value of extra constituent m in
+**            link k
+**--------------------------------------------------------------
+*/
+{
+   double  vsum = 0.0,
+          msum = 0.0;
+   Pseglist s;
+   int     i, p;
+
+   if (Qualflag == NONE) return(0.);
+   s = &Segx[k];
+   for (i=0; i<s->n; i++)
+   {
+       p = SEG(s,i);
+       vsum += s->v[p];
+       msum += SEGX(s,p)[m-1]*s->v[p];
+   }
+   if (vsum > 0.0) return(msum/vsum);
+   else return( (XCONS(Cx,Link[k].N1)[m-1] + XCONS(Cx,Link[k].N2)[m-1])/2. );
+}
+
+
+double  *inflowcons(int n)
+/*
+**--------------------------------------------------------------
+**   Input:   n = node index
+**   Output:  returns extra constituents of inflow to node n
+**   Purpose: mixes the extra constituents accumulated at node n
+**            (in the Xx[] work array, which is only used at
+**            junctions otherwise)
+**--------------------------------------------------------------
+*/
+{
+   int    m;
+   double *x = XCONS(Xx,n),
+          *xin = XCONS(MassInx,n);
+
+   for (m=0; m<Ncons; m++)
+   {
+      if (VolIn[n] > 0.0) x[m] = xin[m]/VolIn[n];
+      else                x[m] = 0.0;
+   }
+   return(x);
+}
+
+
+int  samecons(double *x, double *y)
+/*
+**--------------------------------------------------------------
+**   Input:   x, y = two sets of extra constituents
+**   Output:  returns 1 if they all differ by less than XTOL,
+**            0 otherwise
+**   Purpose: checks if two volumes of water can share an extra
+**            constituent segment
+**--------------------------------------------------------------
+*/
+{
+   int m;
+
+   for (m=0; m<Ncons; m++)
+   {
+      if (ABS(x[m] - y[m]) >= XTOL) return(0);
+   }
+   return(1);
+}
+
+
+void  mixcons(double *x, double vx, double *y, double vy)
+/*
+**--------------------------------------------------------------
+**   Input:   x  = extra constituents of a volume of water
+**            vx = its volume
+**            y  = extra constituents of another volume
+**            vy = its volume
+**   Output:  none
+**   Purpose: replaces x with the mixture of the two volumes
+**--------------------------------------------------------------
+*/
+{
+   int m;
+
+   if (vx + vy <= 0.0) return;
+   for (m=0; m<Ncons; m++) x[m] = (x[m]*vx + y[m]*vy) / (vx + vy);
+}
+
+
+void  reactcons(double *x, long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   x  = extra constituents of a volume of water
+**            dt = time step
+**   Output:  none
+**   Purpose: updates any water age constituents over time dt
+**            (traced flow is conservative)
+**--------------------------------------------------------------
+*/
+{
+   int m;
+
+   for (m=0; m<Ncons; m++)
+   {
+      if (Cons[m+1].Type == AGE) x[m] += (double)dt/3600.0;
+   }
+}
+
+
 void  ratecoeffs()
 /*
 **--------------------------------------------------------------
@@ -1506,14 +2923,15 @@ double piperate(int k)
 }                         /* End of piperate */
 
 
-double  pipereact(int k, double c, double v, long dt)
+double  pipereact(int k, double c, double v, long dt, double *w)
 /*
 **------------------------------------------------------------
 **   Input:   k = link index
 **            c = current WQ in segment
 **            v = segment volume
 **            dt = time step
-**   Output:  returns new WQ value
+**            w = mass reacted in bulk flow & at pipe wall
+**   Output:  returns new WQ value & adds mass reacted to w
 **   Purpose: computes new quality in a pipe segment after
 **            reaction occurs              
 **------------------------------------------------------------
@@ -1535,8 +2953,8 @@ double  pipereact(int k, double c, double v, long dt)
    /* Update cumulative mass reacted */
    if (Htime >= Rstart)
    {
-      Wbulk += ABS(dcbulk)*v;
-      Wwall += ABS(dcwall)*v;
+      w[0] += ABS(dcbulk)*v;
+      w[1] += ABS(dcwall)*v;
    }
 
    /* Update concentration */
@@ -54,6 +54,11 @@ extern char *StatTxt[];
 extern char *TstatTxt[];
 extern char *LogoTxt[];
 extern char *RptFormTxt[];
+extern char *RptOrderTxt[];
+extern char *RptSolverTxt[];
+extern char *RptPrecTxt[];
+extern char *RptPredTxt[];
+extern char *RptRouteTxt[];
 
 typedef   REAL4 *Pfloat;
 void      writenodetable(Pfloat *);
@@ -212,6 +217,41 @@ void  writesummary()
    writeline(s);                                                               //(2.00.12 - LR)
    sprintf(s,FMT27c,DampLimit);                                                //(2.00.12 - LR)
    writeline(s);                                                               //(2.00.12 - LR)
+   if (Ordering != MINDEG)
+   {
+      sprintf(s,FMT27d,RptOrderTxt[(int)Ordering]);
+      writeline(s);
+   }
+   if (Threads > 1)
+   {
+      sprintf(s,FMT27e,Threads);
+      writeline(s);
+   }
+   if (Solver != CHOLESKY)
+   {
+      sprintf(s,FMT27f,RptSolverTxt[(int)Solver]);
+      writeline(s);
+   }
+   if (UpdateLimit > 0.0)
+   {
+      sprintf(s,FMT27g,UpdateLimit);
+      writeline(s);
+   }
+   if (Precision != DOUBLEPREC)
+   {
+      sprintf(s,FMT27h,RptPrecTxt[(int)Precision]);
+      writeline(s);
+   }
+   if (Predictor != NOPRED)
+   {
+      sprintf(s,FMT27i,RptPredTxt[(int)Predictor]);
+      writeline(s);
+   }
+   if (CacheTol > 0.0)
+   {
+      sprintf(s,FMT27j,CacheTol*Ucf[HEAD],Field[HEAD].Units);
+      writeline(s);
+   }
 
    sprintf(s,FMT28,MaxIter);
    writeline(s);
@@ -226,10 +266,21 @@ void  writesummary()
    writeline(s);
    if (Qualflag != NONE && Dur > 0)
    {
+      for (i=1; i<=Ncons; i++)
+      {
+         if (Cons[i].Type == TRACE) sprintf(s,FMT32a,Node[Cons[i].Node].ID);
+         else                       sprintf(s,FMT32b);
+         writeline(s);
+      }
       sprintf(s,FMT33,(float)Qstep/60.0);
       writeline(s);
       sprintf(s,FMT34,Ctol*Ucf[QUALITY],Field[QUALITY].Units);
       writeline(s);
+      if (Routing != STDROUTE)
+      {
+         sprintf(s,FMT35,RptRouteTxt[(int)Routing]);
+         writeline(s);
+      }
    }
    sprintf(s,FMT36,SpGrav);
    writeline(s);
@@ -733,6 +784,11 @@ void  writerelerr(int iter, double relerr)
 {
    if (iter == 0)
    {
+      if (Htime == 0)
+      {
+         sprintf(Msg, FMT66, clocktime(Atime,Htime), Ncoeffs);
+         writeline(Msg);
+      }
       sprintf(Msg, FMT64, clocktime(Atime,Htime));
       writeline(Msg);
    }
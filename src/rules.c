@@ -18,12 +18,15 @@ AUTHOR:     L. Rossman
      allocrules() -- called from allocdata() in EPANET.C
      ruledata()   -- called from newline() in INPUT2.C
      freerules()  -- called from freedata() in EPANET.C
+     compilerules() -- called from openhyd() in HYDRAUL.C
      checkrules() -- called from ruletimestep() in HYDRAUL.C
+     nextrulecheck() -- called from ruletimestep() in HYDRAUL.C
 
 **********************************************************************
 */
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #ifndef __APPLE__
 #include <malloc.h>
 #else
@@ -66,15 +69,43 @@ struct      aRule           /* Control Rule Structure */
    struct   aRule    *next;
 };
 
-struct      ActItem         /* Action list item */
+struct      Pcode           /* Compiled Premise Clause */
 {
-   int      ruleindex;        /* Index of rule action belongs to */
-   struct   Action   *action; /* An action structure */
-   struct   ActItem  *next;     
+   char     op;             /* Type of test made */
+   char     logop;          /* Logical operator */
+   char     relop;          /* Relational operator */
+   char     status;         /* Status tested for */
+   int      tank;           /* Tank whose level sets variable */
+   double   *x;             /* Variable's value */
+   double   *base;          /* Elevation subtracted from value */
+   char     *s;             /* Link's status */
+   double   ucf;            /* Units conversion factor */
+   double   value;          /* Value tested against */
+};
+
+struct      Acode           /* Compiled Action Clause */
+{
+   int      link;           /* Link index */
+   int      status;         /* Link's status */
+   double   setting;        /* Link's setting (internal units) */
+};
+
+struct      Rcode           /* Compiled Rule */
+{
+   int      p1, p2;         /* Premises p1 to p2-1 */
+   int      a1, a2, a3;     /* Actions a1 to a2-1 if true, a2 to a3-1 if false */
+   char     timed;          /* Premises change between hydraulic solutions */
+   char     result;         /* Premises' value when last checked */
 };
 
 struct  aRule *Rule;        /* Array of rules */
-struct  ActItem *ActList;   /* Linked list of action items */
+struct  Rcode *Rcodes;      /* Array of compiled rules */
+struct  Pcode *Pcodes;      /* Compiled premises of all rules */
+struct  Acode *Acodes;      /* Compiled actions of all rules */
+struct  Acode **Actlist;    /* List of actions to take */
+int     *Actrule;           /* Rule of each action on list */
+int     *Actslot;           /* Position+1 of each link's action on list */
+int     Nactions;           /* Number of actions on list */
 int     RuleState;          /* State of rule interpreter */
 long    Time1;              /* Start of rule evaluation time interval (sec) */
 struct  Premise *Plast;     /* Previous premise clause */
@@ -101,6 +132,10 @@ char    *Operator[]  = {"=","<>","<=",">=","<",">",w_IS,w_NOT,w_BELOW,w_ABOVE,NU
 enum    Values         {IS_NUMBER,IS_OPEN,IS_CLOSED,IS_ACTIVE};
 char    *Value[]     = {"XXXX",   w_OPEN, w_CLOSED, w_ACTIVE,NULL};
 
+/* Types of test made by compiled premises (time-varying ones last) */
+enum    Opcodes        {c_FALSE, c_VALUE, c_LEVEL, c_FLOW, c_SETTING,
+                        c_STATUS, c_TIME, c_CLOCK, c_FILL, c_DRAIN};
+
 /* External variables declared in INPUT2.C */
 extern char      *Tok[MAXTOKS];
 extern int       Ntokens;
@@ -114,13 +149,16 @@ void    newrule(void);
 int     newpremise(int);
 int     newaction(void);
 int     newpriority(void);
+void    compilepremise(struct Premise *, struct Pcode *);
+void    compileaction(struct Action *, struct Acode *);
+void    freecode(void);
 int     evalpremises(int);
-void    updateactlist(int, struct Action *);
-int     checkaction(int, struct Action *);
-int     checkpremise(struct Premise *);
-int     checktime(struct Premise *);
-int     checkstatus(struct Premise *);
-int     checkvalue(struct Premise *);
+void    updateactlist(int, int, int);
+int     checkpremise(struct Pcode *);
+int     checktime(struct Pcode *);
+double  premisetime(struct Pcode *, long);
+double  nextclock(long);
+double  leveltime(struct Pcode *, double, long);
 int     takeactions(void);
 void    clearactlist(void);
 void    clearrules(void);
@@ -137,6 +175,12 @@ void initrules()
 {
    RuleState = r_PRIORITY;
    Rule = NULL;
+   Rcodes = NULL;
+   Pcodes = NULL;
+   Acodes = NULL;
+   Actlist = NULL;
+   Actrule = NULL;
+   Actslot = NULL;
 }
 
 
@@ -176,40 +220,46 @@ void freerules()
 {
    clearrules();
    free(Rule);
+   freecode();
 }
 
 
-int checkrules(long dt)
+int checkrules(long dt, int all)
 /*
 **-----------------------------------------------------
 **    Checks which rules should fire at current time.
 **    Called by ruletimestep() in HYDRAUL.C.
+**
+**    If all is FALSE, the hydraulic solution hasn't
+**    changed since the last check, so only rules with
+**    premises on time or tank levels are re-evaluated.
 **-----------------------------------------------------
 */
 {
    int i,
        r;    /* Number of actions actually taken */
+   struct Rcode *rc;
 
    /* Start of rule evaluation time interval */
    Time1 = Htime - dt + 1;
 
    /* Iterate through each rule */
-   ActList = NULL;
+   Nactions = 0;
    r = 0;
    for (i=1; i<=Nrules; i++)
    {
+      rc = &Rcodes[i];
+      if (all || rc->timed) rc->result = (char)evalpremises(i);
+
       /* If premises true, add THEN clauses to action list. */
-      if (evalpremises(i) == TRUE) updateactlist(i,Rule[i].Tchain);
+      if (rc->result == TRUE) updateactlist(i, rc->a1, rc->a2);
 
       /* If premises false, add ELSE actions to list. */
-      else
-      {
-          if (Rule[i].Fchain != NULL) updateactlist(i,Rule[i].Fchain);
-      }
+      else updateactlist(i, rc->a2, rc->a3);
    }
 
    /* Execute actions then clear list. */
-   if (ActList != NULL) r = takeactions();
+   if (Nactions > 0) r = takeactions();
    clearactlist();
    return(r);
 }
@@ -298,19 +348,13 @@ int  ruledata()
 void  clearactlist()
 /*
 **----------------------------------------------------------
-**    Clears memory used for action list
+**    Clears action list
 **----------------------------------------------------------
 */
 {
-   struct ActItem *a;
-   struct ActItem *anext;
-   a = ActList;
-   while (a != NULL)
-   {
-      anext = a->next;
-      free(a);
-      a = anext;
-   }
+   int m;
+   for (m=0; m<Nactions; m++) Actslot[Actlist[m]->link] = 0;
+   Nactions = 0;
 }
 
 
@@ -587,6 +631,363 @@ int  newpriority()
 }
 
 
+int  compilerules()
+/*
+**-----------------------------------------------------------
+**    Compiles the rules' premise & action chains into
+**    arrays for faster evaluation.
+**    Called by openhyd() in HYDRAUL.C.
+**
+**    Each premise is reduced to the type of test it makes,
+**    pointers to the network variable it tests (e.g. into
+**    H[] or Q[]) and its units conversion factor, so that
+**    checking it involves no searches or unit lookups.
+**    Actions store their settings in internal units.
+**-----------------------------------------------------------
+*/
+{
+   int    i, j, k, np, na;
+   struct Premise *p;
+   struct Action  *a;
+   struct Rcode   *r;
+
+   /* Count premises & actions of all rules */
+   freecode();
+   if (Nrules == 0) return(0);
+   np = 0;
+   na = 0;
+   for (i=1; i<=Nrules; i++)
+   {
+      for (p = Rule[i].Pchain; p != NULL; p = p->next) np++;
+      for (a = Rule[i].Tchain; a != NULL; a = a->next) na++;
+      for (a = Rule[i].Fchain; a != NULL; a = a->next) na++;
+   }
+
+   /* Allocate arrays */
+   Rcodes  = (struct Rcode *) calloc(Nrules+1, sizeof(struct Rcode));
+   Pcodes  = (struct Pcode *) calloc(np+1, sizeof(struct Pcode));
+   Acodes  = (struct Acode *) calloc(na+1, sizeof(struct Acode));
+   Actlist = (struct Acode **) calloc(na+1, sizeof(struct Acode *));
+   Actrule = (int *) calloc(na+1, sizeof(int));
+   Actslot = (int *) calloc(Nlinks+1, sizeof(int));
+   if (Rcodes == NULL || Pcodes == NULL || Acodes == NULL ||
+       Actlist == NULL || Actrule == NULL || Actslot == NULL) return(101);
+
+   /* Compile each rule's premises, THEN actions & ELSE actions */
+   j = 0;
+   k = 0;
+   for (i=1; i<=Nrules; i++)
+   {
+      r = &Rcodes[i];
+      r->p1 = j;
+      for (p = Rule[i].Pchain; p != NULL; p = p->next)
+      {
+         compilepremise(p, &Pcodes[j]);
+         if (Pcodes[j].op >= c_TIME || Pcodes[j].tank > 0) r->timed = TRUE;
+         j++;
+      }
+      r->p2 = j;
+      r->a1 = k;
+      for (a = Rule[i].Tchain; a != NULL; a = a->next) compileaction(a, &Acodes[k++]);
+      r->a2 = k;
+      for (a = Rule[i].Fchain; a != NULL; a = a->next) compileaction(a, &Acodes[k++]);
+      r->a3 = k;
+   }
+   Nactions = 0;
+   return(0);
+}
+
+
+void  compilepremise(struct Premise *p, struct Pcode *c)
+/*
+**-----------------------------------------------------------
+**    Compiles premise p into c
+**-----------------------------------------------------------
+*/
+{
+   int i, j;
+
+   i = p->index;
+   c->logop = (char)p->logop;
+   c->relop = (char)p->relop;
+   c->status = (char)p->status;
+   c->value = p->value;
+   c->op = c_FALSE;
+   c->tank = 0;
+   c->x = NULL;
+   c->base = NULL;
+   c->s = NULL;
+   c->ucf = 1.0;
+
+   /* Tank (not reservoir) whose level a node variable follows */
+   j = 0;
+   if (p->object == r_NODE && i > Njuncs && Tank[i-Njuncs].A != 0.0)
+      j = i - Njuncs;
+
+   /* Same order of tests as the premise types were checked in */
+   if (p->variable == r_TIME)         c->op = c_TIME;
+   else if (p->variable == r_CLOCKTIME) c->op = c_CLOCK;
+   else if (p->status > IS_NUMBER)
+   {
+      c->op = c_STATUS;
+      c->s = &S[i];
+   }
+   else switch (p->variable)
+   {
+      case r_DEMAND:   c->op = c_VALUE;
+                       if (p->object == r_SYSTEM) c->x = &Dsystem;
+                       else c->x = &D[i];
+                       c->ucf = Ucf[DEMAND];
+                       break;
+      case r_HEAD:
+      case r_GRADE:    c->op = c_VALUE;
+                       c->x = &H[i];
+                       c->ucf = Ucf[HEAD];
+                       c->tank = j;
+                       break;
+      case r_PRESSURE: c->op = c_LEVEL;
+                       c->x = &H[i];
+                       c->base = &Node[i].El;
+                       c->ucf = Ucf[PRESSURE];
+                       c->tank = j;
+                       break;
+      case r_LEVEL:    c->op = c_LEVEL;
+                       c->x = &H[i];
+                       c->base = &Node[i].El;
+                       c->ucf = Ucf[HEAD];
+                       c->tank = j;
+                       break;
+      case r_FLOW:     c->op = c_FLOW;
+                       c->x = &Q[i];
+                       c->ucf = Ucf[FLOW];
+                       break;
+      case r_SETTING:  c->op = c_SETTING;
+                       c->x = &K[i];
+                       switch (Link[i].Type)
+                       {
+                          case PRV:
+                          case PSV:
+                          case PBV:  c->ucf = Ucf[PRESSURE]; break;
+                          case FCV:  c->ucf = Ucf[FLOW];     break;
+                       }
+                       break;
+      case r_FILLTIME:
+      case r_DRAINTIME: if (j == 0) break;
+                       if (p->variable == r_FILLTIME) c->op = c_FILL;
+                       else c->op = c_DRAIN;
+                       c->x = &D[i];
+                       c->tank = j;
+                       break;
+   }
+}
+
+
+void  compileaction(struct Action *a, struct Acode *c)
+/*
+**-----------------------------------------------------------
+**    Compiles action a into c
+**-----------------------------------------------------------
+*/
+{
+   int k;
+   double x;
+
+   k = a->link;
+   x = a->setting;
+   if (x != MISSING) switch(Link[k].Type)
+   {
+      case PRV:
+      case PSV:
+      case PBV:    x = x/Ucf[PRESSURE];  break;
+      case FCV:    x = x/Ucf[FLOW];      break;
+   }
+   c->link = k;
+   c->status = a->status;
+   c->setting = x;
+}
+
+
+void  freecode()
+/*
+**-----------------------------------------------------------
+**    Frees memory used for compiled rules
+**-----------------------------------------------------------
+*/
+{
+   FREE(Rcodes);
+   FREE(Pcodes);
+   FREE(Acodes);
+   FREE(Actlist);
+   FREE(Actrule);
+   FREE(Actslot);
+   Rcodes = NULL;
+   Pcodes = NULL;
+   Acodes = NULL;
+   Actlist = NULL;
+   Actrule = NULL;
+   Actslot = NULL;
+   Nactions = 0;
+}
+
+
+long  nextrulecheck(long dt, long tmax)
+/*
+**-----------------------------------------------------------
+**    Input:   dt   = rule evaluation time step (sec)
+**             tmax = end of current hydraulic time step
+**    Output:  returns time when rules must next be checked
+**             (a time past tmax if not before then)
+**    Purpose: finds the earliest time at which any rule
+**             premise might change from true to false or
+**             false to true, after checkrules() found that
+**             no rules fire at the current time.
+**
+**    Called by ruletimestep() in HYDRAUL.C. Between
+**    hydraulic solutions only the time and tank levels
+**    change. Premises on time are predicted exactly and
+**    those on the level of a cylindrical tank from its
+**    current inflow. Until the returned time no premise
+**    changes, so the rules still won't fire and need not
+**    be checked. Premises that can't be predicted (on
+**    tanks with volume curves, fill & drain times) make
+**    the rules be checked at each time step.
+**-----------------------------------------------------------
+*/
+{
+   int    i, j;
+   double t, tnext;
+
+   tnext = tmax + 1;
+   for (i=1; i<=Nrules; i++)
+   {
+      if (!Rcodes[i].timed) continue;
+      for (j = Rcodes[i].p1; j < Rcodes[i].p2; j++)
+      {
+         t = premisetime(&Pcodes[j], dt);
+         if (t < tnext) tnext = t;
+         if (tnext <= Htime + 1) return(Htime + 1);
+      }
+   }
+   return((long)tnext);
+}
+
+
+double  premisetime(struct Pcode *c, long dt)
+/*
+**-----------------------------------------------------------
+**    Returns earliest time at which premise c might change
+**    (a very large value if it can't change)
+**-----------------------------------------------------------
+*/
+{
+   long   x;
+   double t, tol = 1.e-3;
+
+   switch (c->op)
+   {
+      /* Premises on system time */
+      case c_TIME:
+         x = (long)(c->value);
+         if (c->relop == EQ || c->relop == NE)
+         {
+            if (checktime(c)) return(Htime + 1);
+            if (x > Htime) return(x);
+            return(HUGE_VAL);
+         }
+         if (c->relop == LE || c->relop == GT) x++;
+         if (x > Htime) return(x);
+         return(HUGE_VAL);
+
+      /* Premises on clock time, which may also */
+      /* change when the clock passes midnight  */
+      case c_CLOCK:
+         x = (long)(c->value);
+         if (c->relop == EQ || c->relop == NE)
+         {
+            if (checktime(c)) return(Htime + 1);
+            return(nextclock(x));
+         }
+         if (c->relop == LE || c->relop == GT) x++;
+         return(MIN(nextclock(x), nextclock(0)));
+
+      /* Premises on tank levels */
+      case c_VALUE:
+      case c_LEVEL:
+         if (c->tank == 0) return(HUGE_VAL);
+         if (Tank[c->tank].Vcurve > 0) return(Htime + 1);
+         t = HUGE_VAL;
+         if (c->relop == EQ || c->relop == NE ||
+             c->relop == LE || c->relop == GT)
+            t = leveltime(c, c->value - tol, dt);
+         if (c->relop == EQ || c->relop == NE ||
+             c->relop == LT || c->relop == GE)
+            t = MIN(t, leveltime(c, c->value + tol, dt));
+         return(t);
+
+      /* Fill & drain times */
+      case c_FILL:
+      case c_DRAIN:
+         return(Htime + 1);
+
+      /* Premises on all other variables (flows, demands, */
+      /* link status & settings) */
+      default:
+         return(HUGE_VAL);
+   }
+}
+
+
+double  nextclock(long x)
+/*
+**-----------------------------------------------------------
+**    Returns next time after the current time that the
+**    clock shows time of day x
+**-----------------------------------------------------------
+*/
+{
+   long t;
+   t = (x - (Htime + Tstart)) % SECperDAY;
+   if (t <= 0) t += SECperDAY;
+   return(Htime + t);
+}
+
+
+double  leveltime(struct Pcode *c, double x, long dt)
+/*
+**-----------------------------------------------------------
+**    Returns earliest time at which the tank in premise c
+**    might reach a value x of the premise's variable
+**
+**    The time is that needed to fill or drain the tank to
+**    the level at its current inflow, less a margin of one
+**    rule time step plus 2 sec (for roundoff and for the
+**    rounding of tank volumes to full or empty in
+**    tanklevels()). If the level was passed within the
+**    margin, the premise is checked at the next step.
+**-----------------------------------------------------------
+*/
+{
+   int    j;
+   double h, q, t, v, margin;
+
+   j = c->tank;
+   q = D[Tank[j].Node];
+   if (q == 0.0) return(HUGE_VAL);
+
+   /* Head at which premise's variable equals x */
+   h = x/c->ucf;
+   if (c->op == c_LEVEL) h = *(c->base) + h;
+
+   /* Time to reach that head */
+   v = Tank[j].Vmin + (h - Tank[j].Hmin)*Tank[j].A;
+   t = (v - Tank[j].V)/q;
+   margin = dt + 2.0;
+   if (t < -margin) return(HUGE_VAL);
+   if (t < margin) return(Htime + 1);
+   return(Htime + floor(t - margin));
+}
+
+
 int  evalpremises(int i)
 /*
 **----------------------------------------------------------
@@ -594,48 +995,89 @@ int  evalpremises(int i)
 **----------------------------------------------------------
 */
 {
-    int result;
-    struct Premise *p;
+    int j, result;
+    struct Pcode *c;
 
     result = TRUE;
-    p = Rule[i].Pchain;
-    while (p != NULL)
+    for (j = Rcodes[i].p1; j < Rcodes[i].p2; j++)
     {
-        if (p->logop == r_OR)
+        c = &Pcodes[j];
+        if (c->logop == r_OR)
         {
             if (result == FALSE)
             {
-                result = checkpremise(p);
+                result = checkpremise(c);
             }
         }
         else
         {
             if (result == FALSE) return(FALSE);
-            result = checkpremise(p);
+            result = checkpremise(c);
         }
-        p = p->next;
     }
     return(result);
 }
 
  
-int  checkpremise(struct Premise *p)
+int  checkpremise(struct Pcode *c)
 /*
 **----------------------------------------------------------
-**    Checks if a particular premise is true
+**    Checks if a particular premise is true.
+**    Uses tolerance of 0.001 when testing values.
 **----------------------------------------------------------
 */
 {
-    if (p->variable == r_TIME || p->variable == r_CLOCKTIME)
-       return(checktime(p));
-    else if (p->status > IS_NUMBER)
-       return(checkstatus(p));
-    else
-       return(checkvalue(p));
+    int   j;
+    char  s;
+    double x,
+          tol = 1.e-3;
+
+    switch (c->op)
+    {
+        case c_TIME:
+        case c_CLOCK:   return(checktime(c));
+
+        case c_STATUS:  s = *(c->s);
+                        if      (s <= CLOSED) j = IS_CLOSED;
+                        else if (s == ACTIVE) j = IS_ACTIVE;
+                        else                  j = IS_OPEN;
+                        if (c->relop == EQ) return(j == c->status);
+                        if (c->relop == NE) return(j != c->status);
+                        return(0);
+
+        case c_VALUE:   x = *(c->x)*c->ucf;
+                        break;
+        case c_LEVEL:   x = (*(c->x) - *(c->base))*c->ucf;
+                        break;
+        case c_FLOW:    x = ABS(*(c->x))*c->ucf;
+                        break;
+        case c_SETTING: if (*(c->x) == MISSING) return(0);
+                        x = *(c->x)*c->ucf;
+                        break;
+        case c_FILL:    if (*(c->x) <= TINY) return(0);
+                        x = (Tank[c->tank].Vmax - Tank[c->tank].V)/(*(c->x));
+                        break;
+        case c_DRAIN:   if (*(c->x) >= -TINY) return(0);
+                        x = (Tank[c->tank].Vmin - Tank[c->tank].V)/(*(c->x));
+                        break;
+        default:        return(0);
+    }
+    switch (c->relop)
+    {
+        case EQ:        if (ABS(x - c->value) > tol) return(0);
+                        break;
+        case NE:        if (ABS(x - c->value) < tol) return(0);
+                        break;
+        case LT:        if (x > c->value + tol) return(0); break;
+        case LE:        if (x > c->value - tol) return(0); break;
+        case GT:        if (x < c->value - tol) return(0); break;
+        case GE:        if (x < c->value + tol) return(0); break;
+    }
+    return(1);
 }
 
 
-int  checktime(struct Premise *p)
+int  checktime(struct Pcode *c)
 /*
 **------------------------------------------------------------
 **    Checks if condition on system time holds
@@ -646,21 +1088,20 @@ int  checktime(struct Premise *p)
    long  t1,t2,x;
 
    /* Get start and end of rule evaluation time interval */ 
-   if (p->variable == r_TIME)
+   if (c->op == c_TIME)
    {
         t1 = Time1;
         t2 = Htime;
    }
-   else if (p->variable == r_CLOCKTIME)
+   else
    {
         t1 = (Time1 + Tstart) % SECperDAY;
         t2 = (Htime + Tstart) % SECperDAY;
    }
-   else return(0);
 
    /* Test premise's time */
-   x = (long)(p->value);
-   switch (p->relop)
+   x = (long)(c->value);
+   switch (c->relop)
    {
       /* For inequality, test against current time */
         case LT: if (t2 >= x) return(0); break;
@@ -680,8 +1121,8 @@ int  checktime(struct Premise *p)
            {
               if (x >= t1 && x <= t2) flag = TRUE;
            }
-           if (p->relop == EQ && flag == FALSE) return(0);
-           if (p->relop == NE && flag == TRUE)  return(0);
+           if (c->relop == EQ && flag == FALSE) return(0);
+           if (c->relop == NE && flag == TRUE)  return(0);
            break;
    }
 
@@ -690,167 +1131,42 @@ int  checktime(struct Premise *p)
 }
 
 
-int  checkstatus(struct Premise *p)
-/*
-**------------------------------------------------------------
-**    Checks if condition on link status holds
-**------------------------------------------------------------
-*/
-{
-    char i;
-    int  j;
-    switch (p->status)
-    {
-        case IS_OPEN:
-        case IS_CLOSED:
-        case IS_ACTIVE:
-                i = S[p->index];
-                if      (i <= CLOSED) j = IS_CLOSED;
-                else if (i == ACTIVE) j = IS_ACTIVE;
-                else                  j = IS_OPEN;
-                if (j == p->status &&
-                p->relop == EQ)     return(1);
-                if (j != p->status &&
-                p->relop == NE) return(1);
-    }
-    return(0);
-}
-
-
-int  checkvalue(struct Premise *p)
-/*
-**----------------------------------------------------------
-**    Checks if numerical condition on a variable is true.
-**    Uses tolerance of 0.001 when testing conditions.
-**----------------------------------------------------------
-*/
-{
-    int   i,j,v;
-    double x,
-          tol = 1.e-3;
-
-    i = p->index;
-    v = p->variable;
-    switch (v)
-    {
-
-/*** Updated 10/25/00 ***/
-        case r_DEMAND:    if (p->object == r_SYSTEM) x = Dsystem*Ucf[DEMAND];
-                          else x = D[i]*Ucf[DEMAND];
-                          break;
-
-        case r_HEAD:
-        case r_GRADE:     x = H[i]*Ucf[HEAD];
-                          break;
-        case r_PRESSURE:  x = (H[i]-Node[i].El)*Ucf[PRESSURE];
-                          break;
-        case r_LEVEL:     x = (H[i]-Node[i].El)*Ucf[HEAD];
-                          break;
-        case r_FLOW:      x = ABS(Q[i])*Ucf[FLOW];
-                          break;
-        case r_SETTING:   if (K[i] == MISSING) return(0);
-                          x = K[i];
-                          switch (Link[i].Type)
-                          {
-                             case PRV:
-                             case PSV:
-                             case PBV:  x = x*Ucf[PRESSURE]; break;
-                             case FCV:  x = x*Ucf[FLOW];     break;
-                          }
-                          break;
-        case r_FILLTIME:  if (i <= Njuncs) return(0);
-                          j = i-Njuncs;
-                          if (Tank[j].A == 0.0) return(0);
-                          if (D[i] <= TINY) return(0);
-                          x = (Tank[j].Vmax - Tank[j].V)/D[i];
-                          break;
-        case r_DRAINTIME: if (i <= Njuncs) return(0);
-                          j = i-Njuncs;
-                          if (Tank[j].A == 0.0) return(0);
-                          if (D[i] >= -TINY) return(0);
-                          x = (Tank[j].Vmin - Tank[j].V)/D[i];
-                          break;
-        default:          return(0);
-    }
-    switch (p->relop)
-    {
-        case EQ:        if (ABS(x - p->value) > tol) return(0);
-                        break;
-        case NE:        if (ABS(x - p->value) < tol) return(0);
-                        break;
-        case LT:        if (x > p->value + tol) return(0); break;
-        case LE:        if (x > p->value - tol) return(0); break;
-        case GT:        if (x < p->value - tol) return(0); break;
-        case GE:        if (x < p->value + tol) return(0); break;
-    }
-    return(1);
-}
-
-
-void  updateactlist(int i, struct Action *actions)
+void  updateactlist(int i, int a1, int a2)
 /*
 **---------------------------------------------------
-**    Adds rule's actions to action list
+**    Adds rule i's actions a1 to a2-1 to action list
 **---------------------------------------------------
 */
 {
-   struct ActItem *item;
-   struct Action *a;
+   int k, m;
+   struct Acode *a;
 
-   /* Iterate through each action of Rule i */
-   a = actions;
-   while (a != NULL)
+   for (; a1 < a2; a1++)
    {
-      /* Add action to list if not already on it */
-      if (!checkaction(i,a))
+      a = &Acodes[a1];
+      k = a->link;
+
+      /* If link already on list then replace its */
+      /* action if rule has higher priority.      */
+      m = Actslot[k];
+      if (m > 0)
       {
-         item = (struct ActItem *) malloc(sizeof(struct ActItem));
-         if (item != NULL)
+         if (Rule[i].priority > Rule[Actrule[m-1]].priority)
          {
-            item->action = a;
-            item->ruleindex = i;
-            item->next = ActList;
-            ActList = item;
+            Actlist[m-1] = a;
+            Actrule[m-1] = i;
          }
       }
-      a = a->next;
-   }
-}
-
 
-int  checkaction(int i, struct Action *a)
-/*
-**-----------------------------------------------------------
-**    Checks if an action is already on the Action List
-**-----------------------------------------------------------
-*/
-{
-   int i1,k,k1;
-   struct ActItem *item;
-   struct Action *a1;
-
-   /* Search action list for link named in action */
-   k = a->link;                 /* Action applies to link k */
-   item = ActList;
-   while (item != NULL)
-   {
-      a1 = item->action;
-      i1 = item->ruleindex;
-      k1 = a1->link;
-
-      /* If link on list then replace action if rule has higher priority. */
-      if (k1 == k)
+      /* Otherwise add action to end of list */
+      else
       {
-         if (Rule[i].priority > Rule[i1].priority)
-         {
-            item->action = a;
-            item->ruleindex = i;
-         }
-         return(1);
+         Actlist[Nactions] = a;
+         Actrule[Nactions] = i;
+         Nactions++;
+         Actslot[k] = Nactions;
       }
-      item = item->next;
    }
-   return(0);
 }
 
 
@@ -861,19 +1177,19 @@ int  takeactions()
 **-----------------------------------------------------------
 */
 {
-    struct Action *a;
-    struct ActItem *item;
+    struct Acode *a;
     char   flag;
-    int    k, s, n;
+    int    k, m, s, n;
     double  tol = 1.e-3,
            v, x;
 
+    /* Actions are taken from the most recently added one */
+    /* back (the order of the original linked list) */
     n = 0;
-    item = ActList;
-    while (item != NULL)
+    for (m = Nactions-1; m >= 0; m--)
     {
         flag = FALSE;
-        a = item->action;
+        a = Actlist[m];
         k = a->link;
         s = S[k];
         v = K[k];
@@ -896,13 +1212,6 @@ int  takeactions()
         /* Change link's setting */
         else if (x != MISSING)
         {
-            switch(Link[k].Type)
-            {
-                case PRV:
-                case PSV:
-                case PBV:    x = x/Ucf[PRESSURE];  break;
-                case FCV:    x = x/Ucf[FLOW];      break;
-            }
             if (ABS(x-v) > tol)
             {
                 setlinksetting(k, x, &S[k], &K[k]);
@@ -914,11 +1223,8 @@ int  takeactions()
         if (flag == TRUE)
         {
            n++;
-           if (Statflag) writeruleaction(k,Rule[item->ruleindex].label);
+           if (Statflag) writeruleaction(k,Rule[Actrule[m]].label);
         }
-
-        /* Move to next action on list */
-        item = item->next;
     }
     return(n);
 }
@@ -14,18 +14,46 @@ module are:
    createsparse() -- called from openhyd() in HYDRAUL.C           
    freesparse()   -- called from closehyd() in HYDRAUL.C           
    linsolve()     -- called from netsolve() in HYDRAUL.C          
+   pcgsolve()     -- called from netsolve() in HYDRAUL.C          
+   updsolve()     -- called from netsolve() in HYDRAUL.C          
+   mixsolve()     -- called from netsolve() in HYDRAUL.C          
                                                                    
 Createsparse() does the following:                               
    1. for each node, builds an adjacency list that identifies    
       all links connected to the node (see buildlists())         
    2. re-orders the network's nodes to minimize the number       
       of non-zero entries in the hydraulic solution matrix       
-      (see reorder())                                            
+      (see reordernodes()), using either the original minimum    
+      degree search or an approximate minimum degree ordering    
+      on a quotient graph (see amdorder())                       
    3. converts the adjacency lists into a compact scheme         
       for storing the non-zero coeffs. in the lower diagonal     
-      portion of the solution matrix (see storesparse())         
+      portion of the solution matrix (see storesparse()) and     
+      points each link at the position of its coeff. in that     
+      scheme (see mapcoeffs())                                   
+   4. groups consecutive columns of the factorized matrix that   
+      share the same non-zero pattern into supernodes (see       
+      findsupernodes())                                          
+   5. finds the leading columns that belong to dead-end trees    
+      and series chains of junctions, which linsolve() can       
+      eliminate ahead of the rest (see findchains())             
+   6. splits the elimination tree of the supernodes into         
+      independent subtrees that can be factorized in parallel    
+      (see findtasks())                                          
+Steps 1 to 3 only depend on the network's topology and can be    
+skipped by loading their results from a file saved by an earlier 
+run on the same topology (see loadsparse() and savesparse()).    
 Freesparse() frees the memory used for the sparse matrix.        
 Linsolve() solves the linearized system of hydraulic equations.  
+Pcgsolve() solves the same system iteratively, without any fill- 
+ins, for networks too large to factorize directly. It is used    
+when the SOLVER option is PCG.                                   
+Updsolve() solves it by updating the Cholesky factor from the    
+previous trial for just the coeffs. that changed. It is used     
+when the UPDATE option is above 0.                               
+Mixsolve() solves it with a single precision Cholesky factor,    
+refining the solution against the double precision matrix. It is 
+used when the PRECISION option is MIXED.                         
 
 ********************************************************************
 */
@@ -38,6 +66,11 @@ Linsolve() solves the linearized system of hydraulic equations.
 #include <stdlib.h>
 #endif
 #include <math.h>
+#include <float.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "hash.h"
 #include "text.h"
 #include "types.h"
@@ -45,7 +78,47 @@ Linsolve() solves the linearized system of hydraulic equations.
 #define  EXTERN  extern
 #include "vars.h"
 
+#define  MAXTASKS  64  /* Target number of subtree tasks */
+#define  PCGTOL    0.01  /* PCG tolerance as a fraction of Hacc */
+#define  UPDCOST   4.0  /* Work of rank-one updates vs. factorizing */
+#define  DOWNLIMIT 0.5  /* Largest downdate as fraction of diagonal */
+#define  MAXREFINE 10   /* Max. refinement steps of mixsolve()  */
+
 int      *Degree;     /* Number of links adjacent to each node  */
+int      Nsuper = 0;  /* Number of supernodes                   */
+int      *Xsuper = NULL, /* First column of each supernode      */
+         *Super = NULL;  /* Supernode each column belongs to    */
+int      Npanel = 0;  /* Size of largest supernode panel        */
+int      Nchain = 0;  /* Leading columns eliminated as chains   */
+int      *Pfill = NULL;  /* Position of each chain column's fill*/
+int      Ntasks = 0;  /* Number of independent subtree tasks    */
+int      *Xtask = NULL,  /* Start of each task's list in Tsuper */
+         *Tsuper = NULL, /* Supernodes of each task in order    */
+         *Task = NULL,   /* Task each supernode belongs to      */
+         *Troot = NULL,  /* Last column of each task's subtree  */
+         *Terr = NULL;   /* Error code returned by each task    */
+int      Nwork = 0;   /* Size of linsolve() work arrays         */
+int      Nwpanel = 0; /* Size of linsolve() panel array         */
+int      Nwthreads = 0; /* Threads with linsolve() work arrays  */
+double   *Temp = NULL;   /* Work array for dense supernode panel*/
+int      *Lnk = NULL,    /* Work array of linked column lists   */
+         *First = NULL,  /* Work array of first column entries  */
+         *Rel = NULL;    /* Work array of rows in panel         */
+char     *Pending = NULL; /* Work array of columns to be linked */
+double   *Mii = NULL,    /* Diagonal of incomplete Cholesky factor */
+         *Mij = NULL,    /* Off-diag. of incomplete Cholesky factor*/
+         *Pcgwork = NULL; /* Work array of PCG vectors          */
+double   *Lii = NULL,    /* Diagonal of factor kept by updsolve()  */
+         *Lij = NULL,    /* Off-diag. of factor kept by updsolve() */
+         *Afii = NULL,   /* Diagonal of matrix that L belongs to   */
+         *Afij = NULL,   /* Off-diag. of matrix that L belongs to  */
+         *Updx = NULL;   /* Work array of rank-one update vectors  */
+int      *Updlist = NULL; /* Terms of matrix needing an update  */
+int      Factored = FALSE; /* TRUE if Lii & Lij hold a factor   */
+double   Factwork = 0.0; /* Work needed to factorize matrix     */
+float    *Sii = NULL,    /* Diagonal of single precision factor    */
+         *Sij = NULL;    /* Off-diag. of single precision factor   */
+double   *Refwork = NULL; /* Work array of refinement vectors      */
 
 
 int  createsparse()
@@ -58,42 +131,88 @@ int  createsparse()
 */
 {
    int errcode = 0;
+   unsigned key;
+   clock_t t0;
 
    /* Allocate data structures */
    ERRCODE(allocsparse());
    if (errcode) return(errcode);
 
-   /* Build node-link adjacency lists with parallel links removed. */
-   Degree = (int *) calloc(Nnodes+1, sizeof(int));
-   ERRCODE(MEMCHECK(Degree));
-   ERRCODE(buildlists(TRUE));
-   if (!errcode)
+   /* See if the sparse storage scheme for this network's */
+   /* topology was saved to the symbolic factor file.     */
+   key = fingerprint();
+   SymCached = FALSE;
+   if (strlen(SymFname) > 0)
+   {
+      t0 = clock();
+      SymCached = loadsparse(Njuncs, key);
+      OrderTime = (int)(1000.0*(clock() - t0)/CLOCKS_PER_SEC);
+   }
+   if (!SymCached)
    {
-      xparalinks();    /* Remove parallel links */
-      countdegree();   /* Find degree of each junction */
-   }                   /* (= # of adjacent links)  */
-
-   /* Re-order nodes to minimize number of non-zero coeffs.    */
-   /* in factorized solution matrix. At same time, adjacency   */
-   /* list is updated with links representing non-zero coeffs. */
-   Ncoeffs = Nlinks;
-   ERRCODE(reordernodes());
 
-   /* Allocate memory for sparse storage of positions of non-zero */
-   /* coeffs. and store these positions in vector NZSUB. */
-   ERRCODE(storesparse(Njuncs));
+      /* Build node-link adjacency lists with parallel links removed. */
+      Degree = (int *) calloc(Nnodes+1, sizeof(int));
+      ERRCODE(MEMCHECK(Degree));
+      ERRCODE(buildlists(TRUE));
+      if (!errcode)
+      {
+         xparalinks();    /* Remove parallel links */
+         countdegree();   /* Find degree of each junction */
+      }                   /* (= # of adjacent links)  */
+
+      /* Re-order nodes to minimize number of non-zero coeffs.    */
+      /* in factorized solution matrix. At same time, adjacency   */
+      /* list is updated with links representing non-zero coeffs. */
+      /* The time taken (in msec) is saved for ENgetstatistic().  */
+      Ncoeffs = Nlinks;
+      t0 = clock();
+      ERRCODE(reordernodes());
+      OrderTime = (int)(1000.0*(clock() - t0)/CLOCKS_PER_SEC);
+
+      /* Allocate memory for sparse storage of positions of non-zero */
+      /* coeffs. and store these positions in vector NZSUB. */
+      ERRCODE(storesparse(Njuncs));
+
+      /* Free memory used for adjacency lists and sort */
+      /* row indexes in NZSUB to optimize linsolve().  */
+      if (!errcode) freelists();
+      ERRCODE(ordersparse(Njuncs));
+
+      /* Store off-diagonal coeffs. by column of the factorized */
+      /* matrix, so that linsolve() can scan them in order.     */
+      ERRCODE(mapcoeffs(Njuncs));
+
+      /* Save the results for later runs on the same topology */
+      if (!errcode && strlen(SymFname) > 0) savesparse(Njuncs, key);
+      free(Degree);
+      Degree = NULL;
+   }
 
-   /* Free memory used for adjacency lists and sort */
-   /* row indexes in NZSUB to optimize linsolve().  */
-   if (!errcode) freelists();
-   ERRCODE(ordersparse(Njuncs));
+   /* Find supernodes of the factorized matrix and */
+   /* the subtrees of them that are independent.   */
+   /* (Not needed when solving by PCG.)            */
+   if (Solver == CHOLESKY)
+   {
+      ERRCODE(findsupernodes(Njuncs));
+      ERRCODE(findchains(Njuncs));
+      ERRCODE(findtasks());
+   }
+   else CoreSize = Njuncs;
+
+   /* Allocate work arrays used by linsolve() or pcgsolve() so that */
+   /* no memory needs to be allocated each time the equations are   */
+   /* solved.                                                       */
+   if (Solver == PCG) ERRCODE(allocpcg(Njuncs));
+   else               ERRCODE(allocwork(Njuncs));
+   if (Solver == CHOLESKY && UpdateLimit > 0.0)
+      ERRCODE(allocupdate(Njuncs));
+   if (Solver == CHOLESKY && Precision == MIXEDPREC)
+      ERRCODE(allocmixed(Njuncs));
 
    /* Re-build adjacency lists without removing parallel */
    /* links for use in future connectivity checking.     */
    ERRCODE(buildlists(FALSE));
-
-   /* Free allocated memory */
-   free(Degree);
    return(errcode);
 }                        /* End of createsparse */
 
@@ -137,9 +256,119 @@ void  freesparse()
    free(XLNZ);
    free(NZSUB);
    free(LNZ); 
+   LNZ = NULL;
+   free(Xsuper);
+   free(Super);
+   free(Pfill);
+   free(Xtask);
+   free(Tsuper);
+   free(Task);
+   free(Troot);
+   free(Terr);
+   free(Temp);
+   free(Lnk);
+   free(First);
+   free(Rel);
+   free(Pending);
+   free(Mii);
+   free(Mij);
+   free(Pcgwork);
+   free(Lii);
+   free(Lij);
+   free(Afii);
+   free(Afij);
+   free(Updx);
+   free(Updlist);
+   free(Sii);
+   free(Sij);
+   free(Refwork);
+   Xsuper = NULL;
+   Super = NULL;
+   Pfill = NULL;
+   Xtask = NULL;
+   Tsuper = NULL;
+   Task = NULL;
+   Troot = NULL;
+   Terr = NULL;
+   Temp = NULL;
+   Lnk = NULL;
+   First = NULL;
+   Rel = NULL;
+   Pending = NULL;
+   Mii = NULL;
+   Mij = NULL;
+   Pcgwork = NULL;
+   Lii = NULL;
+   Lij = NULL;
+   Afii = NULL;
+   Afij = NULL;
+   Updx = NULL;
+   Updlist = NULL;
+   Sii = NULL;
+   Sij = NULL;
+   Refwork = NULL;
+   Factored = FALSE;
+   Nsuper = 0;
+   Npanel = 0;
+   Nchain = 0;
+   Ntasks = 0;
+   Nwork = 0;
+   Nwpanel = 0;
+   Nwthreads = 0;
 }                        /* End of freesparse */
 
 
+int  allocwork(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: makes sure the work arrays used by linsolve() can   
+**          hold n rows and the largest supernode panel for     
+**          each solver thread, re-allocating them if necessary 
+**--------------------------------------------------------------
+*/
+{
+   int errcode = 0;
+   int nt = MAX(Threads, 1);
+
+   if (n+1 > Nwork)
+   {
+      free(Lnk);
+      free(First);
+      free(Pending);
+      Lnk     = (int *)  calloc(n+1, sizeof(int));
+      First   = (int *)  calloc(n+1, sizeof(int));
+      Pending = (char *) calloc(n+1, sizeof(char));
+      ERRCODE(MEMCHECK(Lnk));
+      ERRCODE(MEMCHECK(First));
+      ERRCODE(MEMCHECK(Pending));
+      if (errcode) Nwork = 0;
+      else AllocBytes += (n+1)*(2*sizeof(int) + sizeof(char));
+   }
+
+   /* Each thread has its own panel & panel row arrays */
+   if (!errcode && (n+1 > Nwork || Npanel > Nwpanel || nt > Nwthreads))
+   {
+      free(Temp);
+      free(Rel);
+      Temp = (double *) calloc(nt*Npanel, sizeof(double));
+      Rel  = (int *)    calloc(nt*(n+1), sizeof(int));
+      ERRCODE(MEMCHECK(Temp));
+      ERRCODE(MEMCHECK(Rel));
+      if (errcode) Nwork = 0;
+      else
+      {
+         Nwpanel = Npanel;
+         Nwthreads = nt;
+         AllocBytes += nt*(Npanel*sizeof(double) + (n+1)*sizeof(int));
+      }
+   }
+   if (!errcode) Nwork = MAX(Nwork, n+1);
+   return(errcode);
+}                        /* End of allocwork */
+
+
 int  buildlists(int paraflag)
 /*
 **--------------------------------------------------------------
@@ -303,19 +532,35 @@ int   reordernodes()
 /*
 **--------------------------------------------------------------
 ** Input:   none                                                
-** Output:  returns 1 if successful, 0 if not                   
+** Output:  returns error code                                  
 ** Purpose: re-orders nodes to minimize # of non-zeros that     
 **          will appear in factorized solution matrix           
 **--------------------------------------------------------------
 */
 {
    int k, knode, m, n;
+   int errcode = 0;
    for (k=1; k<=Nnodes; k++)
    {
       Row[k] = k;
       Order[k] = k;
    }
    n = Njuncs;
+
+   /* The PCG solver works on the matrix itself, so */
+   /* nodes keep their order and no fill-ins occur. */
+   if (Solver == PCG) return(0);
+
+   /* Approximate minimum degree ordering, followed by a */
+   /* symbolic factorization to find the fill-ins.       */
+   if (Ordering == AMD)
+   {
+      ERRCODE(amdorder(n));
+      if (errcode) return(errcode);
+      for (k=1; k<=n; k++) Row[Order[k]] = k;
+      return(symbfill(n));
+   }
+
    for (k=1; k<=n; k++)                   /* Examine each junction    */
    {
       m = mindegree(k,n);                 /* Node with lowest degree  */
@@ -331,6 +576,358 @@ int   reordernodes()
 }                        /* End of reordernodes */
 
 
+int  amdorder(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of junction nodes                        
+** Output:  returns error code                                  
+** Purpose: finds an approximate minimum degree ordering of the 
+**          junction nodes and stores it in Order[1..n]         
+**                                                              
+** NOTE:   The elimination is carried out on a quotient graph,  
+**         so no fill-in is ever formed explicitly. Each node   
+**         that gets eliminated becomes an "element" whose list 
+**         holds the still active nodes it connects. For each   
+**         active node i we keep:                               
+**            adj[i] (active nodes directly linked to i)        
+**            elm[i] (elements adjacent to i)                   
+**         Nodes are kept in linked lists by degree so the next 
+**         pivot is found without scanning. The degree of each  
+**         node is the approximate external degree of Amestoy, 
+**         Davis & Duff ("An approximate minimum degree ordering
+**         algorithm", SIAM J. Matrix Anal. Appl., 1996), which  
+**         also lets elements that are contained in the newest  
+**         one be absorbed into it.                             
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, k, m, e, p, d, dmin, lp, nw;
+   int    errcode = 0;
+   int    *deg,  *head, *next, *prev,   /* Degree lists           */
+          *w,    *mark, *stat,          /* Work & status arrays   */
+          *lbuf, *wbuf,                 /* Work lists             */
+          *alen, *elen, *ecap, *llen;   /* List lengths           */
+   int    **adj, **elm, **lst;          /* Quotient graph lists   */
+   Padjlist alink;
+
+   /* Allocate work arrays */
+   deg  = (int *) calloc(n+1, sizeof(int));
+   head = (int *) calloc(n+1, sizeof(int));
+   next = (int *) calloc(n+1, sizeof(int));
+   prev = (int *) calloc(n+1, sizeof(int));
+   w    = (int *) calloc(n+1, sizeof(int));
+   mark = (int *) calloc(n+1, sizeof(int));
+   stat = (int *) calloc(n+1, sizeof(int));
+   lbuf = (int *) calloc(n+1, sizeof(int));
+   wbuf = (int *) calloc(n+1, sizeof(int));
+   alen = (int *) calloc(n+1, sizeof(int));
+   elen = (int *) calloc(n+1, sizeof(int));
+   ecap = (int *) calloc(n+1, sizeof(int));
+   llen = (int *) calloc(n+1, sizeof(int));
+   adj  = (int **) calloc(n+1, sizeof(int *));
+   elm  = (int **) calloc(n+1, sizeof(int *));
+   lst  = (int **) calloc(n+1, sizeof(int *));
+   ERRCODE(MEMCHECK(deg));
+   ERRCODE(MEMCHECK(head));
+   ERRCODE(MEMCHECK(next));
+   ERRCODE(MEMCHECK(prev));
+   ERRCODE(MEMCHECK(w));
+   ERRCODE(MEMCHECK(mark));
+   ERRCODE(MEMCHECK(stat));
+   ERRCODE(MEMCHECK(lbuf));
+   ERRCODE(MEMCHECK(wbuf));
+   ERRCODE(MEMCHECK(alen));
+   ERRCODE(MEMCHECK(elen));
+   ERRCODE(MEMCHECK(ecap));
+   ERRCODE(MEMCHECK(llen));
+   ERRCODE(MEMCHECK(adj));
+   ERRCODE(MEMCHECK(elm));
+   ERRCODE(MEMCHECK(lst));
+   if (errcode) goto ENDAMD;
+
+   /* Copy junction-to-junction connections into quotient graph */
+   /* (tanks are excluded since they are not part of matrix)   */
+   for (i=1; i<=n; i++)
+   {
+      m = 0;
+      for (alink = Adjlist[i]; alink != NULL; alink = alink->next)
+         if (alink->node > 0 && alink->node <= n) m++;
+      adj[i] = (int *) calloc(m+1, sizeof(int));
+      if (adj[i] == NULL)
+      {
+         errcode = 101;
+         goto ENDAMD;
+      }
+      for (alink = Adjlist[i]; alink != NULL; alink = alink->next)
+         if (alink->node > 0 && alink->node <= n)
+            adj[i][alen[i]++] = alink->node;
+      w[i] = -1;
+   }
+
+   /* Place each node in list for its initial degree */
+   for (i=n; i>=1; i--)
+   {
+      d = alen[i];
+      deg[i] = d;
+      prev[i] = 0;
+      next[i] = head[d];
+      if (head[d]) prev[head[d]] = i;
+      head[d] = i;
+   }
+   dmin = 0;
+
+   /* Eliminate nodes one at a time */
+   for (k=1; k<=n; k++)
+   {
+
+      /* Remove node p of least degree from degree lists */
+      while (head[dmin] == 0) dmin++;
+      p = head[dmin];
+      head[dmin] = next[p];
+      if (next[p]) prev[next[p]] = 0;
+      stat[p] = 1;
+      Order[k] = p;
+
+      /* Form new element p from p's adjacent nodes plus the */
+      /* nodes of its adjacent elements (which get absorbed) */
+      lp = 0;
+      mark[p] = p;
+      for (j=0; j<alen[p]; j++)
+      {
+         i = adj[p][j];
+         if (stat[i] == 0 && mark[i] != p)
+         {
+            mark[i] = p;
+            lbuf[lp++] = i;
+         }
+      }
+      for (j=0; j<elen[p]; j++)
+      {
+         e = elm[p][j];
+         if (stat[e] != 1) continue;
+         for (m=0; m<llen[e]; m++)
+         {
+            i = lst[e][m];
+            if (stat[i] == 0 && mark[i] != p)
+            {
+               mark[i] = p;
+               lbuf[lp++] = i;
+            }
+         }
+         stat[e] = 2;
+         free(lst[e]);
+         lst[e] = NULL;
+      }
+      free(adj[p]);
+      free(elm[p]);
+      adj[p] = NULL;
+      elm[p] = NULL;
+      alen[p] = 0;
+      elen[p] = 0;
+      lst[p] = (int *) calloc(lp+1, sizeof(int));
+      if (lst[p] == NULL)
+      {
+         errcode = 101;
+         goto ENDAMD;
+      }
+      memcpy(lst[p], lbuf, lp*sizeof(int));
+      llen[p] = lp;
+
+      /* Update the lists of each node in the new element */
+      for (j=0; j<lp; j++)
+      {
+         i = lbuf[j];
+
+         /* Take node out of its degree list */
+         if (prev[i]) next[prev[i]] = next[i];
+         else head[deg[i]] = next[i];
+         if (next[i]) prev[next[i]] = prev[i];
+
+         /* Drop p and members of new element from node list */
+         nw = 0;
+         for (m=0; m<alen[i]; m++)
+         {
+            if (mark[adj[i][m]] != p) adj[i][nw++] = adj[i][m];
+         }
+         alen[i] = nw;
+
+         /* Drop absorbed elements and add the new one */
+         nw = 0;
+         for (m=0; m<elen[i]; m++)
+         {
+            if (stat[elm[i][m]] == 1) elm[i][nw++] = elm[i][m];
+         }
+         if (nw >= ecap[i])
+         {
+            ecap[i] = 2*ecap[i] + 4;
+            elm[i] = (int *) realloc(elm[i], ecap[i]*sizeof(int));
+            if (elm[i] == NULL)
+            {
+               errcode = 101;
+               goto ENDAMD;
+            }
+         }
+         elm[i][nw++] = p;
+         elen[i] = nw;
+      }
+
+      /* Find w[e] = |Le \ Lp| for each element e */
+      /* adjacent to a node of the new element    */
+      m = 0;
+      for (j=0; j<lp; j++)
+      {
+         i = lbuf[j];
+         for (nw=0; nw<elen[i]; nw++)
+         {
+            e = elm[i][nw];
+            if (e == p) continue;
+            if (w[e] < 0)
+            {
+               w[e] = llen[e];
+               wbuf[m++] = e;
+            }
+            w[e]--;
+         }
+      }
+
+      /* Compute approximate degree of each node in new element */
+      /* and put node back in the proper degree list            */
+      for (j=0; j<lp; j++)
+      {
+         i = lbuf[j];
+         d = alen[i] + lp - 1;
+         for (nw=0; nw<elen[i]; nw++)
+         {
+            e = elm[i][nw];
+            if (e == p || stat[e] != 1) continue;
+            if (w[e] == 0)              /* e is contained in element p */
+            {
+               stat[e] = 2;
+               free(lst[e]);
+               lst[e] = NULL;
+            }
+            else d += w[e];
+         }
+         d = MIN(d, deg[i] + lp - 1);
+         d = MIN(d, n - k - 1);
+         deg[i] = d;
+         prev[i] = 0;
+         next[i] = head[d];
+         if (head[d]) prev[head[d]] = i;
+         head[d] = i;
+         if (d < dmin) dmin = d;
+      }
+      for (j=0; j<m; j++) w[wbuf[j]] = -1;
+   }
+
+   /* Free allocated memory */
+ENDAMD:
+   for (i=0; i<=n; i++)
+   {
+      if (adj != NULL) free(adj[i]);
+      if (elm != NULL) free(elm[i]);
+      if (lst != NULL) free(lst[i]);
+   }
+   free(deg);
+   free(head);
+   free(next);
+   free(prev);
+   free(w);
+   free(mark);
+   free(stat);
+   free(lbuf);
+   free(wbuf);
+   free(alen);
+   free(elen);
+   free(ecap);
+   free(llen);
+   free(adj);
+   free(elm);
+   free(lst);
+   return(errcode);
+}                        /* End of amdorder */
+
+
+int  symbfill(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of junction nodes                        
+** Output:  returns error code                                  
+** Purpose: adds the fill-ins produced by the node ordering in  
+**          Order[] to the nodal adjacency lists                
+**                                                              
+** NOTE:   The non-zeros of column j of the factor are found by 
+**         merging the original non-zeros of column j with those
+**         of each column whose parent in the elimination tree  
+**         is j, so each new entry is found without searching.  
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, c, r, knode, parent;
+   int    errcode = 0;
+   int    *mark, *child, *sibling;
+   Padjlist alink;
+
+   mark    = (int *) calloc(n+1, sizeof(int));
+   child   = (int *) calloc(n+1, sizeof(int));
+   sibling = (int *) calloc(n+1, sizeof(int));
+   ERRCODE(MEMCHECK(mark));
+   ERRCODE(MEMCHECK(child));
+   ERRCODE(MEMCHECK(sibling));
+   if (!errcode) for (j=1; j<=n; j++)
+   {
+      knode = Order[j];
+
+      /* Mark original non-zeros below the diagonal of column j */
+      for (alink = Adjlist[knode]; alink != NULL; alink = alink->next)
+      {
+         i = alink->node;
+         if (i > 0 && i <= n && Row[i] > j) mark[Row[i]] = j;
+      }
+
+      /* Merge in the non-zeros of each child column */
+      for (c = child[j]; c != 0; c = sibling[c])
+      {
+         for (alink = Adjlist[Order[c]]; alink != NULL; alink = alink->next)
+         {
+            i = alink->node;
+            if (i <= 0 || i > n) continue;
+            r = Row[i];
+            if (r > j && mark[r] != j)
+            {
+               mark[r] = j;
+               Ncoeffs++;
+               if (!addlink(knode,i,Ncoeffs) || !addlink(i,knode,Ncoeffs))
+               {
+                  errcode = 101;
+                  break;
+               }
+            }
+         }
+         if (errcode) break;
+      }
+      if (errcode) break;
+
+      /* Parent of column j is its first off-diagonal row */
+      parent = n+1;
+      for (alink = Adjlist[knode]; alink != NULL; alink = alink->next)
+      {
+         i = alink->node;
+         if (i > 0 && i <= n && Row[i] > j) parent = MIN(parent, Row[i]);
+      }
+      if (parent <= n)
+      {
+         sibling[j] = child[parent];
+         child[parent] = j;
+      }
+   }
+   free(mark);
+   free(child);
+   free(sibling);
+   return(errcode);
+}                        /* End of symbfill */
+
+
 int  mindegree(int k, int n)
 /*
 **--------------------------------------------------------------
@@ -564,191 +1161,1934 @@ int  ordersparse(int n)
 }                        /* End of ordersparse */
 
 
-void  transpose(int n, int *il, int *jl, int *xl, int *ilt, int *jlt,
-                int *xlt, int *nzt)
+int  mapcoeffs(int n)
 /*
-**---------------------------------------------------------------------
-** Input:   n = matrix order                                           
-**          il,jl,xl = sparse storage scheme for original matrix       
-**          nzt = work array                                           
-** Output:  ilt,jlt,xlt = sparse storage scheme for transposed matrix  
-** Purpose: Determines sparse storage scheme for transpose of a matrix 
-**---------------------------------------------------------------------
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: points each link's Ndx entry at the position in     
+**          NZSUB of its coeff., so that Aij holds the non-zero 
+**          coeffs. of the factorized matrix column by column   
+**                                                              
+** NOTE:   Links connected to a tank or reservoir have no coeff.
+**         in the factorized matrix and are pointed at the      
+**         unused entry Aij[0]. Once done, LNZ is no longer     
+**         needed and is freed.                                 
+**--------------------------------------------------------------
 */
 {
-   int  i, j, k, kk;
+   int  i, k;
+   int  *slot;
+   int  errcode = 0;
 
-   for (i=1; i<=n; i++) nzt[i] = 0;
-   for (i=1; i<=n; i++)
+   slot = (int *) calloc(Ncoeffs+2, sizeof(int));
+   ERRCODE(MEMCHECK(slot));
+   if (!errcode)
    {
-      for (k=il[i]; k<il[i+1]; k++)
-      {
-         j = jl[k];
-         kk = ilt[j] + nzt[j];
-         jlt[kk] = i;
-         xlt[kk] = xl[k];
-         nzt[j]++;
-      }
+      for (i=1; i<XLNZ[n+1]; i++) slot[LNZ[i]] = i;
+      for (k=1; k<=Nlinks; k++) Ndx[k] = slot[Ndx[k]];
+      free(LNZ);
+      LNZ = NULL;
    }
-}                        /* End of transpose */
+   free(slot);
+   return(errcode);
+}                        /* End of mapcoeffs */
 
 
-int  linsolve(int n, double *Aii, double *Aij, double *B)
+unsigned  fingerprint()
 /*
 **--------------------------------------------------------------
-** Input:   n    = number of equations                          
-**          Aii  = diagonal entries of solution matrix          
-**          Aij  = non-zero off-diagonal entries of matrix      
-**          B    = right hand side coeffs.                      
-** Output:  B    = solution values                              
-**          returns 0 if solution found, or index of            
-**          equation causing system to be ill-conditioned       
-** Purpose: solves sparse symmetric system of linear            
-**          equations using Cholesky factorization              
-**                                                              
-** NOTE:   This procedure assumes that the solution matrix has  
-**         been symbolically factorized with the positions of   
-**         the lower triangular, off-diagonal, non-zero coeffs. 
-**         stored in the following integer arrays:              
-**            XLNZ  (start position of each column in NZSUB)    
-**            NZSUB (row index of each non-zero in each column) 
-**            LNZ   (position of each NZSUB entry in Aij array) 
+** Input:   none                                                
+** Output:  returns a hash key of the network's topology        
+** Purpose: computes a fingerprint of the network's node and    
+**          link connectivity, its set of tanks and the node    
+**          re-ordering method and linear solver used           
 **                                                              
-**  This procedure has been adapted from subroutines GSFCT and  
-**  GSSLV in the book "Computer Solution of Large Sparse        
-**  Positive Definite Systems" by A. George and J. W-H Liu      
-**  (Prentice-Hall, 1981).                                      
+** NOTE:   Tanks & reservoirs are always indexed after all of   
+**         the junctions, so the set of tanks is covered by the 
+**         node counts. The key is the 32-bit FNV-1a hash of    
+**         these counts and of the end nodes of each link.      
 **--------------------------------------------------------------
 */
 {
-   int    *link, *first;
-   int    i, istop, istrt, isub, j, k, kfirst, newk;
-   int    errcode = 0;
-   double bj, diagj, ljk;
-   double *temp;
-
-   temp = (double *) calloc(n+1, sizeof(double));
-   link = (int *) calloc(n+1,sizeof(int));
-   first = (int *) calloc(n+1,sizeof(int));
-   ERRCODE(MEMCHECK(temp));
-   ERRCODE(MEMCHECK(link));
-   ERRCODE(MEMCHECK(first));
-   if (errcode)
+   int      k;
+   unsigned key = 2166136261u;
+
+   key = hashint(key, Nnodes);
+   key = hashint(key, Njuncs);
+   key = hashint(key, Nlinks);
+   key = hashint(key, Ordering);
+   key = hashint(key, Solver);
+   for (k=1; k<=Nlinks; k++)
    {
-      errcode = -errcode;
-      goto ENDLINSOLVE;
+      key = hashint(key, Link[k].N1);
+      key = hashint(key, Link[k].N2);
    }
-   memset(temp,0,(n+1)*sizeof(double));
-   memset(link,0,(n+1)*sizeof(int));
+   return(key);
+}                        /* End of fingerprint */
 
-   /* Begin numerical factorization of matrix A into L */
-   /*   Compute column L(*,j) for j = 1,...n */
-   for (j=1; j<=n; j++)
+
+unsigned  hashint(unsigned key, int v)
+/*
+**--------------------------------------------------------------
+** Input:   key = current hash key                              
+**          v   = integer value                                 
+** Output:  returns updated hash key                            
+** Purpose: adds the 4 bytes of v, low byte first, to an FNV-1a 
+**          hash key                                            
+**--------------------------------------------------------------
+*/
+{
+   int i;
+   for (i=0; i<4; i++)
    {
-      /* For each column L(*,k) that affects L(*,j): */
-      diagj = 0.0;
-      newk = link[j];
-      k = newk;
-      while (k != 0)
-      {
-
-         /* Outer product modification of L(*,j) by  */
-         /* L(*,k) starting at first[k] of L(*,k).   */
-         newk = link[k];
-         kfirst = first[k];
-         ljk = Aij[LNZ[kfirst]];
-         diagj += ljk*ljk;
-         istrt = kfirst + 1;
-         istop = XLNZ[k+1] - 1;
-         if (istop >= istrt)
-         {
+      key ^= (unsigned)(v >> 8*i) & 0xFF;
+      key *= 16777619u;
+   }
+   return(key);
+}                        /* End of hashint */
 
-	     /* Before modification, update vectors 'first' */
-	     /* and 'link' for future modification steps.   */
-            first[k] = istrt;
-            isub = NZSUB[istrt];
-            link[k] = link[isub];
-            link[isub] = k;
 
-	    /* The actual mod is saved in vector 'temp'. */
-            for (i=istrt; i<=istop; i++)
-            {
-               isub = NZSUB[i];
-               temp[isub] += Aij[LNZ[i]]*ljk;
-            }
-         }
-         k = newk;
-      }
+int  loadsparse(int n, unsigned key)
+/*
+**--------------------------------------------------------------
+** Input:   n   = number of rows in solution matrix             
+**          key = fingerprint of network's topology             
+** Output:  returns TRUE if sparse storage scheme was loaded    
+** Purpose: reads the node ordering and sparse storage scheme   
+**          of the solution matrix from the symbolic factor     
+**          file if it was saved for the same topology          
+**                                                              
+** NOTE:   The end nodes of every link are saved along with the 
+**         fingerprint, so a scheme is only ever used for the   
+**         exact topology it was made for. A missing, outdated  
+**         or unreadable file is simply ignored, as is one      
+**         whose contents fail checkscheme() or the checksum.   
+**--------------------------------------------------------------
+*/
+{
+   FILE  *f;
+   INT4  h[10];
+   INT4  *ends;
+   int   k, nnz;
+   int   ok = FALSE;
+
+   f = fopen(SymFname, "rb");
+   if (f == NULL) return(FALSE);
+   if (fread(h,sizeof(INT4),10,f) < 10
+   ||  h[0] != MAGICNUMBER || h[1] != VERSION || h[2] != (INT4)key
+   ||  h[3] != Nnodes || h[4] != n || h[5] != Nlinks
+   ||  h[6] != Ordering || h[7] < Nlinks || h[8] != Solver)
+   {
+      fclose(f);
+      return(FALSE);
+   }
 
-      /* Apply the modifications accumulated */
-      /* in 'temp' to column L(*,j).         */
-      diagj = Aii[j] - diagj;
-      if (diagj <= 0.0)        /* Check for ill-conditioning */
-      {
-         errcode = j;
-         goto ENDLINSOLVE;
-      }
-      diagj = sqrt(diagj);
-      Aii[j] = diagj;
-      istrt = XLNZ[j];
-      istop = XLNZ[j+1] - 1;
-      if (istop >= istrt)
+   /* Check that every link has the same end nodes */
+   ends = (INT4 *) calloc(2*(Nlinks+1), sizeof(INT4));
+   if (ends != NULL
+   &&  fread(ends,sizeof(INT4),2*(Nlinks+1),f) == (size_t)(2*(Nlinks+1)))
+   {
+      ok = TRUE;
+      for (k=1; k<=Nlinks; k++)
       {
-         first[j] = istrt;
-         isub = NZSUB[istrt];
-         link[j] = link[isub];
-         link[isub] = j;
-         for (i=istrt; i<=istop; i++)
+         if (ends[2*k] != Link[k].N1 || ends[2*k+1] != Link[k].N2)
          {
-            isub = NZSUB[i];
-            bj = (Aij[LNZ[i]] - temp[isub])/diagj;
-            Aij[LNZ[i]] = bj;
-            temp[isub] = 0.0;
+            ok = FALSE;
+            break;
          }
       }
-   }      /* next j */
+   }
+   free(ends);
 
-   /* Foward substitution */
-   for (j=1; j<=n; j++)
+   /* Read the node ordering & storage scheme */
+   if (ok)
    {
-      bj = B[j]/Aii[j];
-      B[j] = bj;
-      istrt = XLNZ[j];
-      istop = XLNZ[j+1] - 1;
-      if (istop >= istrt)
+      Ncoeffs = h[7];
+      XLNZ  = (int *) calloc(n+2, sizeof(int));
+      NZSUB = (int *) calloc(Ncoeffs+2, sizeof(int));
+      ok = (XLNZ != NULL && NZSUB != NULL
+      &&    fread(Order,sizeof(int),Nnodes+1,f) == (size_t)(Nnodes+1)
+      &&    fread(Row,sizeof(int),Nnodes+1,f) == (size_t)(Nnodes+1)
+      &&    fread(Ndx,sizeof(int),Nlinks+1,f) == (size_t)(Nlinks+1)
+      &&    fread(XLNZ,sizeof(int),n+2,f) == (size_t)(n+2));
+      if (ok)
       {
-         for (i=istrt; i<=istop; i++)
-         {
-            isub = NZSUB[i];
-            B[isub] -= Aij[LNZ[i]]*bj;
-         }
+         nnz = XLNZ[n+1] - 1;
+         ok = (XLNZ[1] == 1 && nnz >= 0 && nnz <= Ncoeffs
+         &&    fread(NZSUB,sizeof(int),nnz+1,f) == (size_t)(nnz+1));
       }
-   }
 
-   /* Backward substitution */
-   for (j=n; j>=1; j--)
-   {
-      bj = B[j];
-      istrt = XLNZ[j];
-      istop = XLNZ[j+1] - 1;
-      if (istop >= istrt)
+      /* Make sure the scheme is intact before it gets used */
+      if (ok) ok = (checkscheme(n) && schemesum(n) == (unsigned)h[9]);
+      if (!ok)
       {
-         for (i=istrt; i<=istop; i++)
-         {
-            isub = NZSUB[i];
-            bj -= Aij[LNZ[i]]*B[isub];
-         }
+         free(XLNZ);
+         free(NZSUB);
+         XLNZ = NULL;
+         NZSUB = NULL;
       }
-      B[j] = bj/Aii[j];
    }
+   fclose(f);
+   return(ok);
+}                        /* End of loadsparse */
 
-ENDLINSOLVE:
-   free(temp);
-   free(link);
-   free(first);
-   return(errcode);
-}                        /* End of linsolve */
 
+int  checkscheme(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns TRUE if sparse storage scheme is valid      
+** Purpose: checks that a node ordering and sparse storage      
+**          scheme read from file are consistent, so that none  
+**          of them can index outside of their arrays           
+**                                                              
+** NOTE:   Only the junctions are re-ordered, so Order & Row    
+**         must be inverse permutations of 1..n and leave the   
+**         tanks in place. Each column's row indexes must lie   
+**         below the diagonal and be in ascending order (see    
+**         ordersparse()). Each link's Ndx entry points into    
+**         Aij, whose entry 0 is used by links with no coeff.   
+**--------------------------------------------------------------
+*/
+{
+   int i, k, nnz;
+
+   for (k=1; k<=Nnodes; k++)
+   {
+      i = Order[k];
+      if (k <= n && (i < 1 || i > n)) return(FALSE);
+      if (k > n && i != k) return(FALSE);
+      if (Row[i] != k) return(FALSE);
+   }
+   nnz = XLNZ[n+1] - 1;
+   for (i=1; i<=n; i++)
+   {
+      if (XLNZ[i+1] < XLNZ[i]) return(FALSE);
+      for (k=XLNZ[i]; k<XLNZ[i+1]; k++)
+      {
+         if (NZSUB[k] <= i || NZSUB[k] > n) return(FALSE);
+         if (k > XLNZ[i] && NZSUB[k] <= NZSUB[k-1]) return(FALSE);
+      }
+   }
+   for (k=1; k<=Nlinks; k++)
+   {
+      if (Ndx[k] < 0 || Ndx[k] > nnz) return(FALSE);
+   }
+   return(TRUE);
+}                        /* End of checkscheme */
+
+
+unsigned  schemesum(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns checksum of sparse storage scheme           
+** Purpose: hashes the node ordering and sparse storage scheme  
+**          saved to the symbolic factor file                   
+**--------------------------------------------------------------
+*/
+{
+   int      k;
+   unsigned key = 2166136261u;
+
+   for (k=1; k<=Nnodes; k++)
+   {
+      key = hashint(key, Order[k]);
+      key = hashint(key, Row[k]);
+   }
+   for (k=1; k<=Nlinks; k++) key = hashint(key, Ndx[k]);
+   for (k=1; k<=n+1; k++) key = hashint(key, XLNZ[k]);
+   for (k=1; k<XLNZ[n+1]; k++) key = hashint(key, NZSUB[k]);
+   return(key);
+}                        /* End of schemesum */
+
+
+void  savesparse(int n, unsigned key)
+/*
+**--------------------------------------------------------------
+** Input:   n   = number of rows in solution matrix             
+**          key = fingerprint of network's topology             
+** Output:  none                                                
+** Purpose: saves the node ordering and sparse storage scheme   
+**          of the solution matrix to the symbolic factor file  
+**                                                              
+** NOTE:   Failure to write the file is not an error, since it  
+**         only serves to speed up later runs.                  
+**--------------------------------------------------------------
+*/
+{
+   FILE  *f;
+   INT4  h[10], e[2];
+   int   k;
+
+   f = fopen(SymFname, "wb");
+   if (f == NULL) return;
+   h[0] = MAGICNUMBER;
+   h[1] = VERSION;
+   h[2] = (INT4)key;
+   h[3] = Nnodes;
+   h[4] = n;
+   h[5] = Nlinks;
+   h[6] = Ordering;
+   h[7] = Ncoeffs;
+   h[8] = Solver;
+   h[9] = (INT4)schemesum(n);
+   fwrite(h,sizeof(INT4),10,f);
+   e[0] = 0;
+   e[1] = 0;
+   fwrite(e,sizeof(INT4),2,f);
+   for (k=1; k<=Nlinks; k++)
+   {
+      e[0] = Link[k].N1;
+      e[1] = Link[k].N2;
+      fwrite(e,sizeof(INT4),2,f);
+   }
+   fwrite(Order,sizeof(int),Nnodes+1,f);
+   fwrite(Row,sizeof(int),Nnodes+1,f);
+   fwrite(Ndx,sizeof(int),Nlinks+1,f);
+   fwrite(XLNZ,sizeof(int),n+2,f);
+   fwrite(NZSUB,sizeof(int),XLNZ[n+1],f);
+   fclose(f);
+}                        /* End of savesparse */
+
+
+void  transpose(int n, int *il, int *jl, int *xl, int *ilt, int *jlt,
+                int *xlt, int *nzt)
+/*
+**---------------------------------------------------------------------
+** Input:   n = matrix order                                           
+**          il,jl,xl = sparse storage scheme for original matrix       
+**          nzt = work array                                           
+** Output:  ilt,jlt,xlt = sparse storage scheme for transposed matrix  
+** Purpose: Determines sparse storage scheme for transpose of a matrix 
+**---------------------------------------------------------------------
+*/
+{
+   int  i, j, k, kk;
+
+   for (i=1; i<=n; i++) nzt[i] = 0;
+   for (i=1; i<=n; i++)
+   {
+      for (k=il[i]; k<il[i+1]; k++)
+      {
+         j = jl[k];
+         kk = ilt[j] + nzt[j];
+         jlt[kk] = i;
+         xlt[kk] = xl[k];
+         nzt[j]++;
+      }
+   }
+}                        /* End of transpose */
+
+
+int  findsupernodes(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: partitions the columns of the factorized matrix     
+**          into supernodes                                     
+**                                                              
+** NOTE:   A supernode is a run of consecutive columns j..l     
+**         where each column below the first one has the same   
+**         non-zero rows as its predecessor, less the diagonal. 
+**         Column j+1 joins column j's supernode when j+1 is    
+**         the first off-diagonal row of column j and column    
+**         j+1 has one less non-zero than column j. Such a run  
+**         forms a dense lower trapezoidal "panel" that can be  
+**         factorized with contiguous loops in linsolve().      
+**--------------------------------------------------------------
+*/
+{
+   int  j, m, w;
+   int  errcode = 0;
+
+   Xsuper = (int *) calloc(n+2, sizeof(int));
+   Super  = (int *) calloc(n+1, sizeof(int));
+   ERRCODE(MEMCHECK(Xsuper));
+   ERRCODE(MEMCHECK(Super));
+   if (errcode) return(errcode);
+
+   /* Mark start of each supernode */
+   Nsuper = 0;
+   for (j=1; j<=n; j++)
+   {
+      if (j == 1
+      ||  XLNZ[j-1] == XLNZ[j]
+      ||  NZSUB[XLNZ[j-1]] != j
+      ||  XLNZ[j+1] - XLNZ[j] != XLNZ[j] - XLNZ[j-1] - 1)
+      {
+         Nsuper++;
+         Xsuper[Nsuper] = j;
+      }
+      Super[j] = Nsuper;
+   }
+   Xsuper[Nsuper+1] = n+1;
+
+   /* Find size of largest panel, which has as many  */
+   /* rows as the first column of its supernode does */
+   Npanel = 1;
+   for (j=1; j<=Nsuper; j++)
+   {
+      m = XLNZ[Xsuper[j]+1] - XLNZ[Xsuper[j]] + 1;
+      w = Xsuper[j+1] - Xsuper[j];
+      Npanel = MAX(Npanel, m*w);
+   }
+   return(errcode);
+}                        /* End of findsupernodes */
+
+
+int  findchains(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: finds the leading columns of the factorized matrix  
+**          that can be eliminated as tree branches and series  
+**          chains before the rest of the matrix is factorized  
+**                                                              
+** NOTE:   A junction at the end of a dead-end branch is left   
+**         with a single neighbor when it is eliminated, and    
+**         one in the middle of a series chain with two. Both   
+**         minimum degree orderings eliminate all of these      
+**         first, so they make up a run of leading columns of  
+**         L with no more than 2 off-diagonal rows each (the    
+**         run is cut back to end on a supernode boundary).     
+**         Eliminating such a column only changes the diagonal 
+**         of its rows and, for a chain, the coeff. that joins  
+**         its two neighbors (stored at Pfill). This leaves the 
+**         Schur complement of the reduced "core" network in   
+**         Aii and Aij, so linsolve() does these columns first  
+**         with a simple loop (see elimchains()) and only       
+**         passes the core's CoreSize rows through the        
+**         supernodal factorization. The heads of the chain    
+**         junctions are then recovered exactly by the usual   
+**         forward and backward substitution.                  
+**--------------------------------------------------------------
+*/
+{
+   int  i, j, k, r;
+
+   /* Find run of leading columns with at most 2 rows */
+   for (j=1; j<=n; j++)
+   {
+      if (XLNZ[j+1] - XLNZ[j] > 2) break;
+   }
+   Nchain = j - 1;
+   if (Nchain < n) Nchain = Xsuper[Super[Nchain+1]] - 1;
+
+   /* Find position of the coeff. that joins */
+   /* the two rows of each chain column      */
+   Pfill = (int *) calloc(Nchain+1, sizeof(int));
+   if (Pfill == NULL) return(101);
+   for (j=1; j<=Nchain; j++)
+   {
+      k = XLNZ[j];
+      if (XLNZ[j+1] - k < 2) continue;
+      r = NZSUB[k];
+      for (i=XLNZ[r]; i<XLNZ[r+1]; i++)
+      {
+         if (NZSUB[i] == NZSUB[k+1]) break;
+      }
+      Pfill[j] = i;
+   }
+   CoreSize = n - Nchain;
+   return(0);
+}                        /* End of findchains */
+
+
+int  findtasks()
+/*
+**--------------------------------------------------------------
+** Input:   none                                                
+** Output:  returns error code                                  
+** Purpose: splits the elimination tree of the supernodes into  
+**          independent subtrees (tasks) plus a top part        
+**                                                              
+** NOTE:   The parent of a supernode in the elimination tree is 
+**         the supernode holding the first row below its last   
+**         column. A column of L only modifies its ancestors,   
+**         so the subtrees below any set of supernodes that are 
+**         not ancestors of one another can be factorized at    
+**         the same time. Each supernode whose subtree holds    
+**         no more than 1/MAXTASKS of the total work, but whose 
+**         parent's subtree holds more, starts a new task. The  
+**         remaining "top" supernodes are kept in list number   
+**         Ntasks+1 and are factorized after all of the tasks.  
+**         This split does not depend on the number of threads  
+**         used, so neither do the results of linsolve().       
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, k, l, s, t;
+   int    errcode = 0;
+   int    *parent;
+   double *work, limit;
+
+   parent = (int *) calloc(Nsuper+1, sizeof(int));
+   work   = (double *) calloc(Nsuper+1, sizeof(double));
+   Xtask  = (int *) calloc(Nsuper+3, sizeof(int));
+   Tsuper = (int *) calloc(Nsuper+1, sizeof(int));
+   Task   = (int *) calloc(Nsuper+1, sizeof(int));
+   Troot  = (int *) calloc(Nsuper+2, sizeof(int));
+   Terr   = (int *) calloc(Nsuper+2, sizeof(int));
+   ERRCODE(MEMCHECK(parent));
+   ERRCODE(MEMCHECK(work));
+   ERRCODE(MEMCHECK(Xtask));
+   ERRCODE(MEMCHECK(Tsuper));
+   ERRCODE(MEMCHECK(Task));
+   ERRCODE(MEMCHECK(Troot));
+   ERRCODE(MEMCHECK(Terr));
+   if (!errcode)
+   {
+
+      /* Find parent of each supernode and the work needed */
+      /* to factorize the subtree below it                 */
+      limit = 0.0;
+      for (s=1; s<=Nsuper; s++)
+      {
+         for (j=Xsuper[s]; j<Xsuper[s+1]; j++)
+         {
+            k = XLNZ[j+1] - XLNZ[j] + 1;
+            work[s] += (double)k*k;
+         }
+         l = Xsuper[s+1] - 1;
+         if (XLNZ[l+1] > XLNZ[l])
+         {
+            parent[s] = Super[NZSUB[XLNZ[l]]];
+            work[parent[s]] += work[s];
+         }
+         else limit += work[s];
+      }
+      limit /= MAXTASKS;
+
+      /* Assign supernodes to tasks, working down from the roots */
+      Ntasks = 0;
+      for (s=Nsuper; s>=1; s--)
+      {
+         if (work[s] > limit) Task[s] = 0;
+         else if (parent[s] > 0 && Task[parent[s]] > 0)
+            Task[s] = Task[parent[s]];
+         else
+         {
+            Ntasks++;
+            Task[s] = Ntasks;
+            Troot[Ntasks] = Xsuper[s+1] - 1;
+         }
+      }
+
+      /* List supernodes of each task in ascending order */
+      for (s=1; s<=Nsuper; s++)
+      {
+         t = Task[s];
+         if (t == 0) t = Ntasks + 1;
+         Xtask[t+1]++;
+      }
+      Xtask[1] = 0;
+      for (t=1; t<=Ntasks+1; t++) Xtask[t+1] += Xtask[t];
+      for (t=1; t<=Ntasks+1; t++) Terr[t] = Xtask[t];
+      for (s=1; s<=Nsuper; s++)
+      {
+         t = Task[s];
+         if (t == 0) t = Ntasks + 1;
+         i = Terr[t]++;
+         Tsuper[i] = s;
+      }
+   }
+   free(parent);
+   free(work);
+   return(errcode);
+}                        /* End of findtasks */
+
+
+int  linsolve(int n, double *Aii, double *Aij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+**          returns 0 if solution found, or index of            
+**          equation causing system to be ill-conditioned       
+** Purpose: solves sparse symmetric system of linear            
+**          equations using Cholesky factorization              
+**                                                              
+** NOTE:   This procedure assumes that the solution matrix has  
+**         been symbolically factorized with the positions of   
+**         the lower triangular, off-diagonal, non-zero coeffs. 
+**         stored in the following integer arrays:              
+**            XLNZ  (start position of each column in NZSUB)    
+**            NZSUB (row index of each non-zero in each column) 
+**         with Aij holding the value of each NZSUB entry in the
+**         same position (see mapcoeffs()), and its columns     
+**         grouped into supernodes by:                          
+**            Xsuper (first column of each supernode)           
+**            Super  (supernode that each column belongs to)    
+**                                                              
+**         Its work arrays are allocated once by createsparse() 
+**         and freed by freesparse(), so nothing gets allocated 
+**         here at steady state (see AllocBytes).              
+**                                                              
+**         With more than one solver thread the work is split   
+**         up by the independent subtrees found in findtasks()  
+**         (see factortasks() and solvetasks()). With a single  
+**         thread the supernodes are simply processed in order. 
+**                                                              
+**  This procedure has been adapted from subroutines GSFCT and  
+**  GSSLV in the book "Computer Solution of Large Sparse        
+**  Positive Definite Systems" by A. George and J. W-H Liu      
+**  (Prentice-Hall, 1981).                                      
+**--------------------------------------------------------------
+*/
+{
+   int    s;
+   int    errcode = 0;
+
+   /* Use work arrays allocated in createsparse(), */
+   /* only growing them if the system got larger.  */
+   AllocBytes = 0;
+   FactorUpdates = -1;
+   errcode = allocwork(n);
+   if (errcode)
+   {
+      errcode = -errcode;
+      goto ENDLINSOLVE;
+   }
+   memset(Lnk,0,(n+1)*sizeof(int));
+
+   /* Eliminate tree branches & series chains, */
+   /* leaving the reduced core matrix behind   */
+   errcode = elimchains(Aii, Aij);
+   if (errcode) goto ENDLINSOLVE;
+
+   /* Solve by independent subtrees if using multiple threads */
+   if (Threads > 1 && Ntasks > 1)
+   {
+      errcode = factortasks(n, Aii, Aij);
+      if (!errcode) solvetasks(Aii, Aij, B);
+      goto ENDLINSOLVE;
+   }
+
+   /* Numerical factorization of the core into L, */
+   /* one supernode at a time                     */
+   for (s=firstcore(); s<=Nsuper; s++)
+   {
+      errcode = factorsuper(s, Aii, Aij, Temp, Rel, FALSE);
+      if (errcode) goto ENDLINSOLVE;
+   }
+
+   /* Forward & backward substitution */
+   cholsolve(n, Aii, Aij, B);
+
+ENDLINSOLVE:
+   return(errcode);
+}                        /* End of linsolve */
+
+
+void  cholsolve(int n, double *Lii, double *Lij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Lii  = diagonal entries of factor L                 
+**          Lij  = non-zero off-diagonal entries of L           
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+** Purpose: solves L*L'*x = B by forward and backward           
+**          substitution                                        
+**--------------------------------------------------------------
+*/
+{
+   int    i, istop, istrt, isub, j;
+   double bj;
+
+   /* Foward substitution */
+   for (j=1; j<=n; j++)
+   {
+      bj = B[j]/Lii[j];
+      B[j] = bj;
+      istrt = XLNZ[j];
+      istop = XLNZ[j+1] - 1;
+      if (istop >= istrt)
+      {
+         for (i=istrt; i<=istop; i++)
+         {
+            isub = NZSUB[i];
+            B[isub] -= Lij[i]*bj;
+         }
+      }
+   }
+
+   /* Backward substitution */
+   for (j=n; j>=1; j--)
+   {
+      bj = B[j];
+      istrt = XLNZ[j];
+      istop = XLNZ[j+1] - 1;
+      if (istop >= istrt)
+      {
+         for (i=istrt; i<=istop; i++)
+         {
+            isub = NZSUB[i];
+            bj -= Lij[i]*B[isub];
+         }
+      }
+      B[j] = bj/Lii[j];
+   }
+}                        /* End of cholsolve */
+
+
+int  allocupdate(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: allocates the arrays used by updsolve() to keep a   
+**          Cholesky factor from one trial to the next          
+**--------------------------------------------------------------
+*/
+{
+   int j, k;
+   int errcode = 0;
+
+   Lii  = (double *) calloc(n+1, sizeof(double));
+   Lij  = (double *) calloc(XLNZ[n+1], sizeof(double));
+   Afii = (double *) calloc(n+1, sizeof(double));
+   Afij = (double *) calloc(XLNZ[n+1], sizeof(double));
+   Updx = (double *) calloc(3*(n+1), sizeof(double));
+   Updlist = (int *) calloc(2*(XLNZ[n+1]+n+1), sizeof(int));
+   ERRCODE(MEMCHECK(Lii));
+   ERRCODE(MEMCHECK(Lij));
+   ERRCODE(MEMCHECK(Afii));
+   ERRCODE(MEMCHECK(Afij));
+   ERRCODE(MEMCHECK(Updx));
+   ERRCODE(MEMCHECK(Updlist));
+
+   /* Estimate the work needed to factorize the matrix */
+   Factwork = 0.0;
+   for (j=1; j<=n; j++)
+   {
+      k = XLNZ[j+1] - XLNZ[j] + 1;
+      Factwork += (double)k*k;
+   }
+   Factored = FALSE;
+   return(errcode);
+}                        /* End of allocupdate */
+
+
+int  updsolve(int n, double *Aii, double *Aij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+**          returns 0 if solution found, or index of            
+**          equation causing system to be ill-conditioned       
+** Purpose: solves sparse symmetric system of linear            
+**          equations by updating the Cholesky factor of the    
+**          matrix from an earlier trial                        
+**                                                              
+** NOTE:   The factor (Lii, Lij) is of the matrix (Afii, Afij), 
+**         which is the solution matrix of an earlier trial     
+**         plus the rank-one updates made since. Only coeffs.   
+**         that changed by more than UpdateLimit (relative) are 
+**         updated, so the factor may be slightly out of date.  
+**         To keep this from affecting the solution, the update 
+**         to the current heads H is solved for instead:        
+**            (Lii,Lij)*dH = B - A*H                            
+**         so that once the heads stop changing they satisfy    
+**         A*H = B exactly. The matrix is factorized from       
+**         scratch (using linsolve()) for the first trial, when 
+**         updating would take more work than that, or when a   
+**         downdate might lose too much accuracy.               
+**         The number of rank-one updates made (or -1 if the    
+**         matrix was factorized) is saved in FactorUpdates.   
+**--------------------------------------------------------------
+*/
+{
+   int    i, m;
+   int    errcode = 0;
+   double *h, *y;
+
+   /* Update the factor for the coeffs. that changed */
+   if (Factored)
+   {
+      m = findupdates(n, Aii, Aij);
+      if (m >= 0 && applyupdates(n, Aij, m) == 0)
+      {
+         AllocBytes = 0;
+         FactorUpdates = m;
+
+         /* Solve for the change in heads */
+         h = Updx + (n+1);
+         y = h + (n+1);
+         for (i=1; i<=n; i++) h[i] = H[Order[i]];
+         matvec(n, Aii, Aij, h, y);
+         for (i=1; i<=n; i++) B[i] -= y[i];
+         cholsolve(n, Lii, Lij, B);
+         for (i=1; i<=n; i++) B[i] += h[i];
+         return(0);
+      }
+   }
+
+   /* Otherwise factorize the current matrix from scratch */
+   memcpy(Afii, Aii, (n+1)*sizeof(double));
+   memcpy(Afij, Aij, XLNZ[n+1]*sizeof(double));
+   memcpy(Lii, Aii, (n+1)*sizeof(double));
+   memcpy(Lij, Aij, XLNZ[n+1]*sizeof(double));
+   errcode = linsolve(n, Lii, Lij, B);
+   Factored = (errcode == 0);
+   return(errcode);
+}                        /* End of updsolve */
+
+
+int  findupdates(int n, double *Aii, double *Aij)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+** Output:  returns number of rank-one updates to make, or -1   
+**          if the matrix should be factorized from scratch     
+** Purpose: lists the changes between the solution matrix and   
+**          the matrix that the current factor belongs to       
+**                                                              
+** NOTE:   The matrix is a sum of terms w*(ei-ej)*(ei-ej)' for  
+**         each pair of connected rows i & j (w = -Aij) plus    
+**         terms d*ei*ei' for whatever is left on the diagonal  
+**         (links to tanks, emitters & valves). A change in any 
+**         of these terms is a rank-one update (if it grows) or 
+**         downdate (if it shrinks) of the factor. Updlist gets 
+**         the column of each term, followed by its position   
+**         in Aij (or 0 for a diagonal term). The search stops  
+**         as soon as the updates would take more work than     
+**         factorizing the matrix from scratch.                 
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, k, m;
+   double a, b, delta, work;
+   double *d, *f;
+
+   /* Find what's left on the diagonal of each matrix */
+   d = Updx + (n+1);
+   f = d + (n+1);
+   for (j=1; j<=n; j++)
+   {
+      d[j] = Aii[j];
+      f[j] = Afii[j];
+   }
+   for (j=1; j<=n; j++)
+   {
+      for (k=XLNZ[j]; k<XLNZ[j+1]; k++)
+      {
+         i = NZSUB[k];
+         d[j] += Aij[k];
+         d[i] += Aij[k];
+         f[j] += Afij[k];
+         f[i] += Afij[k];
+      }
+   }
+
+   /* List the off-diagonal terms that changed */
+   m = 0;
+   work = 0.0;
+   for (j=1; j<=n; j++)
+   {
+      for (k=XLNZ[j]; k<XLNZ[j+1]; k++)
+      {
+         a = Aij[k];
+         b = Afij[k];
+         delta = b - a;
+         if (ABS(delta) <= UpdateLimit*MAX(ABS(a),ABS(b))) continue;
+         i = NZSUB[k];
+         if (-delta > DOWNLIMIT*MIN(Afii[i],Afii[j])) return(-1);
+         Updlist[2*m] = j;
+         Updlist[2*m+1] = k;
+         m++;
+         work += pathwork(j);
+         if (UPDCOST*work > Factwork) return(-1);
+      }
+   }
+
+   /* List the diagonal terms that changed */
+   for (j=1; j<=n; j++)
+   {
+      delta = d[j] - f[j];
+      if (ABS(delta) <= UpdateLimit*MAX(Aii[j],Afii[j])) continue;
+      if (-delta > DOWNLIMIT*Afii[j]) return(-1);
+      Updlist[2*m] = j;
+      Updlist[2*m+1] = 0;
+      m++;
+      work += pathwork(j);
+      if (UPDCOST*work > Factwork) return(-1);
+   }
+   return(m);
+}                        /* End of findupdates */
+
+
+double  pathwork(int j)
+/*
+**--------------------------------------------------------------
+** Input:   j = column index                                    
+** Output:  returns the work needed for a rank-one update       
+** Purpose: counts the entries of the factor in the columns on  
+**          the path from column j to the root of its           
+**          elimination tree                                    
+**--------------------------------------------------------------
+*/
+{
+   double work = 0.0;
+   while (j > 0)
+   {
+      work += XLNZ[j+1] - XLNZ[j] + 1;
+      if (XLNZ[j+1] > XLNZ[j]) j = NZSUB[XLNZ[j]];
+      else j = 0;
+   }
+   return(work);
+}                        /* End of pathwork */
+
+
+int  applyupdates(int n, double *Aij, int m)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aij  = non-zero off-diagonal entries of matrix      
+**          m    = number of terms in Updlist                   
+** Output:  returns 0 if successful, or index of column where   
+**          a downdate failed                                   
+** Purpose: makes the rank-one updates listed by findupdates()  
+**          to the factor (Lii, Lij) and to its matrix          
+**          (Afii, Afij)                                        
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, k, t;
+   int    errcode = 0;
+   double delta, sigma, *d, *f, *x;
+
+   x = Updx;
+   d = x + (n+1);
+   f = d + (n+1);
+   for (t=0; t<m; t++)
+   {
+      j = Updlist[2*t];
+      k = Updlist[2*t+1];
+
+      /* Term w*(ej-ei)*(ej-ei)' for off-diagonal entry k */
+      if (k > 0)
+      {
+         i = NZSUB[k];
+         delta = Afij[k] - Aij[k];
+         x[j] = sqrt(ABS(delta));
+         x[i] = -x[j];
+         Afij[k] = Aij[k];
+         Afii[i] += delta;
+         Afii[j] += delta;
+      }
+
+      /* Term d*ej*ej' for what's left on the diagonal */
+      else
+      {
+         delta = d[j] - f[j];
+         x[j] = sqrt(ABS(delta));
+         Afii[j] += delta;
+      }
+      sigma = (delta > 0.0) ? 1.0 : -1.0;
+      errcode = rankone(j, sigma);
+      if (errcode) break;
+   }
+
+   /* A failed update leaves the factor unusable */
+   if (errcode)
+   {
+      memset(x, 0, (n+1)*sizeof(double));
+      Factored = FALSE;
+   }
+   return(errcode);
+}                        /* End of applyupdates */
+
+
+int  rankone(int j, double sigma)
+/*
+**--------------------------------------------------------------
+** Input:   j     = first non-zero row of update vector x       
+**          sigma = 1 for an update, -1 for a downdate          
+** Output:  returns 0 if successful, or index of column where   
+**          the downdated matrix lost positive definiteness     
+** Purpose: changes factor L so that L*L' becomes               
+**          L*L' + sigma*x*x'                                   
+**                                                              
+** NOTE:   The non-zeros of x must lie on the path from column j
+**         to the root of the elimination tree, which is all    
+**         that the update changes. x is held in Updx and is    
+**         left all zero.                                       
+**--------------------------------------------------------------
+*/
+{
+   int    i, k;
+   double c, s, r, ljj, xj, *x;
+
+   x = Updx;
+   while (j > 0)
+   {
+      xj = x[j];
+      if (xj != 0.0)
+      {
+         ljj = Lii[j];
+         r = ljj*ljj + sigma*xj*xj;
+         if (r <= 0.0) return(j);
+         r = sqrt(r);
+         c = r/ljj;
+         s = xj/ljj;
+         Lii[j] = r;
+         x[j] = 0.0;
+         for (i=XLNZ[j]; i<XLNZ[j+1]; i++)
+         {
+            k = NZSUB[i];
+            Lij[i] = (Lij[i] + sigma*s*x[k])/c;
+            x[k] = c*x[k] - s*Lij[i];
+         }
+      }
+      if (XLNZ[j+1] > XLNZ[j]) j = NZSUB[XLNZ[j]];
+      else j = 0;
+   }
+   return(0);
+}                        /* End of rankone */
+
+
+int  elimchains(double *Aii, double *Aij)
+/*
+**--------------------------------------------------------------
+** Input:   Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+** Output:  Aii, Aij = columns of factor L for the tree and     
+**          chain columns, with the rest of the matrix reduced  
+**          to the Schur complement of the core                 
+**          returns 0 if successful, or index of column         
+**          causing system to be ill-conditioned                
+** Purpose: eliminates the leading Nchain columns found by      
+**          findchains()                                        
+**--------------------------------------------------------------
+*/
+{
+   int    j, k, r1, r2;
+   double diagj, l1, l2;
+
+   for (j=1; j<=Nchain; j++)
+   {
+      diagj = Aii[j];
+      if (diagj <= 0.0) return(j);     /* Check for ill-conditioning */
+      diagj = sqrt(diagj);
+      Aii[j] = diagj;
+      k = XLNZ[j];
+      if (k == XLNZ[j+1]) continue;
+      l1 = Aij[k]/diagj;
+      Aij[k] = l1;
+      r1 = NZSUB[k];
+      Aii[r1] -= l1*l1;
+      if (k+1 == XLNZ[j+1]) continue;
+      l2 = Aij[k+1]/diagj;
+      Aij[k+1] = l2;
+      r2 = NZSUB[k+1];
+      Aii[r2] -= l2*l2;
+      Aij[Pfill[j]] -= l1*l2;
+   }
+   return(0);
+}                        /* End of elimchains */
+
+
+int  firstcore()
+/*
+**--------------------------------------------------------------
+** Input:   none                                                
+** Output:  returns index of first supernode after the tree and 
+**          chain columns                                       
+**--------------------------------------------------------------
+*/
+{
+   if (Nchain == 0) return(1);
+   return(Super[Nchain] + 1);
+}                        /* End of firstcore */
+
+
+int  factorsuper(int s, double *Aii, double *Aij, double *temp, int *rel,
+                 int defer)
+/*
+**--------------------------------------------------------------
+** Input:   s     = supernode index                             
+**          Aii   = diagonal entries of solution matrix         
+**          Aij   = non-zero off-diagonal entries of matrix     
+**          temp  = work array for supernode's panel            
+**          rel   = work array for rows of panel                
+**          defer = TRUE if linking columns to supernodes       
+**                  outside of s's task is put off              
+** Output:  Aii, Aij = columns of factor L for supernode s      
+**          returns 0 if successful, or index of column         
+**          causing system to be ill-conditioned                
+** Purpose: computes the columns of the Cholesky factor that    
+**          belong to supernode s                               
+**                                                              
+** NOTE:   Modifications to the supernode's columns f..l are    
+**         saved in dense panel 'temp' (m rows by w columns,    
+**         stored by column) whose rows are row f followed by   
+**         the rows of L(*,f). A supernode of a single column   
+**         reduces to the original column algorithm.            
+**--------------------------------------------------------------
+*/
+{
+   int    i, istop, istrt, isub, j, k, kfirst, newk;
+   int    f, l, w, m, c, cc, r;
+   double bj, diagj, ljk;
+   double *pc, *pk;
+
+   f = Xsuper[s];
+   l = Xsuper[s+1] - 1;
+   w = l - f + 1;
+   istrt = XLNZ[f];
+   istop = XLNZ[f+1] - 1;
+   m = istop - istrt + 2;
+   rel[f] = 0;
+   for (i=istrt; i<=istop; i++) rel[NZSUB[i]] = i - istrt + 1;
+   memset(temp,0,m*w*sizeof(double));
+
+   /* For each column L(*,k) outside of supernode s */
+   /* that affects L(*,f..l):                       */
+   newk = Lnk[f];
+   k = newk;
+   while (k != 0)
+   {
+
+      /* Outer product modification of the panel by L(*,k)   */
+      /* for each of its rows that is a column of supernode. */
+      newk = Lnk[k];
+      istop = XLNZ[k+1] - 1;
+      for (kfirst = First[k]; kfirst <= istop; kfirst++)
+      {
+         if (NZSUB[kfirst] > l) break;
+         ljk = Aij[kfirst];
+         pc = temp + (NZSUB[kfirst] - f)*m;
+         for (i=kfirst; i<=istop; i++)
+         {
+            isub = NZSUB[i];
+            pc[rel[isub]] += Aij[i]*ljk;
+         }
+      }
+
+      /* Update vectors 'First' and 'Lnk' */
+      /* for future modification steps.   */
+      if (kfirst <= istop) linkcol(k, kfirst, defer);
+      k = newk;
+   }
+
+   /* Apply the modifications accumulated in the panel */
+   /* to each column L(*,j) of the supernode in turn.  */
+   for (c=0; c<w; c++)
+   {
+      j = f + c;
+      pc = temp + c*m;
+      diagj = Aii[j] - pc[c];
+      if (diagj <= 0.0) return(j);     /* Check for ill-conditioning */
+      diagj = sqrt(diagj);
+      Aii[j] = diagj;
+      istrt = XLNZ[j];
+      istop = XLNZ[j+1] - 1;
+      for (i=istrt, r=c+1; i<=istop; i++, r++)
+      {
+         bj = (Aij[i] - pc[r])/diagj;
+         Aij[i] = bj;
+         pc[r] = bj;
+      }
+
+      /* Column j shares its rows with the rest of the */
+      /* supernode, so its modification of the later   */
+      /* columns is a dense update of the panel.       */
+      for (cc=c+1; cc<w; cc++)
+      {
+         pk = temp + cc*m;
+         ljk = pc[cc];
+         for (r=cc; r<m; r++) pk[r] += pc[r]*ljk;
+      }
+
+      /* Link column j to the supernode */
+      /* of its first row below l.      */
+      i = istrt + (l - j);
+      if (i <= istop) linkcol(j, i, defer);
+   }
+   return(0);
+}                        /* End of factorsuper */
+
+
+void  linkcol(int k, int i, int defer)
+/*
+**--------------------------------------------------------------
+** Input:   k     = column index                                
+**          i     = position in NZSUB of next row of column k   
+**                  that modifies a later column                
+**          defer = TRUE if linking to a supernode outside of   
+**                  k's task is put off                         
+** Output:  none                                                
+** Purpose: adds column k to the list of columns that modify    
+**          the supernode containing row NZSUB[i]               
+**--------------------------------------------------------------
+*/
+{
+   int isub;
+   First[k] = i;
+   isub = Xsuper[Super[NZSUB[i]]];
+   if (defer && Task[Super[isub]] != Task[Super[k]]) Pending[k] = 1;
+   else
+   {
+      Lnk[k] = Lnk[isub];
+      Lnk[isub] = k;
+   }
+}                        /* End of linkcol */
+
+
+int  factortasks(int n, double *Aii, double *Aij)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+** Output:  Aii, Aij = Cholesky factor L                        
+**          returns 0 if successful, or index of column         
+**          causing system to be ill-conditioned                
+** Purpose: factorizes the solution matrix by first doing each  
+**          independent subtree (in parallel when compiled with 
+**          OpenMP) and then the top part of the tree           
+**--------------------------------------------------------------
+*/
+{
+   int    i, k, s0, t;
+   int    errcode = 0;
+
+   /* Factorize each task's subtree, skipping the columns */
+   /* done by elimchains(), using the work arrays of the   */
+   /* thread it runs on. Links from a subtree to the top   */
+   /* part are held back in 'Pending'.                     */
+   memset(Pending,0,(n+1)*sizeof(char));
+   s0 = firstcore();
+#ifdef _OPENMP
+#pragma omp parallel for private(k) schedule(dynamic) num_threads(Threads)
+#endif
+   for (t=1; t<=Ntasks; t++)
+   {
+      int tid = 0;
+#ifdef _OPENMP
+      tid = omp_get_thread_num();
+#endif
+      Terr[t] = 0;
+      for (k=Xtask[t]; k<Xtask[t+1]; k++)
+      {
+         if (Tsuper[k] < s0) continue;
+         Terr[t] = factorsuper(Tsuper[k], Aii, Aij, Temp + tid*Npanel,
+                               Rel + tid*(n+1), TRUE);
+         if (Terr[t]) break;
+      }
+   }
+
+   /* Report the lowest column that caused ill-conditioning */
+   for (t=1; t<=Ntasks; t++)
+   {
+      if (Terr[t] && (errcode == 0 || Terr[t] < errcode)) errcode = Terr[t];
+   }
+   if (errcode) return(errcode);
+
+   /* Link the held back columns in column order so */
+   /* the results don't depend on thread timing.    */
+   for (k=1; k<=n; k++)
+   {
+      if (Pending[k])
+      {
+         Pending[k] = 0;
+         i = Xsuper[Super[NZSUB[First[k]]]];
+         Lnk[k] = Lnk[i];
+         Lnk[i] = k;
+      }
+   }
+
+   /* Factorize the top part of the tree */
+   for (k=Xtask[Ntasks+1]; k<Xtask[Ntasks+2]; k++)
+   {
+      if (Tsuper[k] < s0) continue;
+      errcode = factorsuper(Tsuper[k], Aii, Aij, Temp, Rel, FALSE);
+      if (errcode) break;
+   }
+   return(errcode);
+}                        /* End of factortasks */
+
+
+void  solvetasks(double *Aii, double *Aij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   Aii  = diagonal entries of factor L                 
+**          Aij  = non-zero off-diagonal entries of L           
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+** Purpose: carries out the forward and backward substitution   
+**          steps by independent subtrees                       
+**                                                              
+** NOTE:   The rows of a column in a task's subtree that are no 
+**         greater than the subtree's last column (Troot) also  
+**         belong to that subtree, while the rest belong to the 
+**         top part of the tree. During forward substitution    
+**         each task only updates its own rows, and updates to  
+**         the top part are made afterwards in column order.    
+**         Backward substitution does the top part first, after 
+**         which each task only needs values it computes itself.
+**--------------------------------------------------------------
+*/
+{
+   int    i, istop, j, k, s, t;
+   double bj;
 
-/************************ END OF SMATRIX.C ************************/
+   /* Forward substitution within each task */
+#ifdef _OPENMP
+#pragma omp parallel for private(i,istop,j,k,s,bj) schedule(dynamic) num_threads(Threads)
+#endif
+   for (t=1; t<=Ntasks; t++)
+   {
+      for (k=Xtask[t]; k<Xtask[t+1]; k++)
+      {
+         s = Tsuper[k];
+         for (j=Xsuper[s]; j<Xsuper[s+1]; j++)
+         {
+            bj = B[j]/Aii[j];
+            B[j] = bj;
+            istop = XLNZ[j+1] - 1;
+            for (i=XLNZ[j]; i<=istop && NZSUB[i]<=Troot[t]; i++)
+               B[NZSUB[i]] -= Aij[i]*bj;
+         }
+      }
+   }
+
+   /* Updates from the tasks to the top part of the tree */
+   for (t=1; t<=Ntasks; t++)
+   {
+      for (k=Xtask[t]; k<Xtask[t+1]; k++)
+      {
+         s = Tsuper[k];
+         for (j=Xsuper[s]; j<Xsuper[s+1]; j++)
+         {
+            istop = XLNZ[j+1] - 1;
+            for (i=XLNZ[j]; i<=istop; i++)
+            {
+               if (NZSUB[i] > Troot[t]) B[NZSUB[i]] -= Aij[i]*B[j];
+            }
+         }
+      }
+   }
+
+   /* Forward substitution for the top part */
+   for (k=Xtask[Ntasks+1]; k<Xtask[Ntasks+2]; k++)
+   {
+      s = Tsuper[k];
+      for (j=Xsuper[s]; j<Xsuper[s+1]; j++)
+      {
+         bj = B[j]/Aii[j];
+         B[j] = bj;
+         istop = XLNZ[j+1] - 1;
+         for (i=XLNZ[j]; i<=istop; i++) B[NZSUB[i]] -= Aij[i]*bj;
+      }
+   }
+
+   /* Backward substitution for the top part */
+   for (k=Xtask[Ntasks+2]-1; k>=Xtask[Ntasks+1]; k--)
+   {
+      s = Tsuper[k];
+      for (j=Xsuper[s+1]-1; j>=Xsuper[s]; j--)
+      {
+         bj = B[j];
+         istop = XLNZ[j+1] - 1;
+         for (i=XLNZ[j]; i<=istop; i++) bj -= Aij[i]*B[NZSUB[i]];
+         B[j] = bj/Aii[j];
+      }
+   }
+
+   /* Backward substitution within each task */
+#ifdef _OPENMP
+#pragma omp parallel for private(i,istop,j,k,s,bj) schedule(dynamic) num_threads(Threads)
+#endif
+   for (t=1; t<=Ntasks; t++)
+   {
+      for (k=Xtask[t+1]-1; k>=Xtask[t]; k--)
+      {
+         s = Tsuper[k];
+         for (j=Xsuper[s+1]-1; j>=Xsuper[s]; j--)
+         {
+            bj = B[j];
+            istop = XLNZ[j+1] - 1;
+            for (i=XLNZ[j]; i<=istop; i++) bj -= Aij[i]*B[NZSUB[i]];
+            B[j] = bj/Aii[j];
+         }
+      }
+   }
+}                        /* End of solvetasks */
+
+
+int  allocmixed(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: allocates the arrays used by mixsolve()             
+**--------------------------------------------------------------
+*/
+{
+   int errcode = 0;
+
+   Sii = (float *) calloc(n+1, sizeof(float));
+   Sij = (float *) calloc(XLNZ[n+1], sizeof(float));
+   Refwork = (double *) calloc(4*(n+1), sizeof(double));
+   ERRCODE(MEMCHECK(Sii));
+   ERRCODE(MEMCHECK(Sij));
+   ERRCODE(MEMCHECK(Refwork));
+   return(errcode);
+}                        /* End of allocmixed */
+
+
+int  mixsolve(int n, double *Aii, double *Aij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+**          returns 0 if solution found, or index of            
+**          equation causing system to be ill-conditioned       
+** Purpose: solves sparse symmetric system of linear            
+**          equations using a single precision Cholesky factor  
+**          and iterative refinement                            
+**                                                              
+** NOTE:   The tree and chain columns are first eliminated in   
+**         double precision by elimchains(). Their effect on    
+**         the core rows (a difference of nearly equal terms    
+**         for a dead-end branch) would be lost in single       
+**         precision. This leaves the core's Schur complement S 
+**         in the core rows of Aii and Aij.                     
+**                                                              
+**         The factor of S is then computed and stored in       
+**         single precision (Sii, Sij), which halves the memory 
+**         streamed through when factorizing. Each refinement   
+**         step solves L*L'*d = r for the residual r = y - S*x  
+**         of the current core solution x, computed in double   
+**         precision. This stops once, for every core row j,    
+**            |r[j]| <= (|S|*|x| + |y|)[j] * sqrt(n) * DBL_EPSILON
+**         i.e. each row of S*x = y holds to within roundoff,   
+**         which is as much as linsolve() can promise. The test 
+**         is made row by row since the heads of nodes cut off  
+**         by closed links can be many orders of magnitude      
+**         larger than the others, so that a test on max|r|     
+**         would accept large errors in the heads that matter.  
+**         The heads at the chain junctions are then found in   
+**         double precision as usual.                           
+**                                                              
+**         If the single precision factorization fails, or a    
+**         step does not at least halve the residual left by    
+**         the one before it, S is factorized in double         
+**         precision instead, as linsolve() would do.           
+**                                                              
+**         The number of refinement steps made is saved in      
+**         RefineSteps (-1 if the fallback had to be used).    
+**--------------------------------------------------------------
+*/
+{
+   int    i, istop, iter, j, s;
+   int    errcode = 0;
+   double *y, *x, *r, *d;
+   double bj, rmax, rlast, tol;
+
+   /* Use work arrays allocated in createsparse() */
+   AllocBytes = 0;
+   FactorUpdates = -1;
+   RefineSteps = -1;
+   errcode = allocwork(n);
+   if (errcode) return(-errcode);
+   memset(Lnk,0,(n+1)*sizeof(int));
+   y = Refwork;
+   x = y + n + 1;
+   r = x + n + 1;
+   d = r + n + 1;
+
+   /* Eliminate tree branches & series chains in double */
+   /* precision and do their forward substitution.      */
+   errcode = elimchains(Aii, Aij);
+   if (errcode) return(errcode);
+   memcpy(y,B,(n+1)*sizeof(double));
+   for (j=1; j<=Nchain; j++)
+   {
+      bj = y[j]/Aii[j];
+      y[j] = bj;
+      istop = XLNZ[j+1] - 1;
+      for (i=XLNZ[j]; i<=istop; i++) y[NZSUB[i]] -= Aij[i]*bj;
+   }
+
+   /* Factorize a single precision copy of S */
+   for (j=Nchain+1; j<=n; j++) Sii[j] = (float)Aii[j];
+   for (i=XLNZ[Nchain+1]; i<XLNZ[n+1]; i++) Sij[i] = (float)Aij[i];
+   if (sfactor() == 0)
+   {
+      tol = sqrt((double)n)*DBL_EPSILON;
+
+      /* Refine x starting from 0, for which r = y. (The  */
+      /* chain entries of x stay 0 so that matvec() only  */
+      /* picks up the products of S with the core rows.)  */
+      memset(x,0,(n+1)*sizeof(double));
+      memcpy(r,y,(n+1)*sizeof(double));
+      rlast = 0.0;
+      for (iter=1; iter<=MAXREFINE; iter++)
+      {
+         memcpy(d,r,(n+1)*sizeof(double));
+         scholsolve(n, Sii, Sij, d);
+         for (j=Nchain+1; j<=n; j++) x[j] += d[j];
+
+         /* Find new residual & the largest one relative */
+         /* to the size of the terms in its row           */
+         matvec(n, Aii, Aij, x, r);
+         for (j=Nchain+1; j<=n; j++) d[j] = ABS(Aii[j]*x[j]) + ABS(y[j]);
+         for (j=Nchain+1; j<=n; j++)
+         {
+            for (i=XLNZ[j]; i<XLNZ[j+1]; i++)
+            {
+               d[NZSUB[i]] += ABS(Aij[i]*x[j]);
+               d[j] += ABS(Aij[i]*x[NZSUB[i]]);
+            }
+         }
+         rmax = 0.0;
+         for (j=Nchain+1; j<=n; j++)
+         {
+            r[j] = y[j] - r[j];
+            if (d[j] > 0.0) rmax = MAX(rmax, ABS(r[j])/d[j]);
+         }
+
+         /* Check for convergence or stalling */
+         if (rmax <= tol)
+         {
+            RefineSteps = iter;
+            break;
+         }
+         if (iter > 1 && rmax > 0.5*rlast) break;
+         rlast = rmax;
+      }
+   }
+
+   /* Fall back to a double precision factor of S */
+   if (RefineSteps < 0)
+   {
+      memset(Lnk,0,(n+1)*sizeof(int));
+      for (s=firstcore(); s<=Nsuper; s++)
+      {
+         errcode = factorsuper(s, Aii, Aij, Temp, Rel, FALSE);
+         if (errcode) return(errcode);
+      }
+      cholsolve(n, Aii, Aij, B);
+      return(0);
+   }
+
+   /* Backward substitution for the chain columns */
+   for (j=Nchain+1; j<=n; j++) B[j] = x[j];
+   for (j=Nchain; j>=1; j--)
+   {
+      bj = y[j];
+      istop = XLNZ[j+1] - 1;
+      for (i=XLNZ[j]; i<=istop; i++) bj -= Aij[i]*B[NZSUB[i]];
+      B[j] = bj/Aii[j];
+   }
+   return(0);
+}                        /* End of mixsolve */
+
+
+int  sfactor()
+/*
+**--------------------------------------------------------------
+** Input:   none                                                
+** Output:  Sii, Sij = single precision Cholesky factor L of    
+**          the core rows                                       
+**          returns 0 if successful, or index of column         
+**          causing system to be ill-conditioned                
+** Purpose: factorizes the single precision copy of the core's  
+**          Schur complement held in Sii and Sij                
+**                                                              
+** NOTE:   The supernodes are always done in order, by a        
+**         single thread. Sums are still formed in double       
+**         precision.                                           
+**--------------------------------------------------------------
+*/
+{
+   int    j, s;
+
+   for (s=firstcore(); s<=Nsuper; s++)
+   {
+      j = sfactorsuper(s, Sii, Sij);
+      if (j) return(j);
+   }
+   return(0);
+}                        /* End of sfactor */
+
+
+int  sfactorsuper(int s, float *Lii, float *Lij)
+/*
+**--------------------------------------------------------------
+** Input:   s    = supernode index                              
+**          Lii  = diagonal entries of single precision matrix  
+**          Lij  = off-diagonal entries of single precision     
+**                 matrix                                       
+** Output:  Lii, Lij = columns of factor L for supernode s      
+**          returns 0 if successful, or index of column         
+**          causing system to be ill-conditioned                
+** Purpose: single precision version of factorsuper()           
+**--------------------------------------------------------------
+*/
+{
+   int    i, istop, istrt, j, k, kfirst, newk;
+   int    f, l, w, m, c, cc, r;
+   double bj, diagj, ljk;
+   double *pc, *pk;
+
+   f = Xsuper[s];
+   l = Xsuper[s+1] - 1;
+   w = l - f + 1;
+   istrt = XLNZ[f];
+   istop = XLNZ[f+1] - 1;
+   m = istop - istrt + 2;
+   Rel[f] = 0;
+   for (i=istrt; i<=istop; i++) Rel[NZSUB[i]] = i - istrt + 1;
+   memset(Temp,0,m*w*sizeof(double));
+
+   /* Modify the panel by each column L(*,k) outside of */
+   /* supernode s that affects L(*,f..l)                */
+   k = Lnk[f];
+   while (k != 0)
+   {
+      newk = Lnk[k];
+      istop = XLNZ[k+1] - 1;
+      for (kfirst = First[k]; kfirst <= istop; kfirst++)
+      {
+         if (NZSUB[kfirst] > l) break;
+         ljk = Lij[kfirst];
+         pc = Temp + (NZSUB[kfirst] - f)*m;
+         for (i=kfirst; i<=istop; i++) pc[Rel[NZSUB[i]]] += Lij[i]*ljk;
+      }
+      if (kfirst <= istop) linkcol(k, kfirst, FALSE);
+      k = newk;
+   }
+
+   /* Apply the modifications to each column of the supernode */
+   for (c=0; c<w; c++)
+   {
+      j = f + c;
+      pc = Temp + c*m;
+      diagj = Lii[j] - pc[c];
+      if (diagj <= 0.0) return(j);
+      diagj = sqrt(diagj);
+      Lii[j] = (float)diagj;
+      istrt = XLNZ[j];
+      istop = XLNZ[j+1] - 1;
+      for (i=istrt, r=c+1; i<=istop; i++, r++)
+      {
+         bj = (Lij[i] - pc[r])/diagj;
+         Lij[i] = (float)bj;
+         pc[r] = bj;
+      }
+      for (cc=c+1; cc<w; cc++)
+      {
+         pk = Temp + cc*m;
+         ljk = pc[cc];
+         for (r=cc; r<m; r++) pk[r] += pc[r]*ljk;
+      }
+      i = istrt + (l - j);
+      if (i <= istop) linkcol(j, i, FALSE);
+   }
+   return(0);
+}                        /* End of sfactorsuper */
+
+
+void  scholsolve(int n, float *Lii, float *Lij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Lii  = diagonal entries of single precision factor  
+**          Lij  = off-diagonal entries of single precision     
+**                 factor                                       
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+** Purpose: single precision version of cholsolve() for the     
+**          core rows left by elimchains(), with the solution   
+**          kept in double precision                            
+**--------------------------------------------------------------
+*/
+{
+   int    i, istop, j;
+   double bj;
+
+   /* Foward substitution */
+   for (j=Nchain+1; j<=n; j++)
+   {
+      bj = B[j]/Lii[j];
+      B[j] = bj;
+      istop = XLNZ[j+1] - 1;
+      for (i=XLNZ[j]; i<=istop; i++) B[NZSUB[i]] -= Lij[i]*bj;
+   }
+
+   /* Backward substitution */
+   for (j=n; j>Nchain; j--)
+   {
+      bj = B[j];
+      istop = XLNZ[j+1] - 1;
+      for (i=XLNZ[j]; i<=istop; i++) bj -= Lij[i]*B[NZSUB[i]];
+      B[j] = bj/Lii[j];
+   }
+}                        /* End of scholsolve */
+
+
+int  allocpcg(int n)
+/*
+**--------------------------------------------------------------
+** Input:   n = number of rows in solution matrix               
+** Output:  returns error code                                  
+** Purpose: allocates the incomplete Cholesky factor and work   
+**          vectors used by pcgsolve()                          
+**--------------------------------------------------------------
+*/
+{
+   int errcode = 0;
+   Mii     = (double *) calloc(n+1, sizeof(double));
+   Mij     = (double *) calloc(XLNZ[n+1], sizeof(double));
+   Pcgwork = (double *) calloc(5*(n+1), sizeof(double));
+   Rel     = (int *)    calloc(n+1, sizeof(int));
+   ERRCODE(MEMCHECK(Mii));
+   ERRCODE(MEMCHECK(Mij));
+   ERRCODE(MEMCHECK(Pcgwork));
+   ERRCODE(MEMCHECK(Rel));
+   return(errcode);
+}                        /* End of allocpcg */
+
+
+int  pcgsolve(int n, double *Aii, double *Aij, double *B)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+**          B    = right hand side coeffs.                      
+** Output:  B    = solution values                              
+**          returns 0 if solution found, -1 if the iterations   
+**          did not converge, or index of equation causing      
+**          system to be ill-conditioned                        
+** Purpose: solves sparse symmetric system of linear            
+**          equations by the conjugate gradient method with     
+**          an incomplete Cholesky preconditioner               
+**                                                              
+** NOTE:   The matrix is stored in XLNZ, NZSUB & Aij the same   
+**         way as for linsolve(), except that no fill-ins were  
+**         added (see reordernodes()). The iterations start     
+**         from the current nodal heads, i.e. the solution of   
+**         the previous trial, and stop once the flow changes   
+**         that the preconditioned residual (an estimate of the 
+**         error in head) would cause add up to less than       
+**         PCGTOL*Hacc times the total flow, so that netsolve() 
+**         never sees the error of the linear solution as part  
+**         of its relative flow change.                         
+**         If that is not reached in n iterations, or the matrix
+**         is found not to be positive definite, B is left as   
+**         it was & -1 is returned so that the caller can use   
+**         the direct solver instead.                           
+**         The iterations made are saved in PcgIterations.     
+**--------------------------------------------------------------
+*/
+{
+   int    i, iter, errcode;
+   double *x, *r, *z, *p, *q;
+   double alpha, beta, pq, rz, rznew, tol;
+
+   AllocBytes = 0;
+   PcgIterations = 0;
+   x = Pcgwork;
+   r = x + (n+1);
+   z = r + (n+1);
+   p = z + (n+1);
+   q = p + (n+1);
+
+   /* Factorize the preconditioner */
+   errcode = icfactor(n, Aii, Aij);
+   if (errcode) return(errcode);
+
+   /* Tolerance on flow errors, from the total flow */
+   tol = 0.0;
+   for (i=1; i<=Nlinks; i++) tol += ABS(Q[i]);
+   tol = PCGTOL*Hacc*MAX(tol, 1.0);
+
+   /* Initial residual using current heads as a first guess */
+   for (i=1; i<=n; i++) x[i] = H[Order[i]];
+   matvec(n, Aii, Aij, x, q);
+   for (i=1; i<=n; i++) r[i] = B[i] - q[i];
+   icsolve(n, r, z);
+   rz = 0.0;
+   for (i=1; i<=n; i++)
+   {
+      p[i] = z[i];
+      rz += r[i]*z[i];
+   }
+
+   /* Conjugate gradient iterations */
+   for (iter=1; iter<=n; iter++)
+   {
+      if (pcgresid(n, z) <= tol) break;
+      matvec(n, Aii, Aij, p, q);
+      pq = 0.0;
+      for (i=1; i<=n; i++) pq += p[i]*q[i];
+      if (pq <= 0.0) break;
+      alpha = rz/pq;
+      for (i=1; i<=n; i++)
+      {
+         x[i] += alpha*p[i];
+         r[i] -= alpha*q[i];
+      }
+      icsolve(n, r, z);
+      rznew = 0.0;
+      for (i=1; i<=n; i++) rznew += r[i]*z[i];
+      beta = rznew/rz;
+      rz = rznew;
+      for (i=1; i<=n; i++) p[i] = z[i] + beta*p[i];
+      PcgIterations = iter;
+   }
+   if (pcgresid(n, z) > tol) return(-1);
+   for (i=1; i<=n; i++) B[i] = x[i];
+   return(0);
+}                        /* End of pcgsolve */
+
+
+double  pcgresid(int n, double *z)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          z    = preconditioned residual vector               
+** Output:  returns total flow error of the residual            
+** Purpose: estimates the error in link flows that a conjugate  
+**          gradient solution would cause, taking z as the      
+**          error in the heads of the junctions                 
+**                                                              
+** NOTE:   The flow error of a link is P (1 / (dh/dQ)) times    
+**         the difference in head error between its end nodes.  
+**         Tanks & reservoirs have no head error.               
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, k;
+   double dh, qerr = 0.0;
+
+   for (k=1; k<=Nlinks; k++)
+   {
+      i = Link[k].N1;
+      j = Link[k].N2;
+      dh = 0.0;
+      if (i <= n) dh += z[Row[i]];
+      if (j <= n) dh -= z[Row[j]];
+      qerr += P[k]*ABS(dh);
+   }
+   return(qerr);
+}                        /* End of pcgresid */
+
+
+int  icfactor(int n, double *Aii, double *Aij)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+** Output:  returns 0 if successful, or index of row causing    
+**          system to be ill-conditioned                        
+** Purpose: computes the incomplete Cholesky factor (with no    
+**          fill-in) of the solution matrix in Mii & Mij        
+**                                                              
+** NOTE:   Updates that would fall outside of the matrix's      
+**         non-zero pattern are dropped. The solution matrix is 
+**         a diagonally dominant M-matrix, for which this never 
+**         breaks down unless the matrix itself is singular.    
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, k, l, m;
+   double d, ljk;
+
+   memcpy(Mii, Aii, (n+1)*sizeof(double));
+   memcpy(Mij, Aij, XLNZ[n+1]*sizeof(double));
+   memset(Rel, 0, (n+1)*sizeof(int));
+   for (k=1; k<=n; k++)
+   {
+      d = Mii[k];
+      if (d <= 0.0) return(k);
+      d = sqrt(d);
+      Mii[k] = d;
+      for (i=XLNZ[k]; i<XLNZ[k+1]; i++) Mij[i] /= d;
+
+      /* Modify each later column j that column k touches, */
+      /* at the rows of column j that column k also has.   */
+      for (i=XLNZ[k]; i<XLNZ[k+1]; i++)
+      {
+         j = NZSUB[i];
+         ljk = Mij[i];
+         Mii[j] -= ljk*ljk;
+         for (m=XLNZ[j]; m<XLNZ[j+1]; m++) Rel[NZSUB[m]] = m;
+         for (l=i+1; l<XLNZ[k+1]; l++)
+         {
+            m = Rel[NZSUB[l]];
+            if (m > 0) Mij[m] -= Mij[l]*ljk;
+         }
+         for (m=XLNZ[j]; m<XLNZ[j+1]; m++) Rel[NZSUB[m]] = 0;
+      }
+   }
+   return(0);
+}                        /* End of icfactor */
+
+
+void  icsolve(int n, double *r, double *z)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          r    = residual vector                              
+** Output:  z    = preconditioned residual                      
+** Purpose: solves M*z = r where M is the incomplete Cholesky   
+**          factorization of the solution matrix                
+**--------------------------------------------------------------
+*/
+{
+   memcpy(z, r, (n+1)*sizeof(double));
+   cholsolve(n, Mii, Mij, z);
+}                        /* End of icsolve */
+
+
+void  matvec(int n, double *Aii, double *Aij, double *x, double *y)
+/*
+**--------------------------------------------------------------
+** Input:   n    = number of equations                          
+**          Aii  = diagonal entries of solution matrix          
+**          Aij  = non-zero off-diagonal entries of matrix      
+**          x    = vector of values                             
+** Output:  y    = product A*x                                  
+** Purpose: multiplies the symmetric solution matrix, stored by 
+**          its lower triangle, with a vector                   
+**--------------------------------------------------------------
+*/
+{
+   int    i, j, r;
 
+   for (j=1; j<=n; j++) y[j] = Aii[j]*x[j];
+   for (j=1; j<=n; j++)
+   {
+      for (i=XLNZ[j]; i<XLNZ[j+1]; i++)
+      {
+         r = NZSUB[i];
+         y[r] += Aij[i]*x[j];
+         y[j] += Aij[i]*x[r];
+      }
+   }
+}                        /* End of matvec */
+
+
+/************************ END OF SMATRIX.C ************************/
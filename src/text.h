@@ -139,6 +139,25 @@ AUTHOR:     L. Rossman
 #define   w_CHECKFREQ   "CHECKFREQ"
 #define   w_MAXCHECK    "MAXCHECK"
 #define   w_DAMPLIMIT   "DAMPLIMIT"                                            //(2.00.12 - LR)
+#define   w_ORDERING    "ORDERING"
+#define   w_MINDEGREE   "MIND"
+#define   w_AMD         "AMD"
+#define   w_THREADS     "THREADS"
+#define   w_SYMBOLIC    "SYMB"
+#define   w_SOLVER      "SOLVER"
+#define   w_CHOLESKY    "CHOL"
+#define   w_PCG         "PCG"
+#define   w_UPDATE      "UPDATE"
+#define   w_PRECISION   "PREC"
+#define   w_DOUBLE      "DOUB"
+#define   w_PREDICTOR   "PREDICT"
+#define   w_LINEAR      "LIN"
+#define   w_QUADRATIC   "QUAD"
+#define   w_CACHE       "CACHE"
+#define   w_ROUTING     "ROUTING"
+#define   w_CONSTIT     "CONSTIT"
+#define   w_RECEPT      "RECEPT"
+#define   w_STANDARD    "STAND"
 
 #define   w_SECONDS     "SEC"
 #define   w_MINUTES     "MIN"
@@ -258,6 +277,17 @@ AUTHOR:     L. Rossman
 #define   t_HW          "Hazen-Williams"
 #define   t_DW          "Darcy-Weisbach"
 #define   t_CM          "Chezy-Manning"
+#define   t_MINDEGREE   "Minimum Degree"
+#define   t_AMD         "Approx. Minimum Degree"
+#define   t_CHOLESKY    "Sparse Cholesky"
+#define   t_PCG         "Conjugate Gradient"
+#define   t_DOUBLE      "Double"
+#define   t_MIXED       "Mixed"
+#define   t_NONE        "None"
+#define   t_LINEAR      "Linear"
+#define   t_QUADRATIC   "Quadratic"
+#define   t_STANDARD    "Standard"
+#define   t_ORDERED     "Ordered by Flow"
 #define   t_CHEMICAL    "Chemical"
 #define   t_XHEAD       "closed because cannot deliver head"
 #define   t_TEMPCLOSED  "temporarily closed"
@@ -363,14 +393,24 @@ AUTHOR:     L. Rossman
 #define FMT27a "    Status Check Frequency ............ %-d"                   //(2.00.12 - LR)
 #define FMT27b "    Maximum Trials Checked ............ %-d"                   //(2.00.12 - LR)
 #define FMT27c "    Damping Limit Threshold ........... %-.6f"                 //(2.00.12 - LR)
+#define FMT27d "    Node Ordering Method .............. %s"
+#define FMT27e "    Solver Threads .................... %-d"
+#define FMT27f "    Linear Equation Solver ............ %s"
+#define FMT27g "    Factor Update Limit ............... %-.6f"
+#define FMT27h "    Factorization Precision ........... %s"
+#define FMT27i "    Flow Predictor .................... %s"
+#define FMT27j "    Solution Cache Tolerance .......... %-.6f %s"
 
 #define FMT28  "    Maximum Trials .................... %-d"
 #define FMT29  "    Quality Analysis .................. None"
 #define FMT30  "    Quality Analysis .................. %s"
 #define FMT31  "    Quality Analysis .................. Trace From Node %s"
 #define FMT32  "    Quality Analysis .................. Age"
+#define FMT32a "    Added Constituent ................. Trace From Node %s"
+#define FMT32b "    Added Constituent ................. Age"
 #define FMT33  "    Water Quality Time Step ........... %-.2f min"
 #define FMT34  "    Water Quality Tolerance ........... %-.2f %s"
+#define FMT35  "    Water Quality Routing ............. %s"
 #define FMT36  "    Specific Gravity .................. %-.2f"
 #define FMT37a "    Relative Kinematic Viscosity ...... %-.2f"
 #define FMT37b "    Relative Chemical Diffusivity ..... %-.2f"
@@ -409,6 +449,7 @@ AUTHOR:     L. Rossman
 #define FMT63  "%10s: %s %s changed by rule %s"
 #define FMT64  "%10s: Balancing the network:"
 #define FMT65  "            Trial %2d: relative flow change = %-.6f"
+#define FMT66  "%10s: Node re-ordering found %d non-zero coeffs."
 /*** End of update ***/
 
 /* -------------------- Energy Report Table ------------------- */
@@ -451,6 +492,8 @@ AUTHOR:     L. Rossman
 #define ERR109 "System Error 109: cannot change time parameter when solver is active."
 #define ERR110 "System Error 110: cannot solve network hydraulic equations."
 #define ERR120 "System Error 120: cannot solve water quality transport equations."
+#define ERR121 "System Error 121: no receptor nodes for influence analysis."
+#define ERR122 "System Error 122: water quality solver is open."
 
 #define ERR200 "Input Error 200: one or more errors in input file."
 #define ERR201 \
@@ -519,6 +562,7 @@ AUTHOR:     L. Rossman
 #define WARN04  "WARNING: Pump %s %s at %s hrs."
 #define WARN05  "WARNING: %s %s %s at %s hrs."
 #define WARN06  "WARNING: Negative pressures at %s hrs."
+#define WARN07  "WARNING: THREADS option ignored - not built with OpenMP."
 
 /*-------------------- General Warning Messages -------------------------*/
 #define WARN1 "WARNING: System hydraulically unbalanced."
@@ -98,6 +98,18 @@ AUTHOR:     L. Rossman
 
 #define EN_ITERATIONS     0
 #define EN_RELATIVEERROR  1
+#define EN_ALLOCBYTES     2   /* Bytes allocated by linsolve() per trial */
+#define EN_NONZEROS       3   /* Non-zero coeffs. after node re-ordering */
+#define EN_ORDERTIME      4   /* Msec taken to re-order nodes            */
+#define EN_SYMCACHED      5   /* 1 if symbolic factor file was used      */
+#define EN_PCGITERATIONS  6   /* PCG iterations in last trial            */
+#define EN_FACTORUPDATES  7   /* Factor updates in last trial (-1=refact.)*/
+#define EN_CORESIZE       8   /* Rows left after tree & chain elimination*/
+#define EN_REFINESTEPS    9   /* Refinement steps in last trial (-1=none)*/
+#define EN_CONTROLEVALS  10   /* Simple controls examined in last period */
+#define EN_TOTALITERATIONS 11 /* Trials in all periods since ENinitH()   */
+#define EN_CACHEHITS     12   /* Periods solved from the solution cache  */
+#define EN_CACHEMISSES   13   /* Periods solved with the cache missed    */
 
 #define EN_NODECOUNT    0   /* Component counts */
 #define EN_TANKCOUNT    1
@@ -105,6 +117,9 @@ AUTHOR:     L. Rossman
 #define EN_PATCOUNT     3
 #define EN_CURVECOUNT   4
 #define EN_CONTROLCOUNT 5
+#define EN_CONSCOUNT    6   /* Extra constituents (water age or trace  */
+                            /* only; none of them react, and they are  */
+                            /* kept in WQ segments of their own)       */
 
 #define EN_JUNCTION     0    /* Node types */
 #define EN_RESERVOIR    1
@@ -146,6 +161,30 @@ AUTHOR:     L. Rossman
 #define EN_TOLERANCE    2
 #define EN_EMITEXPON    3
 #define EN_DEMANDMULT   4
+#define EN_ORDERING     5
+#define EN_THREADS      6
+#define EN_SOLVER       7
+#define EN_UPDATELIMIT  8
+#define EN_PRECISION    9
+#define EN_PREDICTOR    10
+#define EN_CACHETOL     11
+#define EN_ROUTING      12
+
+#define EN_MINDEGREE    0   /* Node re-ordering methods */
+#define EN_AMD          1
+
+#define EN_CHOLESKY     0   /* Linear equation solvers */
+#define EN_PCG          1
+
+#define EN_DOUBLE       0   /* Cholesky factor precisions */
+#define EN_MIXED        1
+
+#define EN_NOPREDICT    0   /* Starting flow predictors */
+#define EN_LINEAR       1
+#define EN_QUADRATIC    2
+
+#define EN_STDROUTE     0   /* Water quality routing methods */
+#define EN_ORDROUTE     1
 
 #define EN_LOWLEVEL     0   /* Control types.  */
 #define EN_HILEVEL      1   /* See ControlType */
@@ -190,6 +229,7 @@ extern "C" {
  int  DLLEXPORT ENcloseH(void);
  int  DLLEXPORT ENsavehydfile(char *);
  int  DLLEXPORT ENusehydfile(char *);
+ int  DLLEXPORT ENusesymfile(char *);
 
  int  DLLEXPORT ENsolveQ(void);
  int  DLLEXPORT ENopenQ(void);
@@ -198,6 +238,7 @@ extern "C" {
  int  DLLEXPORT ENnextQ(long *);
  int  DLLEXPORT ENstepQ(long *);
  int  DLLEXPORT ENcloseQ(void);
+ int  DLLEXPORT ENsolveI(char *);
 
  int  DLLEXPORT ENwriteline(char *);
  int  DLLEXPORT ENreport(void);
@@ -215,6 +256,7 @@ extern "C" {
  int  DLLEXPORT ENgetpatternlen(int, int *);
  int  DLLEXPORT ENgetpatternvalue(int, int, float *);
  int  DLLEXPORT ENgetqualtype(int *, int *);
+ int  DLLEXPORT ENgetconstype(int, int *, int *);
  int  DLLEXPORT ENgeterror(int, char *, int);
  int  DLLEXPORT ENgetstatistic(int code, int* value);
 
@@ -222,6 +264,7 @@ extern "C" {
  int  DLLEXPORT ENgetnodeid(int, char *);
  int  DLLEXPORT ENgetnodetype(int, int *);
  int  DLLEXPORT ENgetnodevalue(int, int, float *);
+ int  DLLEXPORT ENgetnodecons(int, int, float *);
 
  int  DLLEXPORT ENgetnumdemands(int, int *);
  int  DLLEXPORT ENgetbasedemand(int, int, float *);
@@ -232,6 +275,7 @@ extern "C" {
  int  DLLEXPORT ENgetlinktype(int, int *);
  int  DLLEXPORT ENgetlinknodes(int, int *, int *);
  int  DLLEXPORT ENgetlinkvalue(int, int, float *);
+ int  DLLEXPORT ENgetlinkcons(int, int, float *);
  
  int  DLLEXPORT ENgetcurve(int curveIndex, int *nValues, float **xValues, float **yValues);
  int  DLLEXPORT ENgetheadcurve(int, char *);
@@ -183,6 +183,12 @@ struct Ssource     /* WQ SOURCE OBJECT */
 };
 typedef struct Ssource *Psource; /* Pointer to WQ source object */
 
+typedef struct     /* EXTRA WQ CONSTITUENT */
+{
+   int    Node;     /* Trace node index         */
+   char   Type;     /* AGE or TRACE             */
+}  Scons;
+
 typedef struct            /* NODE OBJECT */
 {
    char    ID[MAXID+1];    /* Node ID          */
@@ -282,13 +288,15 @@ struct   Sadjlist         /* NODE ADJACENCY LIST ITEM */
 /* Pointer to adjacency list item */
 typedef struct Sadjlist *Padjlist; 
 
-struct  Sseg               /* PIPE SEGMENT record used */
-{                          /*   for WQ routing         */
-   double  v;              /* Segment volume      */
-   double  c;              /* Water quality value */
-   struct  Sseg *prev;     /* Record for previous segment */
-};
-typedef struct Sseg *Pseg;    /* Pointer to pipe segment */
+typedef struct             /* PIPE SEGMENTS used for WQ routing, */
+{                          /*   kept in a ring buffer            */
+   double  *v;             /* Segment volumes                    */
+   double  *c;             /* Segment water quality values       */
+   int     first;          /* Position of first (downstream) seg */
+   int     n;              /* Number of segments                 */
+   int     size;           /* Capacity of buffer (power of 2)    */
+}  Sseglist;
+typedef Sseglist *Pseglist; /* Pointer to pipe segment list */
 
 typedef struct            /* FIELD OBJECT of report table */
 {
@@ -373,6 +381,27 @@ typedef struct            /* FIELD OBJECT of report table */
                   DW,           /*   Darcy-Weisbach                    */
                   CM};          /*   Chezy-Manning                     */
 
+ enum OrderType                 /* Node re-ordering method:            */
+                 {MINDEG,       /*   original minimum degree           */
+                  AMD};         /*   approximate minimum degree        */
+
+ enum SolverType                /* Linear equation solver:             */
+                 {CHOLESKY,     /*   sparse Cholesky factorization     */
+                  PCG};         /*   preconditioned conjugate gradient */
+
+ enum PrecType                  /* Cholesky factor precision:          */
+                 {DOUBLEPREC,   /*   double precision                  */
+                  MIXEDPREC};   /*   single prec. with refinement      */
+
+ enum PredType                  /* Predictor of starting flows:        */
+                 {NOPRED,       /*   none (use last period's flows)    */
+                  LINEARPRED,   /*   linear extrapolation              */
+                  QUADPRED};    /*   quadratic extrapolation           */
+
+ enum RouteType                 /* Water quality routing:              */
+                 {STDROUTE,     /*   all links, then all nodes         */
+                  ORDROUTE};    /*   node by node in order of flow     */
+
  enum UnitsType                 /* Unit system:                        */
                  {US,           /*   US                                */
                   SI};          /*   SI (metric)                       */
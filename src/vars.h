@@ -26,6 +26,7 @@ EXTERN char     Msg[MAXMSG+1],         /* Text of output message       */
                 HydFname[MAXFNAME+1],  /* Hydraulics file name         */
                 OutFname[MAXFNAME+1],  /* Binary output file name      */
                 MapFname[MAXFNAME+1],  /* Map file name                */
+                SymFname[MAXFNAME+1],  /* Symbolic factor file name    */
                 TmpFname[MAXFNAME+1],  /* Temporary file name          */      //(2.00.12 - LR)
                 TmpDir[MAXFNAME+1],    /* Temporary directory name     */      //(2.00.12 - LR)
                 Title[MAXTITLE][MAXMSG+1], /* Problem title            */
@@ -44,6 +45,11 @@ EXTERN char     Msg[MAXMSG+1],         /* Text of output message       */
                 Flowflag,              /* Flow units flag              */
                 Pressflag,             /* Pressure units flag          */
                 Formflag,              /* Hydraulic formula flag       */
+                Ordering,              /* Node re-ordering method      */
+                Solver,                /* Linear equation solver       */
+                Precision,             /* Cholesky factor precision    */
+                Predictor,             /* Starting flow predictor      */
+                Routing,               /* Water quality routing method */
                 Rptflag,               /* Report flag                  */
                 Summaryflag,           /* Report summary flag          */
                 Messageflag,           /* Error/warning message flag   */
@@ -70,6 +76,8 @@ EXTERN int      MaxNodes,              /* Node count from input file   */
                 MaxRules,              /* Rule count                   */
                 MaxPats,               /* Pattern count                */
                 MaxCurves,             /* Curve count                  */
+                MaxCons,               /* Extra WQ constituent count   */
+                MaxRecept,             /* Receptor node count          */
                 Nnodes,                /* Number of network nodes      */
                 Ntanks,                /* Number of tanks              */
                 Njuncs,                /* Number of junction nodes     */
@@ -81,6 +89,8 @@ EXTERN int      MaxNodes,              /* Node count from input file   */
                 Nrules,                /* Number of control rules      */
                 Npats,                 /* Number of time patterns      */
                 Ncurves,               /* Number of data curves        */
+                Ncons,                 /* Number of extra constituents */
+                Nrecept,               /* Number of receptor nodes     */
                 Nperiods,              /* Number of reporting periods  */
                 Ncoeffs,               /* Number of non-0 matrix coeffs*/
                 DefPat,                /* Default demand pattern       */
@@ -90,7 +100,8 @@ EXTERN int      MaxNodes,              /* Node count from input file   */
                 TraceNode,             /* Source node for flow tracing */
                 PageSize,              /* Lines/page in output report  */
                 CheckFreq,             /* Hydraulics solver parameter  */
-                MaxCheck;              /* Hydraulics solver parameter  */
+                MaxCheck,              /* Hydraulics solver parameter  */
+                Threads;               /* Number of hydraulic threads  */
 EXTERN double   Ucf[MAXVAR],           /* Unit conversion factors      */
                 Ctol,                  /* Water quality tolerance      */
                 Htol,                  /* Hydraulic head tolerance     */
@@ -101,6 +112,8 @@ EXTERN double   Ucf[MAXVAR],           /* Unit conversion factors      */
                 Dmult,                 /* Demand multiplier            */
                 Hacc,                  /* Hydraulics solution accuracy */
                 DampLimit,             /* Solution damping threshold   */      //(2.00.12 - LR)
+                UpdateLimit,           /* Factor update threshold      */
+                CacheTol,              /* Solution cache head tolerance*/
                 BulkOrder,             /* Bulk flow reaction order     */
                 WallOrder,             /* Pipe wall reaction order     */
                 TankOrder,             /* Tank reaction order          */
@@ -140,6 +153,7 @@ EXTERN char     *S,                    /* Link status                  */
                 *OldStat;              /* Previous link/tank status    */
 EXTERN double   *D,                    /* Node actual demand           */
                 *C,                    /* Node actual quality          */
+                *Cx,                   /* Node extra constituents      */
                 *E,                    /* Emitter flows                */
                 *K,                    /* Link settings                */
                 *Q,                    /* Link flows                   */
@@ -149,16 +163,30 @@ EXTERN double   *H;                    /* Node heads                   */
 EXTERN STmplist *Patlist;              /* Temporary time pattern list  */ 
 EXTERN STmplist *Curvelist;            /* Temporary list of curves     */
 EXTERN Spattern *Pattern;              /* Time patterns                */
+EXTERN double   *Pfactor;              /* Current time pattern factors */
 EXTERN Scurve   *Curve;                /* Curve data                   */
 EXTERN Snode    *Node;                 /* Node data                    */
 EXTERN Slink    *Link;                 /* Link data                    */
 EXTERN Stank    *Tank;                 /* Tank data                    */
+EXTERN Scons    *Cons;                 /* Extra WQ constituents        */
+EXTERN int      *Recept;               /* Receptor nodes               */
 EXTERN Spump    *Pump;                 /* Pump data                    */
 EXTERN Svalve   *Valve;                /* Valve data                   */
 EXTERN Scontrol *Control;              /* Control data                 */
 EXTERN HTtable  *Nht, *Lht;            /* Hash tables for ID labels    */
 EXTERN Padjlist *Adjlist;              /* Node adjacency lists         */
 EXTERN int _relativeError, _iterations; /* Info about hydraulic solution */
+EXTERN int      AllocBytes;            /* Bytes alloc'd by last trial  */
+EXTERN int      OrderTime;             /* Msec spent re-ordering nodes */
+EXTERN int      SymCached;             /* Symbolic factor file used    */
+EXTERN int      PcgIterations;         /* PCG iterations, last trial   */
+EXTERN int      FactorUpdates;         /* Rank-one updates, last trial */
+EXTERN int      CoreSize;              /* Rows left after chain elim.  */
+EXTERN int      RefineSteps;           /* Refinement steps, last trial */
+EXTERN int      ControlEvals;          /* Controls checked last period */
+EXTERN int      TotalIterations;       /* Trials in all periods so far */
+EXTERN int      CacheHits;             /* Periods solved from cache    */
+EXTERN int      CacheMisses;           /* Periods not found in cache   */
 
 /*
 ** NOTE: Hydraulic analysis of the pipe network at a given point in time
@@ -190,8 +218,9 @@ EXTERN int      *Order,      /* Node-to-row of A                    */
                 *Ndx;        /* Index of link's coeff. in Aij       */
 /*
 ** The following arrays store the positions of the non-zero coeffs.    
-** of the lower triangular portion of A whose values are stored in Aij:
+** of the lower triangular portion of A whose values are stored in Aij
+** in the same order (LNZ is only used while these are being built):
 */
 EXTERN int      *XLNZ,       /* Start position of each column in NZSUB  */
                 *NZSUB,      /* Row index of each coeff. in each column */
-                *LNZ;        /* Position of each coeff. in Aij array    */
+                *LNZ;        /* Link that each coeff. belongs to        */